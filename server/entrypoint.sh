@@ -4,8 +4,22 @@ echo "Building randomization binary..." && \
 make -C /server/randomization clean && \
 make -C /server/randomization
 
+echo "Building client library..." && \
+make -C /server/simulator/dependencies clean && \
+make -C /server/simulator/dependencies objects zygote libclient.so
+
 echo "Building simulator binary..." && \
 make -C /server/simulator/simulator clean && \
 make -C /server/simulator/simulator
 
+echo "Starting zygote..." && \
+(cd /server/simulator/simulator && ../dependencies/zygote &)
+
+echo "Building scheduler..." && \
+make -C /server/scheduler clean && \
+make -C /server/scheduler
+
+echo "Starting scheduler..." && \
+(cd /server/scheduler && ./scheduler &)
+
 ./middleware
@@ -0,0 +1,13 @@
+#include "Enes100.h"
+
+// what most first submissions look like, a typo and a missing semicolon
+void setup() {
+    Enes100.begin("Team Typo", FIRE, 3, 8, 9);
+    Tank.begin()
+}
+
+void loop() {
+    Tank.setLeftMotorPWM(speed);
+    Tank.setRightMotorPWM(speed);
+    delay(100);
+}
@@ -0,0 +1,47 @@
+#include "Enes100.h"
+#include <math.h>
+
+// navigates to the destination in small steps, waiting a little after every
+// location update and every correction
+void setup() {
+    Enes100.begin("Team Delays", CHEMICAL, 3, 8, 9);
+    Tank.begin();
+    Enes100.updateLocation();
+}
+
+void loop() {
+    delay(20);
+    if(!Enes100.updateLocation()) {
+        delay(100);
+        return;
+    }
+
+    float dx = Enes100.destination.x - Enes100.location.x;
+    float dy = Enes100.destination.y - Enes100.location.y;
+    if(dx * dx + dy * dy < 0.01) {
+        Tank.turnOffMotors();
+        Enes100.mission(WATER);
+        delay(1000);
+        return;
+    }
+
+    float error = atan2(dy, dx) - Enes100.location.theta;
+    while(error > M_PI) {
+        error -= 2 * M_PI;
+    }
+    while(error < -M_PI) {
+        error += 2 * M_PI;
+    }
+
+    if(fabs(error) > 0.2) {
+        Tank.setLeftMotorPWM(error > 0 ? -100 : 100);
+        Tank.setRightMotorPWM(error > 0 ? 100 : -100);
+        delay(50);
+    } else {
+        Tank.setLeftMotorPWM(200);
+        Tank.setRightMotorPWM(200);
+        delay(200);
+    }
+    Tank.turnOffMotors();
+    delay(30);
+}
@@ -0,0 +1,10 @@
+#include "Enes100.h"
+
+// connects and then never does anything, like a sketch still being written
+void setup() {
+    Enes100.begin("Team Idle", FIRE, 3, 8, 9);
+    Tank.begin();
+}
+
+void loop() {
+}
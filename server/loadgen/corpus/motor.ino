@@ -0,0 +1,26 @@
+#include "Enes100.h"
+
+// drives a square by time alone, motors and delays and nothing else
+void setup() {
+    Enes100.begin("Team Motor", DEBRIS, 3, 8, 9);
+    Tank.begin();
+}
+
+void forward(int msec) {
+    Tank.setLeftMotorPWM(200);
+    Tank.setRightMotorPWM(200);
+    delay(msec);
+}
+
+void turn(int msec) {
+    Tank.setLeftMotorPWM(150);
+    Tank.setRightMotorPWM(-150);
+    delay(msec);
+}
+
+void loop() {
+    forward(1500);
+    turn(700);
+    Tank.turnOffMotors();
+    delay(250);
+}
@@ -0,0 +1,29 @@
+#include "Enes100.h"
+
+// debugs by printing everything it knows on every pass
+int passes = 0;
+
+void setup() {
+    Enes100.begin("Team Prints", BLACK_BOX, 3, 8, 9);
+    Tank.begin();
+    Enes100.println("starting up");
+}
+
+void loop() {
+    Enes100.updateLocation();
+    Enes100.print("pass ");
+    Enes100.println(passes);
+    Enes100.print("x = ");
+    Enes100.println(Enes100.location.x);
+    Enes100.print("y = ");
+    Enes100.println(Enes100.location.y);
+    Enes100.print("theta = ");
+    Enes100.println(Enes100.location.theta);
+    Enes100.print("front = ");
+    Enes100.println(Tank.readDistanceSensor(1));
+
+    Tank.setLeftMotorPWM(180);
+    Tank.setRightMotorPWM(160);
+    passes++;
+    delay(10);
+}
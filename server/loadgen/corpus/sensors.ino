@@ -0,0 +1,29 @@
+#include "Enes100.h"
+
+// polls the distance sensors as fast as it can and steers away from whatever
+// is closest
+const float STOP_DISTANCE = 0.25;
+
+void setup() {
+    Enes100.begin("Team Sensors", WATER, 3, 8, 9);
+    Tank.begin();
+}
+
+void loop() {
+    float left = Tank.readDistanceSensor(0);
+    float front = Tank.readDistanceSensor(1);
+    float right = Tank.readDistanceSensor(2);
+
+    if(front > 0 && front < STOP_DISTANCE) {
+        if(left > right) {
+            Tank.setLeftMotorPWM(-120);
+            Tank.setRightMotorPWM(120);
+        } else {
+            Tank.setLeftMotorPWM(120);
+            Tank.setRightMotorPWM(-120);
+        }
+    } else {
+        Tank.setLeftMotorPWM(220);
+        Tank.setRightMotorPWM(220);
+    }
+}
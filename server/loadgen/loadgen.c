@@ -0,0 +1,795 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include <time.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+#include "loadgen.h"
+
+// replays a corpus of sketches against simulate the way the middleware would
+// send them, at a fixed arrival rate or with a fixed number always running, and
+// reports how long each phase took, what the jobs cost and what memory they
+// needed. this is what nodes get sized by before a lab session.
+//
+// every job gets a global of its own added to its code, so nothing is handed
+// back from the build or result caches unless --warm asks for exactly that.
+
+static const char *phase_names[NUM_PHASES] = {"queue", "compile", "start", "simulate", "total", "e2e"};
+
+static struct sketch sketches[MAX_SKETCHES];
+static int num_sketches = 0;
+static struct job jobs[MAX_JOBS];
+
+static char *simulator_dir = SIMULATOR_DIR;
+static char *extra = NULL;
+static int warm = 0;
+static int verbose = 0;
+static long seed = 1;
+
+long now_usec() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1000000L + t.tv_nsec / 1000L;
+}
+
+// a string that grows as things are added to it
+struct buffer {
+    char *data;
+    size_t length;
+    size_t size;
+};
+
+void append(struct buffer *b, const char *data, size_t length) {
+    if(b->length + length + 1 > b->size) {
+        b->size = (b->length + length + 1) * 2;
+        b->data = (char *)realloc(b->data, b->size);
+        if(b->data == NULL) {
+            perror("loadgen");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    memcpy(b->data + b->length, data, length);
+    b->length += length;
+    b->data[b->length] = '\0';
+}
+
+void append_string(struct buffer *b, const char *s) {
+    append(b, s, strlen(s));
+}
+
+void append_json(struct buffer *b, const char *s) {
+    char escape[8];
+
+    append_string(b, "\"");
+    for(; *s != '\0'; s++) {
+        if(*s == '"' || *s == '\\') {
+            sprintf(escape, "\\%c", *s);
+        } else if(*s == '\n') {
+            strcpy(escape, "\\n");
+        } else if(*s == '\t') {
+            strcpy(escape, "\\t");
+        } else if((unsigned char)*s < 0x20) {
+            sprintf(escape, "\\u%04x", *s);
+        } else {
+            append(b, s, 1);
+            continue;
+        }
+        append_string(b, escape);
+    }
+    append_string(b, "\"");
+}
+
+char *read_file(const char *path) {
+    FILE *fp = fopen(path, "r");
+    if(fp == NULL) {
+        return NULL;
+    }
+
+    struct buffer b = {NULL, 0, 0};
+    char chunk[4096];
+    size_t size;
+    append(&b, "", 0);
+    while((size = fread(chunk, 1, sizeof(chunk), fp)) > 0) {
+        append(&b, chunk, size);
+    }
+
+    fclose(fp);
+    return b.data;
+}
+
+// how many characters of the call to name start at p, counting the space around
+// the dot and up to the opening parenthesis, 0 when there is no such call
+static size_t match_call(const char *p, const char *object, const char *name) {
+    const char *q = p;
+
+    if(object != NULL) {
+        size_t length = strlen(object);
+        if(strncmp(q, object, length)) {
+            return 0;
+        }
+        q += length;
+        while(isspace(*q)) {
+            q++;
+        }
+        if(*q++ != '.') {
+            return 0;
+        }
+        while(isspace(*q)) {
+            q++;
+        }
+    }
+
+    size_t length = strlen(name);
+    if(strncmp(q, name, length) || isalnum(q[length]) || q[length] == '_') {
+        return 0;
+    }
+    q += length;
+    while(isspace(*q)) {
+        q++;
+    }
+
+    return *q == '(' ? q + 1 - p : 0;
+}
+
+// what preprocess() in the middleware does to a sketch, every call it knows
+// about gets the line it is on as its first argument. comments and strings are
+// left alone, which is where the two may differ.
+char *preprocess(const char *code) {
+    static const char *calls[][2] = {
+        {"Enes100", "begin"}, {"Enes100", "updateLocation"}, {"Enes100", "mission"},
+        {"Enes100", "print"}, {"Enes100", "println"},
+        {"Tank", "readDistanceSensor"}, {"Tank", "turnOffMotors"},
+        {"Tank", "setRightMotorPWM"}, {"Tank", "setLeftMotorPWM"},
+        {NULL, "delay"}
+    };
+    struct buffer b = {NULL, 0, 0};
+    const char *p = code;
+    size_t i;
+
+    append(&b, "", 0);
+    while(*p != '\0') {
+        if(p[0] == '/' && p[1] == '/') {
+            const char *end = strchr(p, '\n');
+            size_t length = end != NULL ? (size_t)(end - p) : strlen(p);
+            append(&b, p, length);
+            p += length;
+            continue;
+        }
+
+        if(p[0] == '/' && p[1] == '*') {
+            const char *end = strstr(p + 2, "*/");
+            size_t length = end != NULL ? (size_t)(end + 2 - p) : strlen(p);
+            append(&b, p, length);
+            p += length;
+            continue;
+        }
+
+        if(*p == '"' || *p == '\'') {
+            const char *q = p + 1;
+            while(*q != '\0' && *q != *p) {
+                q += q[0] == '\\' && q[1] != '\0' ? 2 : 1;
+            }
+            size_t length = *q != '\0' ? (size_t)(q + 1 - p) : (size_t)(q - p);
+            append(&b, p, length);
+            p += length;
+            continue;
+        }
+
+        // only at the start of a name, setDelay( is not a delay
+        size_t length = 0;
+        if(p == code || !(isalnum(p[-1]) || p[-1] == '_' || p[-1] == '.')) {
+            for(i = 0; i < sizeof(calls) / sizeof(calls[0]) && length == 0; i++) {
+                length = match_call(p, calls[i][0], calls[i][1]);
+            }
+        }
+
+        if(length == 0) {
+            append(&b, p, 1);
+            p++;
+            continue;
+        }
+
+        append(&b, p, length);
+        p += length;
+
+        const char *q = p;
+        while(isspace(*q)) {
+            q++;
+        }
+        append_string(&b, *q == ')' ? LINE_ARGUMENT : LINE_ARGUMENT ", ");
+    }
+
+    return b.data;
+}
+
+static int compare_sketch(const void *a, const void *b) {
+    return strcmp(((const struct sketch *)a)->name, ((const struct sketch *)b)->name);
+}
+
+void load_corpus(const char *dir) {
+    DIR *d = opendir(dir);
+    struct dirent *entry;
+
+    if(d == NULL) {
+        perror(dir);
+        exit(EXIT_FAILURE);
+    }
+
+    while((entry = readdir(d)) != NULL) {
+        size_t length = strlen(entry->d_name);
+        if(length <= 4 || strcmp(entry->d_name + length - 4, ".ino") || length - 4 >= sizeof(sketches[0].name)) {
+            continue;
+        }
+
+        if(num_sketches == MAX_SKETCHES) {
+            fprintf(stderr, "loadgen: more than %d sketches in %s\n", MAX_SKETCHES, dir);
+            exit(EXIT_FAILURE);
+        }
+
+        char path[strlen(dir) + length + 2];
+        sprintf(path, "%s/%s", dir, entry->d_name);
+        char *code = read_file(path);
+        if(code == NULL) {
+            perror(path);
+            exit(EXIT_FAILURE);
+        }
+
+        struct sketch *sketch = &sketches[num_sketches++];
+        memcpy(sketch->name, entry->d_name, length - 4);
+        sketch->name[length - 4] = '\0';
+        sketch->code = preprocess(code);
+        sketch->weight = 1;
+        free(code);
+    }
+
+    closedir(d);
+    if(num_sketches == 0) {
+        fprintf(stderr, "loadgen: no sketches in %s\n", dir);
+        exit(EXIT_FAILURE);
+    }
+
+    // in name order, so a seed picks the same jobs whatever the directory does
+    qsort(sketches, num_sketches, sizeof(struct sketch), compare_sketch);
+}
+
+// "name=weight,name=weight", sketches left out are not sent at all
+void parse_mix(char *mix) {
+    int i;
+    char *item;
+
+    for(i = 0; i < num_sketches; i++) {
+        sketches[i].weight = 0;
+    }
+
+    for(item = strtok(mix, ","); item != NULL; item = strtok(NULL, ",")) {
+        char *weight = strchr(item, '=');
+        if(weight != NULL) {
+            *weight++ = '\0';
+        }
+
+        for(i = 0; i < num_sketches && strcmp(sketches[i].name, item); i++);
+        if(i == num_sketches) {
+            fprintf(stderr, "loadgen: no sketch called %s\n", item);
+            exit(EXIT_FAILURE);
+        }
+        sketches[i].weight = weight != NULL ? atoi(weight) : 1;
+    }
+}
+
+int pick_sketch() {
+    int i, total = 0;
+
+    for(i = 0; i < num_sketches; i++) {
+        total += sketches[i].weight;
+    }
+    if(total <= 0) {
+        fprintf(stderr, "loadgen: the mix has no weight in it\n");
+        exit(EXIT_FAILURE);
+    }
+
+    int r = (int)(drand48() * total);
+    for(i = 0; i < num_sketches - 1 && r >= sketches[i].weight; i++) {
+        r -= sketches[i].weight;
+    }
+    return i;
+}
+
+// the request the middleware would have sent for job n
+char *build_request(int n) {
+    struct buffer b = {NULL, 0, 0};
+    struct buffer code = {NULL, 0, 0};
+    char number[64];
+
+    append_string(&code, sketches[jobs[n].sketch].code);
+    if(!warm) {
+        sprintf(number, "\nint loadgen_job_%d_%d;\n", (int)getpid(), n);
+        append_string(&code, number);
+    }
+
+    sprintf(number, "\"loadgen%d_%d\"", (int)getpid(), n);
+    append_string(&b, "{\"type\":\"simulation\",\"id\":");
+    append_string(&b, number);
+    append_string(&b, ",\"code\":");
+    append_json(&b, code.data);
+    sprintf(number, ",\"randomization\":{\"seed\":%ld}", warm ? seed : seed + n);
+    append_string(&b, number);
+    append_string(&b, ",\"distance_sensors\":[0,1,2,3,4,5,6,7,8,9,10,11]");
+    if(extra != NULL) {
+        append_string(&b, ",");
+        append_string(&b, extra);
+    }
+    append_string(&b, "}");
+
+    free(code.data);
+    return b.data;
+}
+
+void start_job(int n) {
+    struct job *job = &jobs[n];
+    int in[2], out[2], err[2], phases[2];
+
+    if(pipe2(in, O_CLOEXEC) || pipe2(out, O_CLOEXEC) || pipe2(err, O_CLOEXEC) || pipe2(phases, O_CLOEXEC)) {
+        perror("loadgen");
+        exit(EXIT_FAILURE);
+    }
+
+    job->started_usec = now_usec();
+    job->pid = fork();
+    if(job->pid < 0) {
+        perror("loadgen");
+        exit(EXIT_FAILURE);
+    }
+
+    if(job->pid == 0) {
+        // every pipe end is above 2 since ours are open, so this order is safe
+        dup2(in[0], STDIN_FILENO);
+        dup2(out[1], STDOUT_FILENO);
+        dup2(err[1], STDERR_FILENO);
+        if(phases[1] == PHASES_FD) {
+            fcntl(PHASES_FD, F_SETFD, 0);
+        } else {
+            dup2(phases[1], PHASES_FD);
+        }
+
+        char fd[16];
+        sprintf(fd, "%d", PHASES_FD);
+        setenv(PHASES_ENV, fd, 1);
+        if(chdir(simulator_dir) == 0) {
+            execl("./simulate", "simulate", (char *)NULL);
+        }
+        perror("simulate");
+        _exit(127);
+    }
+
+    close(in[0]);
+    close(out[1]);
+    close(err[1]);
+    close(phases[1]);
+
+    // simulate reads the whole request before it writes anything
+    char *request = build_request(n);
+    size_t length = strlen(request), done = 0;
+    while(done < length) {
+        ssize_t size = write(in[1], request + done, length - done);
+        if(size <= 0) {
+            break;
+        }
+        done += size;
+    }
+    close(in[1]);
+    free(request);
+
+    job->fds[0] = out[0];
+    job->fds[1] = err[0];
+    job->fds[2] = phases[0];
+    for(int i = 0; i < 3; i++) {
+        fcntl(job->fds[i], F_SETFL, O_NONBLOCK);
+    }
+}
+
+// reads whatever fd i of job has, all of it once the job has exited
+void drain(struct job *job, int i) {
+    char chunk[65536];
+    ssize_t size;
+
+    while(job->fds[i] >= 0 && (size = read(job->fds[i], chunk, sizeof(chunk))) != 0) {
+        if(size < 0) {
+            return;
+        }
+
+        if(i == 0) {
+            // only the end record is looked at, the frames are thrown away
+            if(size >= TAIL_LENGTH) {
+                memcpy(job->tail, chunk + size - TAIL_LENGTH, TAIL_LENGTH);
+                job->tail_length = TAIL_LENGTH;
+            } else {
+                int keep = job->tail_length + size > TAIL_LENGTH ? TAIL_LENGTH - size : job->tail_length;
+                memmove(job->tail, job->tail + job->tail_length - keep, keep);
+                memcpy(job->tail + keep, chunk, size);
+                job->tail_length = keep + size;
+            }
+        } else if(i == 2) {
+            int room = PHASES_LENGTH - 1 - job->phases_length;
+            if(size > room) {
+                size = room;
+            }
+            memcpy(job->phases + job->phases_length, chunk, size);
+            job->phases_length += size;
+            job->phases[job->phases_length] = '\0';
+        }
+    }
+
+    if(job->fds[i] >= 0) {
+        close(job->fds[i]);
+        job->fds[i] = -1;
+    }
+}
+
+void finish_job(struct job *job, int status, struct rusage *usage) {
+    int i;
+    char *p;
+
+    for(i = 0; i < 3; i++) {
+        if(job->fds[i] >= 0) {
+            drain(job, i);
+            if(job->fds[i] >= 0) {
+                close(job->fds[i]);
+                job->fds[i] = -1;
+            }
+        }
+    }
+
+    job->ended_usec = now_usec();
+    job->pid = 0;
+    job->code = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+    job->cpu_sec = usage->ru_utime.tv_sec + usage->ru_stime.tv_sec + (usage->ru_utime.tv_usec + usage->ru_stime.tv_usec) / 1e6;
+    job->maxrss_kb = usage->ru_maxrss;
+
+    job->usec[QUEUE] = job->started_usec - job->arrived_usec;
+    job->usec[E2E] = job->ended_usec - job->arrived_usec;
+    for(p = strtok(job->phases, "\n"); p != NULL; p = strtok(NULL, "\n")) {
+        char name[32];
+        long usec;
+        if(sscanf(p, "%31s %ld", name, &usec) != 2) {
+            continue;
+        }
+        for(i = COMPILE; i <= TOTAL; i++) {
+            if(!strcmp(name, phase_names[i])) {
+                job->usec[i] = usec;
+            }
+        }
+    }
+
+    // the end record is the last thing in the output, a cached result included
+    strcpy(job->reason, job->code == 0 ? "none" : "error");
+    p = memmem(job->tail, job->tail_length, "{\"end\":{\"reason\":\"", 18);
+    if(p != NULL) {
+        sscanf(p + 18, "%31[^\"]", job->reason);
+    }
+}
+
+// field of a /proc file like meminfo or a process's status, in kB
+long proc_kb(const char *file, const char *field) {
+    FILE *fp = fopen(file, "r");
+    char line[128];
+    long kb = -1;
+    size_t length = strlen(field);
+
+    if(fp == NULL) {
+        return -1;
+    }
+
+    while(fgets(line, sizeof(line), fp) != NULL) {
+        if(!strncmp(line, field, length) && line[length] == ':') {
+            kb = atol(line + length + 1);
+            break;
+        }
+    }
+
+    fclose(fp);
+    return kb;
+}
+
+// seconds the whole machine spent busy, sketches started by the zygote included
+double busy_sec() {
+    FILE *fp = fopen("/proc/stat", "r");
+    unsigned long long user, nice, system, idle, iowait, irq, softirq, steal;
+
+    if(fp == NULL) {
+        return 0;
+    }
+
+    int count = fscanf(fp, "cpu %llu %llu %llu %llu %llu %llu %llu %llu", &user, &nice, &system, &idle, &iowait, &irq, &softirq, &steal);
+    fclose(fp);
+    if(count != 8) {
+        return 0;
+    }
+
+    return (user + nice + system + irq + softirq + steal) / (double)sysconf(_SC_CLK_TCK);
+}
+
+static int compare_long(const void *a, const void *b) {
+    long x = *(const long *)a, y = *(const long *)b;
+    return (x > y) - (x < y);
+}
+
+// nearest rank, so the p99 of a hundred jobs is the second slowest
+long percentile(long *sorted, int count, double p) {
+    int i = (int)ceil(p * count) - 1;
+    return sorted[i < 0 ? 0 : i];
+}
+
+// p50, p95, p99 and max of phase over the jobs of sketch, every sketch for -1.
+// returns how many jobs had the phase at all.
+int phase_stats(int num_jobs, int sketch, enum phase phase, long out[4]) {
+    long *values = (long *)malloc(sizeof(long) * num_jobs);
+    int i, count = 0;
+
+    for(i = 0; i < num_jobs; i++) {
+        if((sketch < 0 || jobs[i].sketch == sketch) && jobs[i].usec[phase] >= 0) {
+            values[count++] = jobs[i].usec[phase];
+        }
+    }
+
+    if(count > 0) {
+        qsort(values, count, sizeof(long), compare_long);
+        out[0] = percentile(values, count, 0.50);
+        out[1] = percentile(values, count, 0.95);
+        out[2] = percentile(values, count, 0.99);
+        out[3] = values[count - 1];
+    }
+
+    free(values);
+    return count;
+}
+
+void report(int num_jobs, double rate, int concurrency, double seconds, long base_kb, long low_kb, long peak_rss_kb, double busy, int most_running) {
+    int i, j;
+    long stats[4];
+    double cpu = 0;
+    long maxrss = 0;
+    int codes[MAX_CODE + 1] = {0};
+
+    for(i = 0; i < num_jobs; i++) {
+        cpu += jobs[i].cpu_sec;
+        if(jobs[i].maxrss_kb > maxrss) {
+            maxrss = jobs[i].maxrss_kb;
+        }
+        codes[jobs[i].code <= MAX_CODE ? jobs[i].code : MAX_CODE]++;
+    }
+
+    printf("%d jobs in %.2f s, %.2f jobs/s, ", num_jobs, seconds, num_jobs / seconds);
+    if(rate > 0) {
+        printf("arriving at %.2f/s with at most %d running\n", rate, concurrency);
+    } else {
+        printf("%d always running\n", concurrency);
+    }
+    printf("at most %d running at once\n\n", most_running);
+
+    printf("%-10s %8s %10s %10s %10s %10s\n", "phase ms", "jobs", "p50", "p95", "p99", "max");
+    for(i = 0; i < NUM_PHASES; i++) {
+        int count = phase_stats(num_jobs, -1, i, stats);
+        if(count == 0) {
+            printf("%-10s %8d\n", phase_names[i], 0);
+            continue;
+        }
+        printf("%-10s %8d %10.1f %10.1f %10.1f %10.1f\n", phase_names[i], count,
+            stats[0] / 1e3, stats[1] / 1e3, stats[2] / 1e3, stats[3] / 1e3);
+    }
+
+    printf("\ncpu per job %.1f ms in simulate and what it waited for, %.1f ms machine wide\n",
+        cpu / num_jobs * 1e3, busy / num_jobs * 1e3);
+    // maxrss goes by the largest of simulate and the compilers it waited for
+    printf("simulates held %.1f MB resident at most together, one job or its compiler %.1f MB\n", peak_rss_kb / 1024.0, maxrss / 1024.0);
+    if(base_kb >= 0) {
+        // the shared libraries are counted in every simulate above but only once here
+        printf("memory in use peaked %.1f MB above the %.1f MB at the start\n",
+            (base_kb - low_kb) / 1024.0, (proc_kb("/proc/meminfo", "MemTotal") - base_kb) / 1024.0);
+    }
+
+    printf("\n%-16s %6s %6s %10s %10s %10s\n", "sketch", "jobs", "errors", "e2e p50", "e2e p95", "cpu ms");
+    for(i = 0; i < num_sketches; i++) {
+        int count = 0, errors = 0;
+        double sketch_cpu = 0;
+        for(j = 0; j < num_jobs; j++) {
+            if(jobs[j].sketch == i) {
+                count++;
+                errors += jobs[j].code != 0;
+                sketch_cpu += jobs[j].cpu_sec;
+            }
+        }
+        if(count == 0) {
+            continue;
+        }
+        phase_stats(num_jobs, i, E2E, stats);
+        printf("%-16s %6d %6d %10.1f %10.1f %10.1f\n", sketches[i].name, count, errors,
+            stats[0] / 1e3, stats[1] / 1e3, sketch_cpu / count * 1e3);
+    }
+
+    printf("\nexit codes:");
+    for(i = 0; i <= MAX_CODE; i++) {
+        if(codes[i] > 0) {
+            printf(" %d x%d", i, codes[i]);
+        }
+    }
+    printf("\n");
+}
+
+void usage(char *name) {
+    fprintf(stderr, "usage: %s [--jobs N] [--rate PER_SEC] [--concurrency N] [--mix NAME=WEIGHT,...]\n"
+        "       [--corpus DIR] [--simulator DIR] [--extra '\"key\":value,...'] [--seed N] [--warm] [--verbose]\n", name);
+    exit(EXIT_FAILURE);
+}
+
+// usage: loadgen [options], see usage() above
+// jobs defaults to 100, concurrency to one per core. with a rate, jobs arrive
+// at random at that rate on average and queue for one of concurrency places.
+// without one, a new job arrives whenever one finishes.
+int main(int argc, char *argv[]) {
+    char *corpus = CORPUS_DIR;
+    char *mix = NULL;
+    int num_jobs = 100;
+    int concurrency = sysconf(_SC_NPROCESSORS_ONLN);
+    double rate = 0;
+    int i;
+
+    for(i = 1; i < argc; i++) {
+        if(!strcmp(argv[i], "--jobs") && i + 1 < argc) {
+            num_jobs = atoi(argv[++i]);
+        } else if(!strcmp(argv[i], "--rate") && i + 1 < argc) {
+            rate = atof(argv[++i]);
+        } else if(!strcmp(argv[i], "--concurrency") && i + 1 < argc) {
+            concurrency = atoi(argv[++i]);
+        } else if(!strcmp(argv[i], "--mix") && i + 1 < argc) {
+            mix = argv[++i];
+        } else if(!strcmp(argv[i], "--corpus") && i + 1 < argc) {
+            corpus = argv[++i];
+        } else if(!strcmp(argv[i], "--simulator") && i + 1 < argc) {
+            simulator_dir = argv[++i];
+        } else if(!strcmp(argv[i], "--extra") && i + 1 < argc) {
+            extra = argv[++i];
+        } else if(!strcmp(argv[i], "--seed") && i + 1 < argc) {
+            seed = atol(argv[++i]);
+        } else if(!strcmp(argv[i], "--warm")) {
+            warm = 1;
+        } else if(!strcmp(argv[i], "--verbose")) {
+            verbose = 1;
+        } else {
+            usage(argv[0]);
+        }
+    }
+
+    if(num_jobs < 1 || num_jobs > MAX_JOBS || concurrency < 1 || concurrency > MAX_RUNNING || rate < 0) {
+        fprintf(stderr, "loadgen: jobs go from 1 to %d and concurrency from 1 to %d\n", MAX_JOBS, MAX_RUNNING);
+        return EXIT_FAILURE;
+    }
+
+    load_corpus(corpus);
+    if(mix != NULL) {
+        parse_mix(mix);
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    srand48(seed);
+
+    for(i = 0; i < num_jobs; i++) {
+        jobs[i].sketch = pick_sketch();
+        jobs[i].pid = 0;
+        for(int j = 0; j < NUM_PHASES; j++) {
+            jobs[i].usec[j] = -1;
+        }
+    }
+
+    long base_kb = proc_kb("/proc/meminfo", "MemAvailable");
+    long low_kb = base_kb;
+    long peak_rss_kb = 0;
+    double busy = busy_sec();
+    long begin = now_usec();
+    long next_arrival = begin;
+    int arrived = 0, started = 0, finished = 0, running = 0, most_running = 0;
+
+    while(finished < num_jobs) {
+        long now = now_usec();
+
+        // open loop jobs arrive whether or not anything is free to take them
+        while(rate > 0 && arrived < num_jobs && next_arrival <= now) {
+            jobs[arrived++].arrived_usec = next_arrival;
+            next_arrival += (long)(-log(1 - drand48()) / rate * 1e6);
+        }
+
+        while(started < num_jobs && running < concurrency && (rate == 0 || started < arrived)) {
+            if(rate == 0) {
+                jobs[started].arrived_usec = now_usec();
+                arrived++;
+            }
+            start_job(started++);
+            running++;
+        }
+        if(running > most_running) {
+            most_running = running;
+        }
+
+        struct pollfd fds[3 * MAX_RUNNING];
+        struct job *owners[3 * MAX_RUNNING];
+        int count = 0;
+        for(i = 0; i < started; i++) {
+            if(jobs[i].pid == 0) {
+                continue;
+            }
+            for(int j = 0; j < 3; j++) {
+                if(jobs[i].fds[j] >= 0) {
+                    fds[count].fd = jobs[i].fds[j];
+                    fds[count].events = POLLIN;
+                    owners[count++] = &jobs[i];
+                }
+            }
+        }
+
+        int timeout = SAMPLE_MSEC;
+        if(rate > 0 && arrived < num_jobs) {
+            long wait = (next_arrival - now_usec()) / 1000;
+            timeout = wait < 0 ? 0 : wait < timeout ? (int)wait : timeout;
+        }
+        poll(fds, count, timeout);
+
+        for(i = 0; i < count; i++) {
+            if(fds[i].revents != 0) {
+                struct job *job = owners[i];
+                for(int j = 0; j < 3; j++) {
+                    if(job->fds[j] == fds[i].fd) {
+                        drain(job, j);
+                    }
+                }
+            }
+        }
+
+        int status;
+        struct rusage usage;
+        pid_t pid;
+        while((pid = wait4(-1, &status, WNOHANG, &usage)) > 0) {
+            for(i = 0; i < started && jobs[i].pid != pid; i++);
+            if(i == started) {
+                continue;
+            }
+
+            finish_job(&jobs[i], status, &usage);
+            finished++;
+            running--;
+            if(verbose) {
+                fprintf(stderr, "%4d %-14s %3d %-10s e2e %8.1f ms cpu %7.1f ms\n", i, sketches[jobs[i].sketch].name,
+                    jobs[i].code, jobs[i].reason, jobs[i].usec[E2E] / 1e3, jobs[i].cpu_sec * 1e3);
+            }
+        }
+
+        long available = proc_kb("/proc/meminfo", "MemAvailable");
+        if(available >= 0 && available < low_kb) {
+            low_kb = available;
+        }
+
+        long rss_kb = 0;
+        for(i = 0; i < started; i++) {
+            if(jobs[i].pid != 0) {
+                char status_file[32];
+                sprintf(status_file, "/proc/%d/status", (int)jobs[i].pid);
+                long kb = proc_kb(status_file, "VmRSS");
+                rss_kb += kb > 0 ? kb : 0;
+            }
+        }
+        if(rss_kb > peak_rss_kb) {
+            peak_rss_kb = rss_kb;
+        }
+    }
+
+    report(num_jobs, rate, concurrency, (now_usec() - begin) / 1e6, base_kb, low_kb, peak_rss_kb, busy_sec() - busy, most_running);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,65 @@
+#ifndef LOADGEN_H
+#define LOADGEN_H
+
+#include <sys/types.h>
+
+// where simulate and the corpus are, relative to the loadgen directory
+#define SIMULATOR_DIR "../simulator/simulator"
+#define CORPUS_DIR "corpus"
+// simulate writes its phase times to this fd of ours, see simulator/metrics.h
+#define PHASES_ENV "VS_PHASES_FD"
+#define PHASES_FD 3
+#define MAX_SKETCHES 32
+#define MAX_JOBS 4096
+#define MAX_RUNNING 256
+// the end of a job's output is kept to find its end reason in
+#define TAIL_LENGTH 512
+#define PHASES_LENGTH 256
+// how often memory is sampled while jobs run
+#define SAMPLE_MSEC 10
+// exit codes counted one by one, simulate's go up to MAX_ERROR_CODE in
+// simulator/metrics.h and a signal counts as 128 and its number like in a shell
+#define MAX_CODE 192
+
+// the functions the middleware gives the line they are called from, see
+// preprocess() in middleware
+#define LINE_ARGUMENT "__LINE__ - 2"
+
+// queue is arrival to start, e2e arrival to exit, the rest are simulate's own
+enum phase {
+    QUEUE = 0,
+    COMPILE,
+    START,
+    SIMULATE,
+    TOTAL,
+    E2E,
+    NUM_PHASES
+};
+
+struct sketch {
+    char name[64];
+    char *code;
+    int weight;
+};
+
+struct job {
+    int sketch;
+    pid_t pid;
+    // stdout, stderr and the phase pipe, -1 once closed
+    int fds[3];
+    char tail[TAIL_LENGTH];
+    int tail_length;
+    char phases[PHASES_LENGTH];
+    int phases_length;
+    long arrived_usec;
+    long started_usec;
+    long ended_usec;
+    // -1 for a phase simulate never got to
+    long usec[NUM_PHASES];
+    double cpu_sec;
+    long maxrss_kb;
+    int code;
+    char reason[32];
+};
+
+#endif
@@ -0,0 +1,59 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "arena.h"
+#include "rng.h"
+
+// fills in the obstacles and destination of a randomized arena and where its osv starts.
+// the same seed always gives the same arena. osv size and sensors are left to the caller.
+int randomize_arena(unsigned int seed, struct arena *arena, struct coordinate *start) {
+    struct rng r;
+    int i, randomization;
+    float baseY, xMin, xMax, yMin, yMax;
+
+    static const int presets[6][3] = {
+        {0, 1, 2},
+        {2, 1, 0},
+        {0, 2, 1},
+        {2, 0, 1},
+        {1, 0, 2},
+        {1, 2, 0}
+    };
+
+    rng_seed(&r, seed);
+    randomization = rng_range(&r, 6);
+
+    //generate starting location
+    start->x = 0.35;
+    start->y = 0.4 + rng_range(&r, 5) * 0.3;
+    start->theta = rng_range(&r, 4) * PI / 2 - PI;
+
+    //generate obstacles
+    arena->obstacles = (struct obstacle *)malloc(NUM_RANDOM_OBSTACLES * sizeof(struct obstacle));
+    if(arena->obstacles == NULL) {
+        return -1;
+    }
+
+    for(i = 0; i < NUM_RANDOM_OBSTACLES; i++) {
+        baseY = presets[randomization][i] * 0.65 + OBSTACLE_HEIGHT + 0.1;
+        arena->obstacles[i].location.x = i * 0.55 + 1.5;
+        arena->obstacles[i].location.y = baseY;
+        arena->obstacles[i].location.theta = 0;
+        arena->obstacles[i].width = OBSTACLE_WIDTH;
+        arena->obstacles[i].height = OBSTACLE_HEIGHT;
+    }
+    arena->num_obstacles = NUM_RANDOM_OBSTACLES;
+
+    //generate destination
+    xMin = 2.8 + 0.4 + TARGET_DIAMETER / 2;
+    xMax = 4 - OSV_WIDTH - 0.1 - TARGET_DIAMETER / 2;
+    yMin = 0.4 + TARGET_DIAMETER / 2;
+    yMax = 2 - 0.4 - TARGET_DIAMETER / 2;
+
+    // we now have ranges
+    arena->destination.x = rng_range(&r, 100) / 100.0 * (xMax - xMin) + xMin;
+    arena->destination.y = rng_range(&r, 100) / 100.0 * (yMax - yMin) + yMin;
+    arena->destination.theta = 0;
+
+    return 0;
+}
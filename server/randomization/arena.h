@@ -0,0 +1,14 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include "vs.h"
+
+#define OBSTACLE_WIDTH 0.2f
+#define OBSTACLE_HEIGHT 0.5f
+#define TARGET_DIAMETER 0.18f
+#define OSV_WIDTH 0.35f
+#define NUM_RANDOM_OBSTACLES 3
+
+int randomize_arena(unsigned int seed, struct arena *arena, struct coordinate *start);
+
+#endif
@@ -1,126 +1,98 @@
 #include "randomize.h"
 
-static int print_preallocated(cJSON *root) {
-    char *out = NULL;
-    char *buf = NULL;
-    char *buf_fail = NULL;
-    size_t len = 0;
-    size_t len_fail = 0;
-
-    out = cJSON_Print(root);
-
-    len = strlen(out) + 5;
-    buf = (char*)malloc(len);
-    if (buf == NULL) {
-        fprintf(stdout,"Failed to allocate memory.\n");
-        exit(1);
-    }
-
-    len_fail = strlen(out);
-    buf_fail = (char*)malloc(len_fail);
-    if (buf_fail == NULL) {
-        fprintf(stdout,"Failed to allocate memory.\n");
-        exit(1);
-    }
-
-    if (!cJSON_PrintPreallocated(root, buf, (int)len, 1)) {
-        fprintf(stdout,"cJSON_PrintPreallocated failed!\n");
-        if (strcmp(out, buf) != 0) {
-            fprintf(stdout,"cJSON_PrintPreallocated not the same as cJSON_Print!\n");
-            fprintf(stdout,"cJSON_Print result:\n%s\n", out);
-            fprintf(stdout,"cJSON_PrintPreallocated result:\n%s\n", buf);
-        }
-        free(out);
-        free(buf_fail);
-        free(buf);
-        return -1;
-    }
-
-    fprintf(stdout,"%s\n", buf);
-
-    if (cJSON_PrintPreallocated(root, buf_fail, (int)len_fail, 1)) {
-        fprintf(stdout,"cJSON_PrintPreallocated failed to show error with insufficient memory!\n");
-        fprintf(stdout,"cJSON_Print result:\n%s\n", out);
-        fprintf(stdout,"cJSON_PrintPreallocated result:\n%s\n", buf_fail);
-        free(out);
-        free(buf_fail);
-        free(buf);
-        return -1;
-    }
-
-    free(out);
-    free(buf_fail);
-    free(buf);
-    return 0;
-}
-
-void randomize(void) {
+// this builds the randomization message the front end expects
+cJSON* arena_json(unsigned int seed, struct arena *arena, struct coordinate *start) {
     cJSON *root = NULL;
     cJSON *osv = NULL;
     cJSON *point = NULL;
     cJSON *obstacles = NULL;
     cJSON *dest = NULL;
-    int i, randomization = rand() % 6;
-    float baseY, xMin, xMax, yMin, yMax, destX, destY;
-
-    static const int presets[6][3] = {
-        {0, 1, 2},
-        {2, 1, 0},
-        {0, 2, 1},
-        {2, 0, 1},
-        {1, 0, 2},
-        {1, 2, 0}
-    };
+    int i;
 
-
-    //generate starting location
     root = cJSON_CreateObject();
     cJSON_AddItemToObject(root, "type", cJSON_CreateString("randomization"));
     cJSON_AddItemToObject(root, "osv", osv = cJSON_CreateObject());
-    cJSON_AddNumberToObject(osv, "x", 0.35);
-    cJSON_AddNumberToObject(osv, "y", 0.4 + (rand() % 5)*0.3);
-    cJSON_AddNumberToObject(osv, "theta", (rand() % 4) * PI/2 - PI);
+    cJSON_AddNumberToObject(osv, "x", start->x);
+    cJSON_AddNumberToObject(osv, "y", start->y);
+    cJSON_AddNumberToObject(osv, "theta", start->theta);
 
-    //generate obstacles
     obstacles = cJSON_CreateArray();
-    for(int i = 0; i < 3; i++) {
-        baseY = presets[randomization][i] * 0.65 + OBSTACLE_HEIGHT + 0.1;
+    for(i = 0; i < arena->num_obstacles; i++) {
         point = cJSON_CreateObject();
-        cJSON_AddNumberToObject(point, "x", i * 0.55 + 1.5);
-        cJSON_AddNumberToObject(point, "y", baseY);
-        cJSON_AddNumberToObject(point, "width", 0.2);
-        cJSON_AddNumberToObject(point, "height", 0.5);
+        cJSON_AddNumberToObject(point, "x", arena->obstacles[i].location.x);
+        cJSON_AddNumberToObject(point, "y", arena->obstacles[i].location.y);
+        cJSON_AddNumberToObject(point, "width", arena->obstacles[i].width);
+        cJSON_AddNumberToObject(point, "height", arena->obstacles[i].height);
         cJSON_AddItemToArray(obstacles, point);
     }
     cJSON_AddItemToObject(root, "obstacles", obstacles);
 
-    //generate destination
-    xMin = 2.8 + 0.4 + TARGET_DIAMETER / 2;
-    xMax = 4 - OSV_WIDTH - 0.1 - TARGET_DIAMETER / 2;
-    yMin = 0.4 + TARGET_DIAMETER / 2;
-    yMax = 2 - 0.4 - TARGET_DIAMETER / 2;
-
-    // we now have ranges
-    destX = (rand() % 100) / 100.0 * (xMax - xMin) + xMin;
-    destY = (rand() % 100) / 100.0 * (yMax - yMin) + yMin;
     dest = cJSON_CreateObject();
-    cJSON_AddNumberToObject(dest, "x", destX);
-    cJSON_AddNumberToObject(dest, "y", destY);
+    cJSON_AddNumberToObject(dest, "x", arena->destination.x);
+    cJSON_AddNumberToObject(dest, "y", arena->destination.y);
     cJSON_AddItemToObject(root, "destination", dest);
 
-    if (print_preallocated(root) != 0) {
-        cJSON_Delete(root);
-        exit(EXIT_FAILURE);
+    // the seed regenerates this same arena, a request can send it alone
+    cJSON_AddNumberToObject(root, "seed", seed);
+
+    return root;
+}
+
+// prints one arena, compact ones are a single line so batches come out as NDJSON
+void randomize(unsigned int seed, int compact) {
+    struct arena arena;
+    struct coordinate start;
+    char *out = NULL;
+
+    if(randomize_arena(seed, &arena, &start) != 0) {
+        fprintf(stdout,"Failed to allocate memory.\n");
+        exit(1);
+    }
+
+    cJSON *root = arena_json(seed, &arena, &start);
+    out = compact ? cJSON_PrintUnformatted(root) : cJSON_Print(root);
+    if(out == NULL) {
+        fprintf(stdout,"Failed to allocate memory.\n");
+        exit(1);
     }
+
+    fprintf(stdout,"%s\n", out);
+
+    free(out);
     cJSON_Delete(root);
+    free(arena.obstacles);
 }
 
-int main() {
+// usage: randomize [--seed S] [--count N]
+// without --count a single arena is printed as before, with it N arenas
+// (seeds S, S + 1, ...) are streamed one per line.
+int main(int argc, char *argv[]) {
     struct timeval time_for_seed;
     gettimeofday(&time_for_seed, NULL);
-    unsigned long seed = time_for_seed.tv_usec * time_for_seed.tv_sec;
-    srand(seed);
+    unsigned int seed = time_for_seed.tv_usec * time_for_seed.tv_sec;
+    long count = 0;
+    long i;
+
+    for(i = 1; i < argc; i++) {
+        if(!strcmp(argv[i], "--seed") && i + 1 < argc) {
+            seed = strtoul(argv[++i], NULL, 10);
+        } else if(!strcmp(argv[i], "--count") && i + 1 < argc) {
+            count = strtol(argv[++i], NULL, 10);
+        } else {
+            fprintf(stderr, "usage: %s [--seed S] [--count N]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if(count <= 0) {
+        randomize(seed, 0);
+        return 0;
+    }
+
+    for(i = 0; i < count; i++) {
+        randomize(seed + i, 1);
+    }
 
-    randomize();
+    fflush(stdout);
     return 0;
 }
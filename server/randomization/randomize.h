@@ -4,12 +4,7 @@
 #include <sys/time.h>
 #include <cjson/cJSON.h>
 
-#define PI 3.14159f
-#define OBSTACLE_WIDTH 0.2f
-#define OBSTACLE_HEIGHT 0.5f
-#define TARGET_DIAMETER 0.18f
-#define OSV_WIDTH 0.35f
-
-static int print_preallocated(cJSON *root);
-void randomize(void);
+#include "arena.h"
 
+cJSON* arena_json(unsigned int seed, struct arena *arena, struct coordinate *start);
+void randomize(unsigned int seed, int compact);
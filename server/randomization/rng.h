@@ -0,0 +1,15 @@
+#ifndef RNG_H
+#define RNG_H
+
+#include <stdint.h>
+
+// xoshiro256** generator, seeded through splitmix64 so any seed (even 0) is usable
+struct rng {
+    uint64_t s[4];
+};
+
+void rng_seed(struct rng *r, uint64_t seed);
+uint64_t rng_next(struct rng *r);
+unsigned int rng_range(struct rng *r, unsigned int n);
+
+#endif
@@ -0,0 +1,15 @@
+#include "Enes100.h"
+
+void setup() {
+    Enes100.begin("Team Collide", DEBRIS, 3, 8, 9);
+    Tank.begin();
+}
+
+void loop() {
+    Tank.setLeftMotorPWM(255);
+    Tank.setRightMotorPWM(255);
+    delay(2000);
+    Tank.setLeftMotorPWM(-200);
+    Tank.setRightMotorPWM(200);
+    delay(600);
+}
@@ -0,0 +1,15 @@
+#include "Enes100.h"
+
+void setup() {
+    Enes100.begin("Team Delay", FIRE, 3, 8, 9);
+    Tank.begin();
+    Tank.setLeftMotorPWM(180);
+    Tank.setRightMotorPWM(160);
+}
+
+void loop() {
+    Enes100.updateLocation();
+    Enes100.println(Enes100.location.theta);
+    // the run ends while the sketch sleeps in here
+    delay(2500);
+}
@@ -0,0 +1,15 @@
+#include "Enes100.h"
+
+void setup() {
+    Enes100.begin("Team Drive", FIRE, 3, 8, 9);
+    Tank.begin();
+    Tank.setLeftMotorPWM(255);
+    Tank.setRightMotorPWM(200);
+}
+
+void loop() {
+    float d = Tank.readDistanceSensor(1);
+    Enes100.println(d);
+    Enes100.updateLocation();
+    delay(100);
+}
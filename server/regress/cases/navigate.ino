@@ -0,0 +1,40 @@
+#include "Enes100.h"
+#include <math.h>
+
+void setup() {
+    Enes100.begin("Team Navigate", CHEMICAL, 3, 8, 9);
+    Tank.begin();
+}
+
+void loop() {
+    if(!Enes100.updateLocation()) {
+        delay(100);
+        return;
+    }
+
+    float dx = Enes100.destination.x - Enes100.location.x;
+    float dy = Enes100.destination.y - Enes100.location.y;
+    if(dx * dx + dy * dy < 0.01) {
+        Tank.turnOffMotors();
+        Enes100.mission(WATER);
+        delay(1000);
+        return;
+    }
+
+    float error = atan2(dy, dx) - Enes100.location.theta;
+    while(error > M_PI) {
+        error -= 2 * M_PI;
+    }
+    while(error < -M_PI) {
+        error += 2 * M_PI;
+    }
+
+    if(fabs(error) > 0.15) {
+        Tank.setLeftMotorPWM(error > 0 ? -90 : 90);
+        Tank.setRightMotorPWM(error > 0 ? 90 : -90);
+    } else {
+        Tank.setLeftMotorPWM(230);
+        Tank.setRightMotorPWM(230);
+    }
+    delay(40);
+}
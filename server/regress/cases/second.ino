@@ -0,0 +1,18 @@
+#include "Enes100.h"
+
+void setup() {
+    Enes100.begin("Team Second", FIRE, 4, 8, 9);
+    Tank.begin();
+}
+
+void loop() {
+    float front = Tank.readDistanceSensor(1);
+    if(front > 0 && front < 0.3) {
+        Tank.setLeftMotorPWM(-150);
+        Tank.setRightMotorPWM(150);
+    } else {
+        Tank.setLeftMotorPWM(200);
+        Tank.setRightMotorPWM(200);
+    }
+    delay(100);
+}
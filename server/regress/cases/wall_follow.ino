@@ -0,0 +1,26 @@
+#include "Enes100.h"
+
+const float NEAR = 0.3;
+
+void setup() {
+    Enes100.begin("Team Wall", WATER, 3, 8, 9);
+    Tank.begin();
+}
+
+void loop() {
+    float left = Tank.readDistanceSensor(0);
+    float front = Tank.readDistanceSensor(1);
+    float right = Tank.readDistanceSensor(2);
+
+    if(front > 0 && front < NEAR) {
+        Tank.setLeftMotorPWM(left > right ? -120 : 120);
+        Tank.setRightMotorPWM(left > right ? 120 : -120);
+    } else if(right > 0 && right < NEAR) {
+        Tank.setLeftMotorPWM(150);
+        Tank.setRightMotorPWM(220);
+    } else {
+        Tank.setLeftMotorPWM(220);
+        Tank.setRightMotorPWM(200);
+    }
+    delay(50);
+}
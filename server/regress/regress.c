@@ -0,0 +1,931 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "regress.h"
+
+// plays a fixed set of sketches and arenas out in deterministic mode and holds
+// every record of the output, poses, commands, prints and the summary, against
+// the golden recorded for it. physics can be made faster, it cannot quietly
+// make the osv drive somewhere else.
+//
+// a case is cases/<name>.json, the request without its code, and the sketch
+// in cases/<sketch>.ino, named by a "sketch" member or after the case. a robot
+// of the case names its sketch the same way. sketches are plain source and get
+// preprocessed here the way the middleware does it. every case also gets
+// timed, against the time recorded with its golden or against a second
+// simulate given with --baseline, so one run says both whether a change is the
+// same and whether it is faster.
+
+static const char *phase_names[NUM_PHASES] = {"compile", "start", "simulate", "total"};
+
+static double position_tolerance = POSITION_TOLERANCE;
+static double angle_tolerance = ANGLE_TOLERANCE;
+static double summary_tolerance = SUMMARY_TOLERANCE;
+
+void append(struct buffer *b, const char *data, size_t length) {
+    if(b->length + length + 1 > b->size) {
+        b->size = (b->length + length + 1) * 2;
+        b->data = (char *)realloc(b->data, b->size);
+        if(b->data == NULL) {
+            perror("regress");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    memcpy(b->data + b->length, data, length);
+    b->length += length;
+    b->data[b->length] = '\0';
+}
+
+void append_string(struct buffer *b, const char *s) {
+    append(b, s, strlen(s));
+}
+
+void append_json(struct buffer *b, const char *s) {
+    char escape[8];
+
+    append_string(b, "\"");
+    for(; *s != '\0'; s++) {
+        if(*s == '"' || *s == '\\') {
+            sprintf(escape, "\\%c", *s);
+        } else if(*s == '\n') {
+            strcpy(escape, "\\n");
+        } else if(*s == '\t') {
+            strcpy(escape, "\\t");
+        } else if((unsigned char)*s < 0x20) {
+            sprintf(escape, "\\u%04x", *s);
+        } else {
+            append(b, s, 1);
+            continue;
+        }
+        append_string(b, escape);
+    }
+    append_string(b, "\"");
+}
+
+void free_buffer(struct buffer *b) {
+    free(b->data);
+    b->data = NULL;
+    b->length = 0;
+    b->size = 0;
+}
+
+char *read_file(const char *path) {
+    FILE *fp = fopen(path, "r");
+    if(fp == NULL) {
+        return NULL;
+    }
+
+    struct buffer b = {NULL, 0, 0};
+    char chunk[65536];
+    size_t size;
+    append(&b, "", 0);
+    while((size = fread(chunk, 1, sizeof(chunk), fp)) > 0) {
+        append(&b, chunk, size);
+    }
+
+    fclose(fp);
+    return b.data;
+}
+
+// the length of object.name( at p, 0 when p is not such a call
+static size_t match_call(const char *p, const char *object, const char *name) {
+    const char *q = p;
+
+    if(object != NULL) {
+        size_t length = strlen(object);
+        if(strncmp(q, object, length)) {
+            return 0;
+        }
+        q += length;
+        while(isspace(*q)) {
+            q++;
+        }
+        if(*q++ != '.') {
+            return 0;
+        }
+        while(isspace(*q)) {
+            q++;
+        }
+    }
+
+    size_t length = strlen(name);
+    if(strncmp(q, name, length) || isalnum(q[length]) || q[length] == '_') {
+        return 0;
+    }
+    q += length;
+    while(isspace(*q)) {
+        q++;
+    }
+
+    return *q == '(' ? q + 1 - p : 0;
+}
+
+// what preprocess() in the middleware does to a sketch, every call it knows
+// about gets the line it is on as its first argument, same as in loadgen
+char *preprocess(const char *code) {
+    static const char *calls[][2] = {
+        {"Enes100", "begin"}, {"Enes100", "updateLocation"}, {"Enes100", "mission"},
+        {"Enes100", "print"}, {"Enes100", "println"},
+        {"Tank", "readDistanceSensor"}, {"Tank", "turnOffMotors"},
+        {"Tank", "setRightMotorPWM"}, {"Tank", "setLeftMotorPWM"},
+        {NULL, "delay"}
+    };
+    struct buffer b = {NULL, 0, 0};
+    const char *p = code;
+    size_t i;
+
+    append(&b, "", 0);
+    while(*p != '\0') {
+        if(p[0] == '/' && p[1] == '/') {
+            const char *end = strchr(p, '\n');
+            size_t length = end != NULL ? (size_t)(end - p) : strlen(p);
+            append(&b, p, length);
+            p += length;
+            continue;
+        }
+
+        if(p[0] == '/' && p[1] == '*') {
+            const char *end = strstr(p + 2, "*/");
+            size_t length = end != NULL ? (size_t)(end + 2 - p) : strlen(p);
+            append(&b, p, length);
+            p += length;
+            continue;
+        }
+
+        if(*p == '"' || *p == '\'') {
+            const char *q = p + 1;
+            while(*q != '\0' && *q != *p) {
+                q += q[0] == '\\' && q[1] != '\0' ? 2 : 1;
+            }
+            size_t length = *q != '\0' ? (size_t)(q + 1 - p) : (size_t)(q - p);
+            append(&b, p, length);
+            p += length;
+            continue;
+        }
+
+        // a call has to start a word, otherwise foo_delay( would match
+        size_t length = 0;
+        if(p == code || !(isalnum(p[-1]) || p[-1] == '_' || p[-1] == '.')) {
+            for(i = 0; i < sizeof(calls) / sizeof(calls[0]) && length == 0; i++) {
+                length = match_call(p, calls[i][0], calls[i][1]);
+            }
+        }
+
+        if(length == 0) {
+            append(&b, p, 1);
+            p++;
+            continue;
+        }
+
+        append(&b, p, length);
+        p += length;
+
+        const char *q = p;
+        while(isspace(*q)) {
+            q++;
+        }
+        append_string(&b, *q == ')' ? LINE_ARGUMENT : LINE_ARGUMENT ", ");
+    }
+
+    return b.data;
+}
+
+// cases/<sketch>.ino as the middleware hands it on, NULL if there is none
+static char *read_sketch(const char *sketch) {
+    char path[sizeof(CASES_DIR) + NAME_LENGTH + 8];
+
+    snprintf(path, sizeof(path), "%s%s.ino", CASES_DIR, sketch);
+    char *source = read_file(path);
+    if(source == NULL) {
+        return NULL;
+    }
+
+    char *code = preprocess(source);
+    free(source);
+    return code;
+}
+
+// copies json to b with every "sketch": "<name>" member, the case's own and
+// those of its robots, turned into the code of that sketch. 1 when the case
+// itself names one, 0 when it does not and -1 when a sketch could not be read.
+static int expand_sketches(const char *json, struct buffer *b) {
+    const char *p = json;
+    int depth = 0, found = 0;
+
+    while(*p != '\0') {
+        if(*p == '{' || *p == '[') {
+            depth++;
+        } else if(*p == '}' || *p == ']') {
+            depth--;
+        }
+
+        if(*p != '"') {
+            append(b, p, 1);
+            p++;
+            continue;
+        }
+
+        char sketch[NAME_LENGTH];
+        int length = 0;
+        if(sscanf(p, "\"sketch\" : \"%63[^\"]\"%n", sketch, &length) == 1 && length > 0) {
+            char *code = read_sketch(sketch);
+            if(code == NULL) {
+                return -1;
+            }
+            append_string(b, "\"code\":");
+            append_json(b, code);
+            free(code);
+            found |= depth == 1;
+            p += length;
+            continue;
+        }
+
+        // any other string goes over as it is, braces in it included
+        const char *q = p + 1;
+        while(*q != '\0' && *q != '"') {
+            q += q[0] == '\\' && q[1] != '\0' ? 2 : 1;
+        }
+        if(*q == '"') {
+            q++;
+        }
+        append(b, p, q - p);
+        p = q;
+    }
+
+    return found;
+}
+
+// the request of case name as the middleware would send it, NULL if it has no
+// case file or one of its sketches is missing
+char *build_request(const char *name) {
+    char path[sizeof(CASES_DIR) + NAME_LENGTH + 8];
+
+    snprintf(path, sizeof(path), "%s%s.json", CASES_DIR, name);
+    char *json = read_file(path);
+    if(json == NULL) {
+        return NULL;
+    }
+
+    char *body = strchr(json, '{');
+    struct buffer expanded = {NULL, 0, 0};
+    append(&expanded, "", 0);
+    int found = body != NULL ? expand_sketches(body, &expanded) : -1;
+    free(json);
+    if(found < 0) {
+        free_buffer(&expanded);
+        return NULL;
+    }
+
+    // the result cache would hand back the run we are trying to time
+    struct buffer b = {NULL, 0, 0};
+    append_string(&b, "{\"id\":\"regress_");
+    append_string(&b, name);
+    append_string(&b, "\",\"deterministic\":true,\"cache\":false");
+    if(!found) {
+        char *code = read_sketch(name);
+        if(code == NULL) {
+            free_buffer(&expanded);
+            free_buffer(&b);
+            return NULL;
+        }
+        append_string(&b, ",\"code\":");
+        append_json(&b, code);
+        free(code);
+    }
+
+    for(body = expanded.data + 1; isspace(*body); body++);
+    if(*body != '}') {
+        append_string(&b, ",");
+    }
+    append_string(&b, body);
+
+    free_buffer(&expanded);
+    return b.data;
+}
+
+// reads what fd has for b, closing it and setting it to -1 at its end
+static void drain(int *fd, struct buffer *b) {
+    char chunk[65536];
+    ssize_t size;
+
+    while(*fd >= 0 && (size = read(*fd, chunk, sizeof(chunk))) != 0) {
+        if(size < 0) {
+            return;
+        }
+        append(b, chunk, size);
+    }
+
+    if(*fd >= 0) {
+        close(*fd);
+        *fd = -1;
+    }
+}
+
+// runs the simulate in dir on request. a sketch that outlives simulate may
+// hold its stderr, so the pipes are only read until simulate itself is gone.
+void run_simulate(const char *dir, const char *request, struct run *run) {
+    int in[2], out[2], err[2], phases[2];
+    int i;
+
+    memset(run, 0, sizeof(struct run));
+    for(i = 0; i < NUM_PHASES; i++) {
+        run->usec[i] = -1;
+    }
+    append(&run->output, "", 0);
+    append(&run->errors, "", 0);
+    append(&run->phases, "", 0);
+
+    if(pipe2(in, O_CLOEXEC) || pipe2(out, O_CLOEXEC) || pipe2(err, O_CLOEXEC) || pipe2(phases, O_CLOEXEC)) {
+        perror("regress");
+        exit(EXIT_FAILURE);
+    }
+
+    pid_t pid = fork();
+    if(pid < 0) {
+        perror("regress");
+        exit(EXIT_FAILURE);
+    }
+
+    if(pid == 0) {
+        // every pipe end is above 2 since ours are open, so this order is safe
+        dup2(in[0], STDIN_FILENO);
+        dup2(out[1], STDOUT_FILENO);
+        dup2(err[1], STDERR_FILENO);
+        if(phases[1] == PHASES_FD) {
+            fcntl(PHASES_FD, F_SETFD, 0);
+        } else {
+            dup2(phases[1], PHASES_FD);
+        }
+
+        char fd[16];
+        sprintf(fd, "%d", PHASES_FD);
+        setenv(PHASES_ENV, fd, 1);
+        if(chdir(dir) == 0) {
+            execl("./simulate", "simulate", (char *)NULL);
+        }
+        perror("simulate");
+        _exit(127);
+    }
+
+    close(in[0]);
+    close(out[1]);
+    close(err[1]);
+    close(phases[1]);
+
+    // simulate reads the whole request before it writes anything
+    size_t length = strlen(request), done = 0;
+    while(done < length) {
+        ssize_t size = write(in[1], request + done, length - done);
+        if(size <= 0) {
+            break;
+        }
+        done += size;
+    }
+    close(in[1]);
+
+    int fds[3] = {out[0], err[0], phases[0]};
+    struct buffer *buffers[3] = {&run->output, &run->errors, &run->phases};
+    for(i = 0; i < 3; i++) {
+        fcntl(fds[i], F_SETFL, O_NONBLOCK);
+    }
+
+    int status;
+    while(waitpid(pid, &status, WNOHANG) == 0) {
+        struct pollfd polled[3];
+        int count = 0;
+        for(i = 0; i < 3; i++) {
+            if(fds[i] >= 0) {
+                polled[count].fd = fds[i];
+                polled[count++].events = POLLIN;
+            }
+        }
+
+        poll(polled, count, 10);
+        for(i = 0; i < 3; i++) {
+            drain(&fds[i], buffers[i]);
+        }
+    }
+
+    for(i = 0; i < 3; i++) {
+        drain(&fds[i], buffers[i]);
+        if(fds[i] >= 0) {
+            close(fds[i]);
+        }
+    }
+
+    run->code = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+    char *line;
+    for(line = strtok(run->phases.data, "\n"); line != NULL; line = strtok(NULL, "\n")) {
+        char name[32];
+        long usec;
+        if(sscanf(line, "%31s %ld", name, &usec) != 2) {
+            continue;
+        }
+        for(i = 0; i < NUM_PHASES; i++) {
+            if(!strcmp(name, phase_names[i])) {
+                run->usec[i] = usec;
+            }
+        }
+    }
+}
+
+void free_run(struct run *run) {
+    free_buffer(&run->output);
+    free_buffer(&run->errors);
+    free_buffer(&run->phases);
+}
+
+// the top level elements of output, which has to be a records array
+int split_records(const char *output, struct record **records) {
+    int count = 0, capacity = 256, depth = 0;
+    const char *p = output, *start = NULL;
+
+    *records = (struct record *)malloc(sizeof(struct record) * capacity);
+    while(*p != '\0' && *p != '[') {
+        p++;
+    }
+
+    for(; *p != '\0'; p++) {
+        if(*p == '"') {
+            for(p++; *p != '\0' && *p != '"'; p++) {
+                if(*p == '\\' && p[1] != '\0') {
+                    p++;
+                }
+            }
+            if(*p == '\0') {
+                break;
+            }
+        } else if(*p == '{' || *p == '[') {
+            if(depth++ == 1) {
+                start = p;
+            }
+        } else if(*p == '}' || *p == ']') {
+            if(--depth == 1 && start != NULL) {
+                if(count == capacity) {
+                    capacity *= 2;
+                    *records = (struct record *)realloc(*records, sizeof(struct record) * capacity);
+                }
+                (*records)[count].start = start;
+                (*records)[count++].length = p + 1 - start;
+                start = NULL;
+            }
+        }
+    }
+
+    return count;
+}
+
+static void next_token(const char **p, const char *end, struct token *token) {
+    const char *q = *p;
+
+    while(q < end && isspace(*q)) {
+        q++;
+    }
+
+    token->start = q;
+    if(q >= end) {
+        token->type = END;
+        token->length = 0;
+    } else if(*q == '"') {
+        for(q++; q < end && *q != '"'; q++) {
+            if(*q == '\\') {
+                q++;
+            }
+        }
+        token->type = STRING;
+        q = q < end ? q + 1 : end;
+    } else if(*q == '-' || isdigit(*q)) {
+        char *after;
+        token->type = NUMBER;
+        token->number = strtod(q, &after);
+        q = after > end ? end : after;
+    } else if(isalpha(*q)) {
+        while(q < end && isalpha(*q)) {
+            q++;
+        }
+        token->type = WORD;
+    } else {
+        token->type = PUNCTUATION;
+        q++;
+    }
+
+    token->length = q - token->start;
+    *p = q;
+}
+
+// how far a number under key may be off in a record of kind, 0 for exact and
+// negative for relative
+static double tolerance_for(const char *kind, const char *key) {
+    if(!strcmp(kind, "summary")) {
+        return -summary_tolerance;
+    }
+    if(!strcmp(key, "x") || !strcmp(key, "y") || !strcmp(key, "width") || !strcmp(key, "height")) {
+        return position_tolerance;
+    }
+    if(!strcmp(key, "theta")) {
+        return angle_tolerance;
+    }
+    return 0;
+}
+
+// 1 when now matches golden within the tolerances, otherwise 0 with what
+// differs first in why
+int compare_record(struct record golden, struct record now, char *why, size_t size) {
+    const char *p = golden.start, *q = now.start;
+    const char *p_end = golden.start + golden.length, *q_end = now.start + now.length;
+    char keys[MAX_DEPTH][NAME_LENGTH];
+    int depth = 0, i;
+    struct token a, b;
+
+    memset(keys, 0, sizeof(keys));
+    while(1) {
+        next_token(&p, p_end, &a);
+        next_token(&q, q_end, &b);
+        if(a.type == END && b.type == END) {
+            return 1;
+        }
+
+        // the key path of whatever differs, osvs of a summary are not told apart
+        char path[MAX_DEPTH * NAME_LENGTH] = "";
+        for(i = 1; i <= depth && i < MAX_DEPTH; i++) {
+            if(keys[i][0] != '\0') {
+                if(path[0] != '\0') {
+                    strcat(path, ".");
+                }
+                strcat(path, keys[i]);
+            }
+        }
+
+        int same = a.type == b.type && a.length == b.length && !strncmp(a.start, b.start, a.length);
+        if(!same && a.type == NUMBER && b.type == NUMBER) {
+            double tolerance = tolerance_for(keys[1], depth < MAX_DEPTH ? keys[depth] : "");
+            double off = fabs(a.number - b.number);
+            double allowed = tolerance >= 0 ? tolerance : -tolerance * fmax(fabs(a.number), fabs(b.number));
+            if(off <= allowed) {
+                continue;
+            }
+
+            snprintf(why, size, "%s: %.*s in the golden, %.*s now (off by %.3g, allowed %.3g)",
+                path, a.length, a.start, b.length, b.start, off, allowed);
+            return 0;
+        }
+
+        if(!same) {
+            snprintf(why, size, "%s: %.*s in the golden, %.*s now", path[0] != '\0' ? path : "record",
+                a.length, a.start, b.length, b.start);
+            return 0;
+        }
+
+        if(a.type == PUNCTUATION && (*a.start == '{' || *a.start == '[')) {
+            depth++;
+            if(depth < MAX_DEPTH) {
+                keys[depth][0] = '\0';
+            }
+        } else if(a.type == PUNCTUATION && (*a.start == '}' || *a.start == ']')) {
+            depth--;
+        } else if(a.type == STRING && depth < MAX_DEPTH) {
+            // a string followed by a colon is the key of what comes next
+            const char *after = p;
+            while(after < p_end && isspace(*after)) {
+                after++;
+            }
+            if(after < p_end && *after == ':') {
+                snprintf(keys[depth], NAME_LENGTH, "%.*s", a.length - 2, a.start + 1);
+            }
+        }
+    }
+}
+
+static void show_record(struct buffer *diff, const char *label, struct record record) {
+    char line[SHOWN_LENGTH + 32];
+
+    if(record.length > SHOWN_LENGTH) {
+        snprintf(line, sizeof(line), "    %-8s%.*s...\n", label, SHOWN_LENGTH, record.start);
+    } else {
+        snprintf(line, sizeof(line), "    %-8s%.*s\n", label, record.length, record.start);
+    }
+    append_string(diff, line);
+}
+
+// the last frame number among the first count records
+static int frame_before(struct record *records, int count) {
+    int i;
+
+    for(i = count - 1; i >= 0; i--) {
+        const char *frame = strstr(records[i].start, "\"frame_no\":");
+        if(frame != NULL && frame < records[i].start + records[i].length) {
+            return atoi(frame + 11);
+        }
+    }
+
+    return -1;
+}
+
+// 1 when output is the golden within the tolerances, otherwise 0 with the
+// first record that differs written to diff next to its golden
+int compare_output(const char *golden, const char *output, struct buffer *diff) {
+    struct record *expected, *actual;
+    int num_expected = split_records(golden, &expected);
+    int num_actual = split_records(output, &actual);
+    int i, same = 1;
+    char why[512], line[640];
+
+    for(i = 0; i < num_expected && i < num_actual; i++) {
+        if(!compare_record(expected[i], actual[i], why, sizeof(why))) {
+            same = 0;
+            break;
+        }
+    }
+
+    if(same && num_expected != num_actual) {
+        snprintf(why, sizeof(why), "%d records in the golden, %d now", num_expected, num_actual);
+        same = 0;
+    }
+
+    if(!same) {
+        snprintf(line, sizeof(line), "    record %d, after frame %d\n    %s\n", i, frame_before(expected, i), why);
+        append_string(diff, line);
+        if(i > 0) {
+            show_record(diff, "before", expected[i - 1]);
+        }
+        if(i < num_expected) {
+            show_record(diff, "golden", expected[i]);
+        }
+        if(i < num_actual) {
+            show_record(diff, "now", actual[i]);
+        }
+    }
+
+    free(expected);
+    free(actual);
+    return same;
+}
+
+// the recorded simulate and total times of name, 0 if it has none
+int read_timing(const char *name, long usec[2]) {
+    FILE *fp = fopen(TIMINGS_FILE, "r");
+    char line[256], found[NAME_LENGTH];
+    int ok = 0;
+
+    if(fp == NULL) {
+        return 0;
+    }
+
+    while(!ok && fgets(line, sizeof(line), fp) != NULL) {
+        ok = sscanf(line, "%63s %ld %ld", found, &usec[0], &usec[1]) == 3 && !strcmp(found, name);
+    }
+
+    fclose(fp);
+    return ok;
+}
+
+// sets the recorded times of name, keeping the other cases' lines as they are
+void write_timing(const char *name, long simulate_usec, long total_usec) {
+    char *timings = read_file(TIMINGS_FILE);
+    struct buffer b = {NULL, 0, 0};
+    char *line, found[NAME_LENGTH], entry[256];
+
+    append(&b, "", 0);
+    for(line = timings != NULL ? strtok(timings, "\n") : NULL; line != NULL; line = strtok(NULL, "\n")) {
+        if(sscanf(line, "%63s", found) == 1 && strcmp(found, name)) {
+            append_string(&b, line);
+            append_string(&b, "\n");
+        }
+    }
+
+    snprintf(entry, sizeof(entry), "%s %ld %ld\n", name, simulate_usec, total_usec);
+    append_string(&b, entry);
+
+    FILE *fp = fopen(TIMINGS_FILE, "w");
+    if(fp == NULL || fwrite(b.data, 1, b.length, fp) != b.length) {
+        perror(TIMINGS_FILE);
+        exit(EXIT_FAILURE);
+    }
+
+    fclose(fp);
+    free(timings);
+    free_buffer(&b);
+}
+
+// runs name runs times in dir, keeping the first output and the fastest times.
+// 0 when it errored or did not come out the same every time.
+int time_case(const char *dir, const char *request, int runs, struct run *first, long best[2]) {
+    int i;
+
+    best[0] = best[1] = -1;
+    for(i = 0; i < runs; i++) {
+        struct run run;
+        run_simulate(dir, request, &run);
+
+        if(run.code != 0) {
+            if(i > 0) {
+                free_run(first);
+            }
+            *first = run;
+            return 0;
+        }
+
+        if(run.usec[SIMULATE] >= 0 && (best[0] < 0 || run.usec[SIMULATE] < best[0])) {
+            best[0] = run.usec[SIMULATE];
+        }
+        if(run.usec[TOTAL] >= 0 && (best[1] < 0 || run.usec[TOTAL] < best[1])) {
+            best[1] = run.usec[TOTAL];
+        }
+
+        if(i == 0) {
+            *first = run;
+            continue;
+        }
+
+        int repeatable = run.output.length == first->output.length && !memcmp(run.output.data, first->output.data, run.output.length);
+        free_run(&run);
+        if(!repeatable) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+static int compare_names(const void *a, const void *b) {
+    return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
+// every case there is, in name order
+int list_cases(char *names[MAX_CASES]) {
+    DIR *d = opendir(CASES_DIR);
+    struct dirent *entry;
+    int count = 0;
+
+    if(d == NULL) {
+        perror(CASES_DIR);
+        exit(EXIT_FAILURE);
+    }
+
+    while((entry = readdir(d)) != NULL && count < MAX_CASES) {
+        size_t length = strlen(entry->d_name);
+        if(length > 5 && length - 5 < NAME_LENGTH && !strcmp(entry->d_name + length - 5, ".json")) {
+            names[count++] = strndup(entry->d_name, length - 5);
+        }
+    }
+
+    closedir(d);
+    qsort(names, count, sizeof(char *), compare_names);
+    return count;
+}
+
+static void print_change(long before, long after) {
+    if(before > 0 && after >= 0) {
+        printf(" %+8.1f%%", (after - before) * 100.0 / before);
+    } else {
+        printf(" %9s", "-");
+    }
+}
+
+void usage(char *name) {
+    fprintf(stderr, "usage: %s [--record] [--runs N] [--simulator DIR] [--baseline DIR]\n"
+        "       [--tolerance METERS] [--angle-tolerance RADIANS] [--summary-tolerance FRACTION] [CASE...]\n", name);
+    exit(EXIT_FAILURE);
+}
+
+// usage: regress [options] [case...], every case in cases/ when none are named.
+// --record writes the goldens and timings of the cases instead of checking
+// them. exits with 1 when any case diverged, errored or was not repeatable.
+int main(int argc, char *argv[]) {
+    char *simulator_dir = SIMULATOR_DIR;
+    char *baseline_dir = NULL;
+    char *names[MAX_CASES];
+    int num_names = 0, record = 0, runs = DEFAULT_RUNS, failed = 0;
+    int i;
+
+    for(i = 1; i < argc; i++) {
+        if(!strcmp(argv[i], "--record")) {
+            record = 1;
+        } else if(!strcmp(argv[i], "--runs") && i + 1 < argc) {
+            runs = atoi(argv[++i]);
+        } else if(!strcmp(argv[i], "--simulator") && i + 1 < argc) {
+            simulator_dir = argv[++i];
+        } else if(!strcmp(argv[i], "--baseline") && i + 1 < argc) {
+            baseline_dir = argv[++i];
+        } else if(!strcmp(argv[i], "--tolerance") && i + 1 < argc) {
+            position_tolerance = atof(argv[++i]);
+        } else if(!strcmp(argv[i], "--angle-tolerance") && i + 1 < argc) {
+            angle_tolerance = atof(argv[++i]);
+        } else if(!strcmp(argv[i], "--summary-tolerance") && i + 1 < argc) {
+            summary_tolerance = atof(argv[++i]);
+        } else if(argv[i][0] != '-' && num_names < MAX_CASES && strlen(argv[i]) < NAME_LENGTH) {
+            names[num_names++] = argv[i];
+        } else {
+            usage(argv[0]);
+        }
+    }
+
+    if(runs < 1) {
+        runs = 1;
+    }
+
+    if(num_names == 0) {
+        num_names = list_cases(names);
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    printf("%-20s %-10s %12s %12s %9s\n", "case", "result", "simulate ms", baseline_dir != NULL ? "baseline ms" : "golden ms", "change");
+
+    for(i = 0; i < num_names; i++) {
+        char *name = names[i];
+        char *request = build_request(name);
+        struct run run;
+        long best[2], before[2] = {-1, -1};
+
+        if(request == NULL) {
+            printf("%-20s %-10s\n", name, "no case");
+            failed = 1;
+            continue;
+        }
+
+        int repeatable = time_case(simulator_dir, request, runs, &run, best);
+        if(run.code != 0) {
+            printf("%-20s error %-4d\n    %s\n", name, run.code, run.errors.data);
+            free_run(&run);
+            free(request);
+            failed = 1;
+            continue;
+        }
+
+        char path[sizeof(GOLDENS_DIR) + NAME_LENGTH + 8];
+        snprintf(path, sizeof(path), "%s%s.out", GOLDENS_DIR, name);
+        struct buffer diff = {NULL, 0, 0};
+        const char *result;
+
+        if(!repeatable) {
+            result = "unstable";
+            failed = 1;
+        } else if(record) {
+            FILE *fp = fopen(path, "w");
+            if(fp == NULL || fwrite(run.output.data, 1, run.output.length, fp) != run.output.length) {
+                perror(path);
+                return EXIT_FAILURE;
+            }
+            fclose(fp);
+            write_timing(name, best[0], best[1]);
+            result = "recorded";
+        } else {
+            char *golden = read_file(path);
+            if(golden == NULL) {
+                result = "no golden";
+                failed = 1;
+            } else if(!strcmp(run.output.data, golden)) {
+                result = "same";
+            } else if(compare_output(golden, run.output.data, &diff)) {
+                result = "close";
+            } else {
+                result = "DIVERGED";
+                failed = 1;
+            }
+            free(golden);
+        }
+
+        if(baseline_dir != NULL) {
+            struct run baseline;
+            long baseline_best[2];
+            time_case(baseline_dir, request, runs, &baseline, baseline_best);
+            if(baseline.code == 0) {
+                before[0] = baseline_best[0];
+            }
+            free_run(&baseline);
+        } else if(!record) {
+            read_timing(name, before);
+        }
+
+        printf("%-20s %-10s %12.2f", name, result, best[0] / 1e3);
+        if(before[0] >= 0) {
+            printf(" %12.2f", before[0] / 1e3);
+        } else {
+            printf(" %12s", "-");
+        }
+        print_change(before[0], best[0]);
+        printf("\n");
+
+        // the diff goes after the line of the case
+        if(diff.data != NULL) {
+            printf("%s", diff.data);
+        }
+
+        free_buffer(&diff);
+        free_run(&run);
+        free(request);
+    }
+
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
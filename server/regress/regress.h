@@ -0,0 +1,80 @@
+#ifndef REGRESS_H
+#define REGRESS_H
+
+#include <stddef.h>
+
+// where simulate, the cases and their goldens are, relative to the regress directory
+#define SIMULATOR_DIR "../simulator/simulator"
+#define CASES_DIR "cases/"
+#define GOLDENS_DIR "goldens/"
+// "<case> <simulate usec> <total usec>" for every case, as it was recorded
+#define TIMINGS_FILE GOLDENS_DIR "timings"
+// simulate writes its phase times to this fd of ours, see simulator/metrics.h
+#define PHASES_ENV "VS_PHASES_FD"
+#define PHASES_FD 3
+// what the middleware puts first in every call it knows, see preprocess()
+#define LINE_ARGUMENT "__LINE__ - 2"
+#define MAX_CASES 64
+#define NAME_LENGTH 64
+// how often a run is repeated, the fastest one is its time
+#define DEFAULT_RUNS 3
+
+// how far a number may be off its golden before the run counts as changed.
+// meters for anything placed in the arena, radians for headings and relative
+// for the summary, which adds up every small difference over the whole run.
+// every other number, frame numbers and lines included, has to be exact.
+#define POSITION_TOLERANCE 1e-4
+#define ANGLE_TOLERANCE 1e-4
+#define SUMMARY_TOLERANCE 1e-3
+// how much of a record goes into a diff
+#define SHOWN_LENGTH 240
+// deepest the records nest that is told apart in a diff, anything deeper
+// still gets compared
+#define MAX_DEPTH 8
+
+enum phase {
+    COMPILE = 0,
+    START,
+    SIMULATE,
+    TOTAL,
+    NUM_PHASES
+};
+
+// a string that grows as things are added to it
+struct buffer {
+    char *data;
+    size_t length;
+    size_t size;
+};
+
+// one simulate run, its output, what it said on stderr and its phase times
+struct run {
+    struct buffer output;
+    struct buffer errors;
+    struct buffer phases;
+    long usec[NUM_PHASES];
+    int code;
+};
+
+// a top level element of the output, an arena, frame, command, summary or end
+struct record {
+    const char *start;
+    int length;
+};
+
+enum token_type {
+    END = 0,
+    NUMBER,
+    STRING,
+    WORD,
+    PUNCTUATION
+};
+
+struct token {
+    enum token_type type;
+    const char *start;
+    int length;
+    double number;
+};
+
+#endif
@@ -0,0 +1,365 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "scheduler.h"
+
+// the scheduler sits between the middleware and simulate. every simulation asks
+// it for a slot first and only starts once it has one, so a burst of requests
+// queues up here instead of oversubscribing the machine.
+//
+// a request is one line, "<class> <deadline ms> <tenant>", answered with
+// "run <waited ms>" once it may start or "reject <retry after sec> <queued>"
+// when it would not start in time. "status" gets "status <slots> <running>
+// <queued> <average run ms>" for anyone watching the load.
+
+static struct client clients[MAX_CLIENTS];
+static struct tenant tenants[MAX_TENANTS];
+static int slots;
+static int running = 0;
+static int queued = 0;
+static double runtime_ms = DEFAULT_RUNTIME_MS;
+
+long now_ms() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1000L + t.tv_nsec / 1000000L;
+}
+
+void reply(struct client *c, const char *format, long a, long b) {
+    char line[64];
+    int size = snprintf(line, sizeof(line), format, a, b);
+    write(c->fd, line, size);
+}
+
+// the tenant called name, added if we have not seen it
+int find_tenant(char *name) {
+    int i, empty = -1;
+
+    for(i = 0; i < MAX_TENANTS; i++) {
+        if(tenants[i].name[0] == '\0') {
+            if(empty < 0) {
+                empty = i;
+            }
+        } else if(!strcmp(tenants[i].name, name)) {
+            return i;
+        }
+    }
+
+    if(empty >= 0) {
+        snprintf(tenants[empty].name, TENANT_LENGTH, "%s", name);
+        tenants[empty].running = 0;
+        tenants[empty].queued = 0;
+        tenants[empty].served_ms = 0;
+    }
+
+    return empty;
+}
+
+// a tenant with nothing queued or running is forgotten
+void release_tenant(int tenant) {
+    if(tenant >= 0 && tenants[tenant].running == 0 && tenants[tenant].queued == 0) {
+        tenants[tenant].name[0] = '\0';
+    }
+}
+
+void drop(struct client *c) {
+    if(c->state == QUEUED) {
+        queued--;
+        tenants[c->tenant].queued--;
+    } else if(c->state == RUNNING) {
+        // how long runs take is what the deadline estimates go by
+        running--;
+        tenants[c->tenant].running--;
+        runtime_ms += RUNTIME_WEIGHT * ((now_ms() - c->started_ms) - runtime_ms);
+    }
+
+    if(c->state == QUEUED || c->state == RUNNING) {
+        release_tenant(c->tenant);
+    }
+
+    close(c->fd);
+    c->fd = -1;
+    c->state = FREE;
+}
+
+// how long a new job of this class would wait, everything of its class or a
+// more urgent one is ahead of it
+long estimate_wait_ms(enum job_class job_class) {
+    int i, ahead = 0;
+
+    for(i = 0; i < MAX_CLIENTS; i++) {
+        if(clients[i].state == QUEUED && clients[i].job_class <= job_class) {
+            ahead++;
+        }
+    }
+
+    if(running < slots && ahead == 0) {
+        return 0;
+    }
+
+    return (long)((ahead / slots + 1) * runtime_ms);
+}
+
+void reject(struct client *c, long wait_ms) {
+    long retry_after = (wait_ms + 999) / 1000;
+    reply(c, "reject %ld %ld\n", retry_after < 1 ? 1 : retry_after, queued);
+    drop(c);
+}
+
+// a whole request line has arrived, queue it or turn it away right now
+void admit(struct client *c) {
+    char class_name[16];
+    char name[TENANT_LENGTH];
+    long deadline_ms;
+
+    if(!strcmp(c->request, "status")) {
+        char line[96];
+        int size = snprintf(line, sizeof(line), "status %d %d %d %ld\n", slots, running, queued, (long)runtime_ms);
+        write(c->fd, line, size);
+        drop(c);
+        return;
+    }
+
+    if(sscanf(c->request, "%15s %ld %63s", class_name, &deadline_ms, name) != 3) {
+        drop(c);
+        return;
+    }
+
+    c->job_class = strcmp(class_name, "batch") ? INTERACTIVE : BATCH;
+    if(deadline_ms <= 0) {
+        deadline_ms = c->job_class == INTERACTIVE ? INTERACTIVE_DEADLINE_MS : BATCH_DEADLINE_MS;
+    }
+    c->deadline_ms = deadline_ms;
+    c->arrived_ms = now_ms();
+
+    long wait_ms = estimate_wait_ms(c->job_class);
+    c->tenant = find_tenant(name);
+    c->state = READING;
+
+    // a full queue pushes back, as does a tenant trying to fill it on its own
+    if(c->tenant < 0 || queued >= QUEUE_LIMIT || tenants[c->tenant].queued >= TENANT_QUEUE_LIMIT) {
+        reject(c, wait_ms);
+        release_tenant(c->tenant);
+        return;
+    }
+
+    // no point queueing what will not start before its caller gives up
+    if(c->deadline_ms > 0 && wait_ms > c->deadline_ms) {
+        reject(c, wait_ms - c->deadline_ms);
+        release_tenant(c->tenant);
+        return;
+    }
+
+    c->state = QUEUED;
+    queued++;
+    tenants[c->tenant].queued++;
+}
+
+// the next job to run: the most urgent class first, within it the tenant with
+// the fewest runs going and then the one served longest ago, within a tenant
+// the job that has waited longest
+struct client* pick() {
+    struct client *best = NULL;
+    int i;
+
+    for(i = 0; i < MAX_CLIENTS; i++) {
+        struct client *c = &clients[i];
+        if(c->state != QUEUED) {
+            continue;
+        }
+
+        if(best == NULL) {
+            best = c;
+            continue;
+        }
+
+        struct tenant *t = &tenants[c->tenant];
+        struct tenant *b = &tenants[best->tenant];
+        if(c->job_class != best->job_class) {
+            if(c->job_class < best->job_class) {
+                best = c;
+            }
+        } else if(t->running != b->running) {
+            if(t->running < b->running) {
+                best = c;
+            }
+        } else if(c->tenant != best->tenant && t->served_ms != b->served_ms) {
+            if(t->served_ms < b->served_ms) {
+                best = c;
+            }
+        } else if(c->arrived_ms < best->arrived_ms) {
+            best = c;
+        }
+    }
+
+    return best;
+}
+
+void dispatch() {
+    long now = now_ms();
+    int i;
+
+    // whoever has waited past their deadline is told to come back later
+    for(i = 0; i < MAX_CLIENTS; i++) {
+        struct client *c = &clients[i];
+        if(c->state == QUEUED && c->deadline_ms > 0 && now - c->arrived_ms > c->deadline_ms) {
+            reject(c, estimate_wait_ms(c->job_class));
+        }
+    }
+
+    while(running < slots) {
+        struct client *c = pick();
+        if(c == NULL) {
+            break;
+        }
+
+        queued--;
+        running++;
+        tenants[c->tenant].queued--;
+        tenants[c->tenant].running++;
+        tenants[c->tenant].served_ms = now;
+
+        c->state = RUNNING;
+        c->started_ms = now;
+        reply(c, "run %ld\n", now - c->arrived_ms, 0);
+    }
+}
+
+// reads what the client sent. after its request line the only thing left to
+// hear from it is that it closed, which frees whatever it held.
+void receive(struct client *c) {
+    if(c->state != READING) {
+        char buff[64];
+        if(read(c->fd, buff, sizeof(buff)) <= 0) {
+            drop(c);
+        }
+
+        return;
+    }
+
+    int size = read(c->fd, c->request + c->length, REQUEST_LENGTH - 1 - c->length);
+    if(size <= 0) {
+        drop(c);
+        return;
+    }
+
+    c->length += size;
+    c->request[c->length] = '\0';
+
+    char *end = strchr(c->request, '\n');
+    if(end == NULL) {
+        if(c->length >= REQUEST_LENGTH - 1) {
+            drop(c);
+        }
+
+        return;
+    }
+
+    *end = '\0';
+    admit(c);
+}
+
+void accept_client(int server) {
+    int fd = accept(server, NULL, NULL);
+    int i;
+
+    if(fd < 0) {
+        return;
+    }
+
+    for(i = 0; i < MAX_CLIENTS; i++) {
+        if(clients[i].state == FREE) {
+            clients[i].fd = fd;
+            clients[i].state = READING;
+            clients[i].length = 0;
+            clients[i].tenant = -1;
+            return;
+        }
+    }
+
+    // not even room to say no properly
+    write(fd, "reject 1 0\n", 11);
+    close(fd);
+}
+
+// usage: scheduler [--slots N] [--socket PATH]
+// slots defaults to one per core
+int main(int argc, char *argv[]) {
+    char *path = SCHEDULER_SOCKET;
+    int i;
+
+    slots = sysconf(_SC_NPROCESSORS_ONLN);
+    for(i = 1; i < argc; i++) {
+        if(!strcmp(argv[i], "--slots") && i + 1 < argc) {
+            slots = atoi(argv[++i]);
+        } else if(!strcmp(argv[i], "--socket") && i + 1 < argc) {
+            path = argv[++i];
+        } else {
+            fprintf(stderr, "usage: %s [--slots N] [--socket PATH]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if(slots < 1) {
+        slots = 1;
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+    unlink(path);
+
+    int server = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(server < 0 || bind(server, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(server, 64) != 0) {
+        perror("scheduler");
+        return EXIT_FAILURE;
+    }
+
+    for(i = 0; i < MAX_CLIENTS; i++) {
+        clients[i].fd = -1;
+        clients[i].state = FREE;
+    }
+
+    struct pollfd fds[MAX_CLIENTS + 1];
+    int owners[MAX_CLIENTS + 1];
+    while(1) {
+        int n = 0;
+        fds[n].fd = server;
+        fds[n].events = POLLIN;
+        owners[n++] = -1;
+
+        for(i = 0; i < MAX_CLIENTS; i++) {
+            if(clients[i].state != FREE) {
+                fds[n].fd = clients[i].fd;
+                fds[n].events = POLLIN;
+                owners[n++] = i;
+            }
+        }
+
+        if(poll(fds, n, POLL_MSEC) > 0) {
+            for(i = 1; i < n; i++) {
+                if(fds[i].revents & (POLLIN | POLLHUP | POLLERR)) {
+                    receive(&clients[owners[i]]);
+                }
+            }
+
+            if(fds[0].revents & POLLIN) {
+                accept_client(server);
+            }
+        }
+
+        dispatch();
+    }
+
+    return 0;
+}
@@ -0,0 +1,60 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+// the middleware finds us here, relative to the scheduler directory
+#define SCHEDULER_SOCKET "../scheduler.sock"
+#define MAX_CLIENTS 512
+// jobs allowed to wait at once, in total and per tenant
+#define QUEUE_LIMIT 256
+#define TENANT_QUEUE_LIMIT 32
+#define MAX_TENANTS 256
+#define TENANT_LENGTH 64
+#define REQUEST_LENGTH 128
+// until we have measured a run, this is how long one is assumed to take
+#define DEFAULT_RUNTIME_MS 2000
+// weight of the newest run in the running average of run times
+#define RUNTIME_WEIGHT 0.2
+// how often queued jobs are checked against their deadlines
+#define POLL_MSEC 100
+
+// lower runs first, a preview in the editor should never wait behind grading
+enum job_class {
+    INTERACTIVE = 0,
+    BATCH = 1,
+    NUM_CLASSES = 2
+};
+
+// deadline of a class when the request does not give one, 0 waits forever
+#define INTERACTIVE_DEADLINE_MS 30000
+#define BATCH_DEADLINE_MS 0
+
+enum client_state {
+    FREE = 0,
+    READING,
+    QUEUED,
+    RUNNING
+};
+
+// one connection. a job holds its slot for as long as its connection is open,
+// so a middleware that dies never leaks one.
+struct client {
+    int fd;
+    enum client_state state;
+    char request[REQUEST_LENGTH];
+    int length;
+    int tenant;
+    enum job_class job_class;
+    long deadline_ms;
+    long arrived_ms;
+    long started_ms;
+};
+
+// a course section or user, whoever the request says it is on behalf of
+struct tenant {
+    char name[TENANT_LENGTH];
+    int running;
+    int queued;
+    long served_ms;
+};
+
+#endif
@@ -0,0 +1,158 @@
+#include "Checkpoint.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+// the simulator asks for a checkpoint with a SIGUSR1 carrying the checkpoint frame.
+// the handler only records the request, the fork happens at the next message boundary.
+static volatile sig_atomic_t pending_frame = -1;
+
+static char sock_path[108];
+static char state_path[256];
+static char dir_path[256];
+
+static void on_checkpoint(int sig, siginfo_t *info, void *context) {
+    pending_frame = info->si_value.sival_int;
+}
+
+static void on_expire(int sig) {
+    // nobody resumed us in time, remove everything we left behind
+    unlink(sock_path);
+    unlink(state_path);
+    rmdir(dir_path);
+    _exit(0);
+}
+
+class CheckpointHandler
+{
+public:
+  CheckpointHandler() {
+      struct sigaction sa;
+      memset(&sa, 0, sizeof(sa));
+      sa.sa_sigaction = on_checkpoint;
+      sa.sa_flags = SA_SIGINFO | SA_RESTART;
+      sigemptyset(&sa.sa_mask);
+      sigaction(SIGUSR1, &sa, NULL);
+  }
+};
+
+// installed before setup() runs so an early request never kills the sketch
+static CheckpointHandler handler;
+
+static void put_int(int val) {
+    fputc((char)(val), stdout);
+    fputc((char)(val >> 8), stdout);
+    fputc((char)(val >> 16), stdout);
+    fputc((char)(val >> 24), stdout);
+}
+
+// the frozen copy parks here. every time a simulator connects we fork once
+// more and the new child returns into the sketch wired to that simulator.
+static void freeze(int server) {
+    // let go of the simulator's pipes, /dev/null keeps fds 0 to 2 taken. the
+    // simulator's caller waits for the end of its stderr, so that goes too,
+    // along with every other fd we were handed
+    int null_fd = open("/dev/null", O_RDWR);
+    dup2(null_fd, fileno(stdin));
+    dup2(null_fd, fileno(stdout));
+    dup2(null_fd, fileno(stderr));
+    for(int fd = 3; fd < CHECKPOINT_MAX_FD; fd++) {
+        if(fd != server) {
+            close(fd);
+        }
+    }
+    setsid();
+
+    signal(SIGCHLD, SIG_IGN);
+    signal(SIGALRM, on_expire);
+    alarm(CHECKPOINT_TTL);
+
+    while(1) {
+        int conn = accept(server, NULL, NULL);
+        if(conn < 0) {
+            continue;
+        }
+
+        int pid = fork();
+        if(pid == 0) {
+            alarm(0);
+            signal(SIGCHLD, SIG_DFL);
+            signal(SIGALRM, SIG_DFL);
+            close(server);
+
+            dup2(conn, fileno(stdin));
+            dup2(conn, fileno(stdout));
+            close(conn);
+            clearerr(stdin);
+            clearerr(stdout);
+
+            // the resuming simulator needs our pid to shut us down later
+            put_int(getpid());
+            fflush(stdout);
+            return;
+        }
+
+        close(conn);
+    }
+}
+
+// called at the start of every library call, when no reply is outstanding
+void checkpoint() {
+    if(pending_frame < 0) {
+        return;
+    }
+
+    int frame = pending_frame;
+    pending_frame = -1;
+
+    const char *dir = getenv(CHECKPOINT_ENV);
+    if(dir == NULL) {
+        return;
+    }
+
+    snprintf(dir_path, sizeof(dir_path), "%s", dir);
+    snprintf(sock_path, sizeof(sock_path), "%s/%d.sock", dir, frame);
+    snprintf(state_path, sizeof(state_path), "%s/%d.state", dir, frame);
+
+    // listen before forking so a resume can never arrive before the copy is ready
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, sock_path, sizeof(addr.sun_path) - 1);
+
+    int server = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(server < 0) {
+        return;
+    }
+
+    if(bind(server, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(server, 4) != 0) {
+        close(server);
+        return;
+    }
+
+    fflush(stdout);
+    int pid = fork();
+    if(pid < 0) {
+        close(server);
+        unlink(sock_path);
+        return;
+    } else if(pid == 0) {
+        freeze(server);
+        return;
+    }
+
+    close(server);
+
+    // tell the simulator a copy is parked so it can save its side of the state
+    fputc('\x08', stdout);
+    put_int(frame);
+    put_int(pid);
+    fflush(stdout);
+
+    while(fgetc(stdin) != '\x08');
+}
@@ -0,0 +1,12 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+// seconds a frozen copy waits to be resumed before it removes itself
+#define CHECKPOINT_TTL 600
+#define CHECKPOINT_ENV "VS_CHECKPOINT_DIR"
+// fds below this are closed in the frozen copy, all but its socket
+#define CHECKPOINT_MAX_FD 1024
+
+void checkpoint();
+
+#endif
@@ -22,7 +22,8 @@
 #define COPPER 0
 #define STEEL 1
 
-VisionSystemClient Enes100;
-SerialClient Serial;
+// inline so a sketch compiled one function at a time still has one of each
+inline VisionSystemClient Enes100;
+inline SerialClient Serial;
 
 #endif
\ No newline at end of file
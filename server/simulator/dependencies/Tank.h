@@ -3,6 +3,6 @@
 
 #include "TankClient.h"
 
-TankClient Tank;
+extern TankClient Tank;
 
 #endif
\ No newline at end of file
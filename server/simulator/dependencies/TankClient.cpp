@@ -1,8 +1,12 @@
 #include "TankClient.h"
+#include "Transport.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+// Tank.h only declares the object, otherwise every file including it defines one
+TankClient Tank;
+
 TankClient::TankClient() {
 
 };
@@ -21,16 +25,9 @@ void TankClient::setLeftMotorPWM(int ln, short pwm) {
     }
 
     if(this->init) {
-        fputc('\x03', stdout);
-        fputc((char)(ln), stdout);
-        fputc((char)(ln >> 8), stdout);
-        fputc((char)(ln >> 16), stdout);
-        fputc((char)(ln >> 24), stdout);
-        fputc((char)(pwm), stdout);
-        fputc((char)(pwm >> 8), stdout);
-        fflush(stdout);
-
-        while(fgetc(stdin) != '\x08');
+        Message message('\x03', ln);
+        message.putShort(pwm);
+        transport(message, NULL, 0);
     }
 };
 
@@ -43,29 +40,17 @@ void TankClient::setRightMotorPWM(int ln, short pwm) {
     }
 
     if(this->init) {
-        fputc('\x04', stdout);
-        fputc((char)(ln), stdout);
-        fputc((char)(ln >> 8), stdout);
-        fputc((char)(ln >> 16), stdout);
-        fputc((char)(ln >> 24), stdout);
-        fputc((char)(pwm), stdout);
-        fputc((char)(pwm >> 8), stdout);
-        fflush(stdout);
-
-        while(fgetc(stdin) != '\x08');
+        Message message('\x04', ln);
+        message.putShort(pwm);
+        transport(message, NULL, 0);
     }
 };
 
 void TankClient::turnOffMotors(int ln){
     // do what we want
     if(this->init) {
-        fputc('\x05', stdout);
-        fputc((char)(ln), stdout);
-        fputc((char)(ln >> 8), stdout);
-        fputc((char)(ln >> 16), stdout);
-        fputc((char)(ln >> 24), stdout);
-        fflush(stdout);
-        while(fgetc(stdin) != '\x08');
+        Message message('\x05', ln);
+        transport(message, NULL, 0);
     }
 };
 
@@ -76,18 +61,13 @@ float TankClient::readDistanceSensor(int ln, int id) {
     }
 
     if(this->init) {
-        fputc('\x06', stdout);
-        fputc((char)(ln), stdout);
-        fputc((char)(ln >> 8), stdout);
-        fputc((char)(ln >> 16), stdout);
-        fputc((char)(ln >> 24), stdout);
-        fputc((char)(id), stdout);
-        fflush(stdout);
-        
+        Message message('\x06', ln);
+        message.putChar((char)(id));
+
         char buff[4];
-        buff[0] = fgetc(stdin); buff[1] = fgetc(stdin); buff[2] = fgetc(stdin); buff[3] = fgetc(stdin);
+        transport(message, buff, 4);
         return *(float *)buff;
     }
     
     return -1.0;
-}
\ No newline at end of file
+}
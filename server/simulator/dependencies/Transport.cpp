@@ -0,0 +1,109 @@
+#include "Transport.h"
+#include "Checkpoint.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+transport_hook direct_transport = NULL;
+
+static FILE *log_file = NULL;
+static bool log_opened = false;
+
+Message::Message(char opcode, int ln) {
+    this->length = 0;
+    putChar(opcode);
+    putInt(ln);
+}
+
+void Message::putChar(char val) {
+    if(this->length < MESSAGE_SIZE) {
+        this->data[this->length++] = val;
+    }
+}
+
+void Message::putShort(short val) {
+    putChar((char)(val));
+    putChar((char)(val >> 8));
+}
+
+void Message::putInt(int val) {
+    putChar((char)(val));
+    putChar((char)(val >> 8));
+    putChar((char)(val >> 16));
+    putChar((char)(val >> 24));
+}
+
+// length prefixed and NUL terminated, the length counts the NUL
+void Message::putString(const char *str) {
+    int s_len = strlen(str);
+    putChar((char)(s_len + 1));
+    for(int i = 0; i <= s_len; i++) {
+        putChar(str[i]);
+    }
+}
+
+static void put_int(FILE *fp, int val) {
+    fputc((char)(val), fp);
+    fputc((char)(val >> 8), fp);
+    fputc((char)(val >> 16), fp);
+    fputc((char)(val >> 24), fp);
+}
+
+// looked up on the first print, a sketch in the simulator's own process has
+// no channel since its print messages cost nothing anyway
+static FILE* open_log() {
+    if(!log_opened) {
+        log_opened = true;
+
+        const char *fd = getenv(LOG_ENV);
+        if(fd != NULL && direct_transport == NULL) {
+            log_file = fdopen(atoi(fd), "w");
+        }
+
+        if(log_file != NULL) {
+            setvbuf(log_file, NULL, _IOFBF, LOG_BUFFER);
+        }
+    }
+
+    return log_file;
+}
+
+bool transport_log(int ln, const char *text) {
+    FILE *log = open_log();
+    if(log == NULL) {
+        return false;
+    }
+
+    int length = strlen(text);
+    put_int(log, ln);
+    put_int(log, length);
+    fwrite(text, 1, length, log);
+    return true;
+}
+
+void transport(Message &message, char *reply, int reply_length) {
+    if(direct_transport != NULL) {
+        direct_transport(message.data, message.length, reply, reply_length);
+        return;
+    }
+
+    checkpoint();
+
+    // the simulator reads the log before the messages of a frame, flushing here
+    // keeps every print ahead of the calls that came after it
+    if(log_file != NULL) {
+        fflush(log_file);
+    }
+
+    fwrite(message.data, 1, message.length, stdout);
+    fflush(stdout);
+
+    if(reply_length == 0) {
+        while(fgetc(stdin) != ACK);
+        return;
+    }
+
+    for(int i = 0; i < reply_length; i++) {
+        reply[i] = fgetc(stdin);
+    }
+}
@@ -0,0 +1,44 @@
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#define ACK '\x08'
+// opcode, line number and the longest payload, a print of 255 characters
+#define MESSAGE_SIZE (1 + 4 + 1 + 256)
+// longest text one print message carries, the length byte counts the NUL too
+#define PRINT_CHUNK 254
+
+// the simulator names the fd of the sketch's log channel in this variable, must
+// match simulator/log.h. prints are buffered up to LOG_BUFFER bytes on it.
+#define LOG_ENV "VS_LOG_FD"
+#define LOG_FD 3
+#define LOG_BUFFER 65536
+
+// one message to the simulator, built up field by field in wire order
+class Message
+{
+public:
+  Message(char opcode, int ln);
+  void putChar(char val);
+  void putShort(short val);
+  void putInt(int val);
+  void putString(const char *str);
+
+  char data[MESSAGE_SIZE];
+  int length;
+};
+
+// a simulator running the sketch inside its own process sets this, messages are
+// then handed straight to it instead of going over stdin and stdout
+extern "C" {
+typedef void (*transport_hook)(const char *message, int length, char *reply, int reply_length);
+extern transport_hook direct_transport;
+}
+
+// sends the message and waits for its reply, reply_length 0 waits for an ack
+void transport(Message &message, char *reply, int reply_length);
+
+// queues a print on the log channel without waiting for anything, false when
+// there is no channel and it has to go as print messages instead
+bool transport_log(int ln, const char *text);
+
+#endif
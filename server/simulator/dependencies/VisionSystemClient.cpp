@@ -1,4 +1,5 @@
 #include "VisionSystemClient.hpp"
+#include "Transport.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -37,114 +38,82 @@ bool VisionSystemClient::mission(int ln, Coordinate &message) {
     // do nothing
 }
 
+// the three floats begin() and updateLocation() get back
+static Coordinate read_coordinate(Message &message) {
+    char buff[12];
+    transport(message, buff, 12);
+
+    float x_f = *(float *)buff;
+    float y_f = *(float *)(buff + 4);
+    float theta_f = *(float *)(buff + 8);
+
+    return Coordinate(x_f, y_f, theta_f);
+}
+
 bool VisionSystemClient::begin(int ln, const char *teamName, int teamType, int markerId, int rxPin, int txPin) {
     // do what we want
     this->init = true;
-    fputc('\x00', stdout);
-    fputc((char)(ln), stdout);
-    fputc((char)(ln >> 8), stdout);
-    fputc((char)(ln >> 16), stdout);
-    fputc((char)(ln >> 24), stdout);
-    fflush(stdout);
-
-    char x[4];
-    x[0] = fgetc(stdin); x[1] = fgetc(stdin); x[2] = fgetc(stdin); x[3] = fgetc(stdin);
-    char y[4];
-    y[0] = fgetc(stdin); y[1] = fgetc(stdin); y[2] = fgetc(stdin); y[3] = fgetc(stdin);
-    char theta[4];
-    theta[0] = fgetc(stdin); theta[1] = fgetc(stdin); theta[2] = fgetc(stdin); theta[3] = fgetc(stdin);
-    
-    float x_f = *(float *)x;
-    float y_f = *(float *)y;
-    float theta_f = *(float *)theta;
-
-    this->destination = Coordinate(x_f, y_f, theta_f);
+    Message message('\x00', ln);
+    this->destination = read_coordinate(message);
     return true;
 }
 
 bool VisionSystemClient::updateLocation(int ln) {
     // do what we want
     if(this->init == true) {
-        fputc('\x01', stdout);
-        fputc((char)(ln), stdout);
-        fputc((char)(ln >> 8), stdout);
-        fputc((char)(ln >> 16), stdout);
-        fputc((char)(ln >> 24), stdout);
-        fflush(stdout);
-
-        char x[4];
-        x[0] = fgetc(stdin); x[1] = fgetc(stdin); x[2] = fgetc(stdin); x[3] = fgetc(stdin);
-        char y[4];
-        y[0] = fgetc(stdin); y[1] = fgetc(stdin); y[2] = fgetc(stdin); y[3] = fgetc(stdin);
-        char theta[4];
-        theta[0] = fgetc(stdin); theta[1] = fgetc(stdin); theta[2] = fgetc(stdin); theta[3] = fgetc(stdin);
-        
-        float x_f = *(float *)x;
-        float y_f = *(float *)y;
-        float theta_f = *(float *)theta;
-
-        this->location = Coordinate(x_f, y_f, theta_f);
+        Message message('\x01', ln);
+        this->location = read_coordinate(message);
         return true;
     } else {
         return false;
     }
 }
 
+// a print goes down the log channel when the sketch has one. otherwise it is
+// sent as print messages, a long one split over as many as it takes.
+static void send_print(int ln, const char *text) {
+    if(transport_log(ln, text)) {
+        return;
+    }
+
+    int length = strlen(text);
+    int sent = 0;
+    do {
+        char chunk[PRINT_CHUNK + 1];
+        int size = length - sent > PRINT_CHUNK ? PRINT_CHUNK : length - sent;
+        memcpy(chunk, text + sent, size);
+        chunk[size] = '\0';
+
+        Message m('\x02', ln);
+        m.putString(chunk);
+        transport(m, NULL, 0);
+        sent += size;
+    } while(sent < length);
+}
+
 void VisionSystemClient::print(int ln, const char *message) {
     // do what we want
     if(this->init) {
-        int s_len = strlen(message);
-        if(s_len <= 255) {
-            fputc('\x02', stdout);
-            fputc((char)(ln), stdout);
-            fputc((char)(ln >> 8), stdout);
-            fputc((char)(ln >> 16), stdout);
-            fputc((char)(ln >> 24), stdout);
-            fputc((char)(s_len + 1), stdout);
-            fputs(message, stdout);
-            fputc('\x0', stdout);
-            fflush(stdout);
-            
-            while(fgetc(stdin) != '\x08');
-        }
+        send_print(ln, message);
     }
 }
 
 void VisionSystemClient::print(int ln, int message) {
     // do what we want
     if(this->init) {
-        char str[256];
-        sprintf(str, "%d", message);
-        fputc('\x02', stdout);
-        fputc((char)(ln), stdout);
-        fputc((char)(ln >> 8), stdout);
-        fputc((char)(ln >> 16), stdout);
-        fputc((char)(ln >> 24), stdout);
-        fputc((char)(strlen(str) + 1), stdout);
-        fputs(str, stdout);
-        fputc('\x0', stdout);
-        fflush(stdout);
-        
-        while(fgetc(stdin) != '\x08');
+        char str[32];
+        snprintf(str, sizeof(str), "%d", message);
+        send_print(ln, str);
     }
 }
 
 void VisionSystemClient::print(int ln, double message) {
     // do what we want
     if(this->init) {
-        char str[256];
-        sprintf(str, "%f", message);
-        fputc('\x02', stdout);
-        fputc((char)(ln), stdout);
-        fputc((char)(ln >> 8), stdout);
-        fputc((char)(ln >> 16), stdout);
-        fputc((char)(ln >> 24), stdout);
-        fputc((char)(strlen(str) + 1), stdout);
-        fputs(str, stdout);
-        fputc('\x0', stdout);
-        fflush(stdout);
-        
-        while(fgetc(stdin) != '\x08');
+        // %f of the largest double runs to over 300 characters
+        char str[512];
+        snprintf(str, sizeof(str), "%f", message);
+        send_print(ln, str);
     }
 }
 
@@ -152,74 +121,36 @@ void VisionSystemClient::println(int ln, const char *message) {
     // do what we want
     if(this->init) {
         int s_len = strlen(message);
-        if(s_len <= 254) {
-            char str[256];
-            sprintf(str, "%s\n", message);
-            fputc('\x02', stdout);
-            fputc((char)(ln), stdout);
-            fputc((char)(ln >> 8), stdout);
-            fputc((char)(ln >> 16), stdout);
-            fputc((char)(ln >> 24), stdout);
-            fputc((char)(s_len + 2), stdout);
-            fputs(str, stdout);
-            fputc('\x0', stdout);
-            fflush(stdout);
-            
-            while(fgetc(stdin) != '\x08');
-        }
+        char *str = (char *)malloc(s_len + 2);
+        memcpy(str, message, s_len);
+        str[s_len] = '\n';
+        str[s_len + 1] = '\0';
+        send_print(ln, str);
+        free(str);
     }
 }
 
 void VisionSystemClient::println(int ln, int message) {
     // do what we want
     if(this->init) {
-        char str[256];
-        sprintf(str, "%d\n", message);
-        fputc('\x02', stdout);
-        fputc((char)(ln), stdout);
-        fputc((char)(ln >> 8), stdout);
-        fputc((char)(ln >> 16), stdout);
-        fputc((char)(ln >> 24), stdout);
-        fputc((char)(strlen(str) + 2), stdout);
-        fputs(str, stdout);
-        fputc('\x0', stdout);
-        fflush(stdout);
-        
-        while(fgetc(stdin) != '\x08');
+        char str[32];
+        snprintf(str, sizeof(str), "%d\n", message);
+        send_print(ln, str);
     }
 }
 
 void VisionSystemClient::println(int ln, double message) {
     // do what we want
     if(this->init) {
-        char str[256];
-        sprintf(str, "%f\n", message);
-        fputc('\x02', stdout);
-        fputc((char)(ln), stdout);
-        fputc((char)(ln >> 8), stdout);
-        fputc((char)(ln >> 16), stdout);
-        fputc((char)(ln >> 24), stdout);
-        fputc((char)(strlen(str) + 2), stdout);
-        fputs(str, stdout);
-        fputc('\x0', stdout);
-        fflush(stdout);
-        
-        while(fgetc(stdin) != '\x08');
+        char str[512];
+        snprintf(str, sizeof(str), "%f\n", message);
+        send_print(ln, str);
     }
 }
 
 void delay(int ln, int msec) {
     // do what we want
-    fputc('\x07', stdout);
-    fputc((char)(ln), stdout);
-    fputc((char)(ln >> 8), stdout);
-    fputc((char)(ln >> 16), stdout);
-    fputc((char)(ln >> 24), stdout);
-    fputc((char)(msec), stdout);
-    fputc((char)(msec >> 8), stdout);
-    fputc((char)(msec >> 16), stdout);
-    fputc((char)(msec >> 24), stdout);
-    fflush(stdout);
-    
-    while(fgetc(stdin) != '\x08');
-}
\ No newline at end of file
+    Message message('\x07', ln);
+    message.putInt(msec);
+    transport(message, NULL, 0);
+}
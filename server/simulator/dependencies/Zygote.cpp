@@ -0,0 +1,254 @@
+#include "Zygote.h"
+#include "Transport.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/un.h>
+
+// the zygote is the client library with nothing to run yet. every simulation asks
+// it for a fork, the fork loads the student's sketch as a shared object and calls
+// its main, so no run pays for exec, the loader or libstdc++ start up again.
+
+// a running sketch and the simulator it belongs to. when the simulator goes away
+// the sketch is killed, like the parent death signal copen() asks for.
+struct job {
+    int pid;
+    int pidfd;
+    int owner_pidfd;
+};
+
+static struct job jobs[ZYGOTE_MAX_JOBS];
+static int num_jobs = 0;
+
+static int open_pidfd(int pid) {
+#ifdef SYS_pidfd_open
+    return syscall(SYS_pidfd_open, pid, 0);
+#else
+    return -1;
+#endif
+}
+
+static void put_int(int fd, int val) {
+    unsigned char buff[4];
+    buff[0] = (unsigned char)(val);
+    buff[1] = (unsigned char)(val >> 8);
+    buff[2] = (unsigned char)(val >> 16);
+    buff[3] = (unsigned char)(val >> 24);
+    write(fd, buff, 4);
+}
+
+// the request is the sketch path followed by environment entries, each NUL
+// terminated, with the sketch's stdin, stdout and working directory attached
+// and maybe its log channel. fds[3] is -1 when there is none.
+static int receive_request(int conn, char *payload, int *fds) {
+    struct msghdr msg;
+    struct iovec iov;
+    char control[CMSG_SPACE(4 * sizeof(int))];
+
+    memset(&msg, 0, sizeof(msg));
+    iov.iov_base = payload;
+    iov.iov_len = ZYGOTE_REQUEST_SIZE - 1;
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    int size = recvmsg(conn, &msg, 0);
+    if(size <= 0) {
+        return -1;
+    }
+    payload[size] = '\0';
+
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    if(cmsg == NULL || cmsg->cmsg_type != SCM_RIGHTS) {
+        return -1;
+    }
+
+    fds[3] = -1;
+    if(cmsg->cmsg_len == CMSG_LEN(4 * sizeof(int))) {
+        memcpy(fds, CMSG_DATA(cmsg), 4 * sizeof(int));
+    } else if(cmsg->cmsg_len == CMSG_LEN(3 * sizeof(int))) {
+        memcpy(fds, CMSG_DATA(cmsg), 3 * sizeof(int));
+    } else {
+        return -1;
+    }
+
+    return size;
+}
+
+static void close_request(int conn, int *fds) {
+    close(fds[0]);
+    close(fds[1]);
+    close(fds[2]);
+    if(fds[3] >= 0) {
+        close(fds[3]);
+    }
+    close(conn);
+}
+
+// runs in the fork, never returns
+static void run_sketch(int server, int conn, char *payload, int size, int *fds) {
+    int i;
+
+    signal(SIGCHLD, SIG_DFL);
+    signal(SIGPIPE, SIG_DFL);
+    close(server);
+
+    // the other jobs are none of the sketch's business
+    for(i = 0; i < num_jobs; i++) {
+        close(jobs[i].pidfd);
+        close(jobs[i].owner_pidfd);
+    }
+
+    fchdir(fds[2]);
+    close(fds[2]);
+    dup2(fds[0], fileno(stdin));
+    dup2(fds[1], fileno(stdout));
+    close(fds[0]);
+    close(fds[1]);
+
+    if(fds[3] >= 0 && fds[3] != LOG_FD) {
+        dup2(fds[3], LOG_FD);
+        close(fds[3]);
+    }
+
+    char *sketch = payload;
+    char *entry = sketch + strlen(sketch) + 1;
+    while(entry < payload + size && *entry != '\0') {
+        putenv(entry);
+        entry += strlen(entry) + 1;
+    }
+
+    void *handle = dlopen(sketch, RTLD_NOW);
+    int (*sketch_main)(int, char**) = NULL;
+    if(handle != NULL) {
+        sketch_main = (int (*)(int, char**))dlsym(handle, "main");
+    }
+
+    // -1 tells the simulator to fall back to running the executable
+    if(sketch_main == NULL) {
+        put_int(conn, -1);
+        _exit(5);
+    }
+
+    put_int(conn, getpid());
+    close(conn);
+
+    char *argv[] = { sketch, NULL };
+    exit(sketch_main(1, argv));
+}
+
+static void spawn(int server, int conn) {
+    char payload[ZYGOTE_REQUEST_SIZE];
+    int fds[4];
+
+    int size = receive_request(conn, payload, fds);
+    if(size < 0) {
+        close(conn);
+        return;
+    }
+
+    struct ucred owner;
+    socklen_t length = sizeof(owner);
+    int owner_pid = getsockopt(conn, SOL_SOCKET, SO_PEERCRED, &owner, &length) == 0 ? owner.pid : -1;
+
+    // a sketch we could not keep an eye on would outlive its simulator, that
+    // one runs the executable itself instead
+    int owner_pidfd = owner_pid >= 0 && num_jobs < ZYGOTE_MAX_JOBS ? open_pidfd(owner_pid) : -1;
+    if(owner_pidfd < 0) {
+        put_int(conn, -1);
+        close_request(conn, fds);
+        return;
+    }
+
+    fflush(stdout);
+    int pid = fork();
+    if(pid == 0) {
+        close(owner_pidfd);
+        run_sketch(server, conn, payload, size, fds);
+    }
+
+    close_request(conn, fds);
+
+    int pidfd = pid > 0 ? open_pidfd(pid) : -1;
+    if(pidfd < 0) {
+        if(pid > 0) {
+            kill(pid, SIGKILL);
+        }
+        close(owner_pidfd);
+        return;
+    }
+
+    jobs[num_jobs].pid = pid;
+    jobs[num_jobs].pidfd = pidfd;
+    jobs[num_jobs].owner_pidfd = owner_pidfd;
+    num_jobs++;
+}
+
+int main(int argc, char *argv[]) {
+    const char *path = argc > 1 ? argv[1] : ZYGOTE_SOCKET;
+    int i;
+
+    // forks reap themselves, and a simulator hanging up must not take us down
+    signal(SIGCHLD, SIG_IGN);
+    signal(SIGPIPE, SIG_IGN);
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+
+    int server = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(path);
+    if(server < 0 || bind(server, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(server, 64) != 0) {
+        perror("zygote");
+        return 1;
+    }
+
+    while(1) {
+        struct pollfd fds[1 + 2 * ZYGOTE_MAX_JOBS];
+        fds[0].fd = server;
+        fds[0].events = POLLIN;
+        for(i = 0; i < num_jobs; i++) {
+            fds[1 + 2 * i].fd = jobs[i].pidfd;
+            fds[1 + 2 * i].events = POLLIN;
+            fds[2 + 2 * i].fd = jobs[i].owner_pidfd;
+            fds[2 + 2 * i].events = POLLIN;
+        }
+
+        if(poll(fds, 1 + 2 * num_jobs, -1) < 0) {
+            continue;
+        }
+
+        // walk backwards so removing a job keeps the remaining indices valid
+        for(i = num_jobs - 1; i >= 0; i--) {
+            int exited = fds[1 + 2 * i].revents != 0;
+            int orphaned = fds[2 + 2 * i].revents != 0;
+            if(!exited && !orphaned) {
+                continue;
+            }
+
+            if(!exited) {
+                kill(jobs[i].pid, SIGTERM);
+            }
+
+            close(jobs[i].pidfd);
+            close(jobs[i].owner_pidfd);
+            jobs[i] = jobs[--num_jobs];
+        }
+
+        if(fds[0].revents & POLLIN) {
+            int conn = accept(server, NULL, NULL);
+            if(conn >= 0) {
+                spawn(server, conn);
+            }
+        }
+    }
+}
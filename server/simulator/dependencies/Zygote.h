@@ -0,0 +1,10 @@
+#ifndef ZYGOTE_H
+#define ZYGOTE_H
+
+// relative to the simulator's working directory, where the zygote is started
+#define ZYGOTE_SOCKET "../zygote.sock"
+// sketches running at once that the zygote keeps an eye on
+#define ZYGOTE_MAX_JOBS 256
+#define ZYGOTE_REQUEST_SIZE 4096
+
+#endif
@@ -0,0 +1,234 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#include "build.h"
+#include "compile.h"
+#include "error.h"
+#include "vs.h"
+
+// compiling is most of what a run waits for before its first frame, so every
+// sketch is built by a child of its own while we parse the arena, load the
+// scene and open the channels, and each sketch starts as soon as its build is done.
+
+static struct build *started[MAX_ROBOTS];
+static int num_started = 0;
+static int build_owner = 0;
+
+// builds we no longer need die with their compilers when we exit early
+static void kill_builds() {
+    int i;
+
+    if(getpid() != build_owner) {
+        return;
+    }
+
+    for(i = 0; i < num_started; i++) {
+        if(started[i]->channel >= 0) {
+            kill(-started[i]->pid, SIGKILL);
+            waitpid(started[i]->pid, NULL, 0);
+        }
+    }
+}
+
+static void send_program(int channel, int program) {
+    struct msghdr msg;
+    struct iovec iov;
+    char byte = 0;
+    char control[CMSG_SPACE(sizeof(int))];
+    memset(&msg, 0, sizeof(msg));
+    memset(control, 0, sizeof(control));
+
+    iov.iov_base = &byte;
+    iov.iov_len = 1;
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &program, sizeof(int));
+
+    if(sendmsg(channel, &msg, 0) != 1) {
+        error("Unable to send program.", 3);
+    }
+}
+
+// -1 when the child hung up without sending one
+static int receive_program(int channel) {
+    struct msghdr msg;
+    struct iovec iov;
+    char byte;
+    char control[CMSG_SPACE(sizeof(int))];
+    memset(&msg, 0, sizeof(msg));
+
+    iov.iov_base = &byte;
+    iov.iov_len = 1;
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    if(recvmsg(channel, &msg, MSG_CMSG_CLOEXEC) != 1) {
+        return -1;
+    }
+
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    if(cmsg == NULL || cmsg->cmsg_type != SCM_RIGHTS) {
+        return -1;
+    }
+
+    int program;
+    memcpy(&program, CMSG_DATA(cmsg), sizeof(int));
+    return program;
+}
+
+// forks the child that runs initialize() or initialize_in_memory() on code.
+// it gets a process group of its own so its compilers can be killed along with it.
+void start_build(struct build *build, char *program_name, char *code, int in_memory) {
+    int channel[2];
+
+    build->pid = -1;
+    build->errors_fd = memfd_create("errors", MFD_CLOEXEC);
+    build->channel = -1;
+    build->program = -1;
+    build->status = 0;
+
+    if(build->errors_fd < 0) {
+        error("Unable to create build.", 2);
+    }
+
+    if(socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, channel) < 0) {
+        error("Unable to pipe.", 3);
+    }
+
+    if(build_owner == 0) {
+        build_owner = getpid();
+        atexit(kill_builds);
+    }
+
+    int parent = getpid();
+    int pid = fork();
+    switch(pid) {
+        case -1:
+        error("Unable to fork.", 4);
+        case 0:
+        // this is child
+        setpgid(0, 0);
+        prctl(PR_SET_PDEATHSIG, SIGKILL);
+        if(getppid() != parent) {
+            exit(1);
+        }
+
+        close(channel[0]);
+        dup2(build->errors_fd, STDERR_FILENO);
+
+        if(in_memory) {
+            int program = initialize_in_memory(program_name, code);
+            if(program < 0) {
+                error("Unable to compile provided code.", 2);
+            }
+            send_program(channel[1], program);
+        } else if(initialize(program_name, code) != 0) {
+            error("Unable to compile provided code.", 2);
+        }
+
+        exit(0);
+        default:
+        // this is parent, the group has to exist before we may kill it
+        setpgid(pid, pid);
+        close(channel[1]);
+        break;
+    }
+
+    build->pid = pid;
+    build->channel = channel[0];
+    started[num_started++] = build;
+}
+
+// blocks until one of the builds is done and returns its index, -1 when none
+// of them is still running
+int wait_build(struct build *builds, int count) {
+    struct pollfd fds[MAX_ROBOTS];
+    int which[MAX_ROBOTS];
+    int i, n = 0;
+
+    for(i = 0; i < count; i++) {
+        if(builds[i].channel >= 0) {
+            fds[n].fd = builds[i].channel;
+            fds[n].events = POLLIN;
+            which[n] = i;
+            n++;
+        }
+    }
+
+    if(n == 0) {
+        return -1;
+    }
+
+    while(poll(fds, n, -1) < 0) {
+        if(errno != EINTR) {
+            error("Unable to poll.", 3);
+        }
+    }
+
+    for(i = 0; i < n && fds[i].revents == 0; i++);
+    struct build *build = &builds[which[i]];
+
+    // the program comes right before the child exits, a hang up alone is a failure
+    build->program = receive_program(build->channel);
+    close(build->channel);
+    build->channel = -1;
+
+    int status;
+    while(waitpid(build->pid, &status, 0) < 0 && errno == EINTR);
+    if(WIFSIGNALED(status)) {
+        build->status = 128 + WTERMSIG(status);
+    } else {
+        build->status = WEXITSTATUS(status);
+    }
+
+    return which[i];
+}
+
+// how many of the first count builds are not done yet
+int builds_running(struct build *builds, int count) {
+    int i, running = 0;
+
+    for(i = 0; i < count; i++) {
+        running += builds[i].channel >= 0;
+    }
+
+    return running;
+}
+
+// exits the way the build did, with the error it wrote and its code
+void fail_build(struct build *build) {
+    char buffer[4096];
+    int size, total = 0;
+
+    lseek(build->errors_fd, 0, SEEK_SET);
+    while((size = read(build->errors_fd, buffer, sizeof(buffer))) > 0) {
+        total += write(STDERR_FILENO, buffer, size);
+    }
+
+    // killed before it could say anything
+    if(total <= 0 || build->status == 0) {
+        error("Unable to compile provided code.", 2);
+    }
+
+    exit(build->status);
+}
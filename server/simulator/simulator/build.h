@@ -0,0 +1,22 @@
+#ifndef BUILD_H
+#define BUILD_H
+
+// a sketch being compiled by a child of ours while we get everything else ready
+struct build {
+    int pid;
+    // what the child said on stderr, played back if the build fails
+    int errors_fd;
+    // hangs up when the child is done, an in memory build sends its program first
+    int channel;
+    // the program fd of an in memory build, -1 otherwise
+    int program;
+    // how the child exited, 128 and the signal if it was killed
+    int status;
+};
+
+void start_build(struct build *build, char *program_name, char *code, int in_memory);
+int wait_build(struct build *builds, int count);
+int builds_running(struct build *builds, int count);
+void fail_build(struct build *build);
+
+#endif
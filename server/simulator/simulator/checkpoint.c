@@ -0,0 +1,140 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "checkpoint.h"
+#include "error.h"
+#include "output.h"
+
+// directory and id of the run currently being checkpointed
+static char *current_dir = NULL;
+static char *current_id = NULL;
+
+// this function creates (if needed) and returns the checkpoint directory of a run
+char* checkpoint_dir(char *program_id) {
+    char *dir = (char*)malloc((strlen(CHECKPOINT_DIR) + strlen(program_id) + 1) * sizeof(char));
+    sprintf(dir, "%s%s", CHECKPOINT_DIR, program_id);
+
+    if(mkdir(dir, 0777) != 0 && access(dir, F_OK) != 0) {
+        error("Unable to create checkpoint directory.", 9);
+    }
+
+    current_dir = dir;
+    current_id = program_id;
+    return dir;
+}
+
+// asks the child to fork itself at its next message boundary
+void request_checkpoint(struct process p, int frame) {
+    union sigval value;
+    value.sival_int = frame;
+    sigqueue(p.pid, SIGUSR1, value);
+}
+
+// called once the child reports its frozen copy, everything before that message is already simulated
+void save_checkpoint(int frame, int pid, struct arena *arena, int frame_no) {
+    if(current_dir == NULL) {
+        return;
+    }
+
+    char path[strlen(current_dir) + 32];
+    sprintf(path, "%s/%d.state", current_dir, frame);
+
+    FILE *fp = fopen(path, "w");
+    if(fp == NULL) {
+        error("Unable to save checkpoint.", 9);
+    }
+
+    fprintf(fp, "%d %d %d %.9g %.9g %.9g %d %d\n", frame, frame_no, pid,
+        arena->robots.x[0], arena->robots.y[0], arena->robots.theta[0],
+        arena->robots.left_motor_pwm[0], arena->robots.right_motor_pwm[0]);
+    fclose(fp);
+
+    out_raw(&out, "{\"checkpoint\":");
+    out_int(&out, frame);
+    out_raw(&out, ",\"frame_no\":");
+    out_int(&out, frame_no);
+    // what a resume has to name, the caller may not know the id it ran under
+    out_raw(&out, ",\"id\":");
+    out_string(&out, current_id, strlen(current_id));
+    out_raw(&out, "},");
+}
+
+// reads the simulator half of a checkpoint back
+struct checkpoint load_checkpoint(char *dir, int frame) {
+    char path[strlen(dir) + 32];
+    sprintf(path, "%s/%d.state", dir, frame);
+
+    FILE *fp = fopen(path, "r");
+    if(fp == NULL) {
+        error("Unable to find checkpoint.", 10);
+    }
+
+    struct checkpoint c;
+    if(fscanf(fp, "%d %d %d %f %f %f %d %d", &c.frame, &c.frame_no, &c.pid,
+        &c.location.x, &c.location.y, &c.location.theta,
+        &c.left_motor_pwm, &c.right_motor_pwm) != 8) {
+        fclose(fp);
+        error("Unable to read checkpoint.", 10);
+    }
+
+    fclose(fp);
+    return c;
+}
+
+// wakes the frozen copy of a run and takes over the osv state at that frame.
+// obstacles, destination and sensors stay whatever the new request asked for.
+struct process resume_checkpoint(char *program_id, int frame, struct arena *arena, int *frame_no) {
+    char *dir = checkpoint_dir(program_id);
+    struct checkpoint c = load_checkpoint(dir, frame);
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s/%d.sock", dir, frame);
+
+    int input_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(input_fd < 0) {
+        error("Unable to open checkpoint.", 10);
+    }
+
+    // nobody listening means the frozen copy already timed out
+    if(connect(input_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        error("Checkpoint has expired.", 10);
+    }
+
+    // the resumed child introduces itself with its pid
+    unsigned char pid_buff[4];
+    int received = 0;
+    while(received < 4) {
+        int size = read(input_fd, pid_buff + received, 4 - received);
+        if(size <= 0) {
+            error("Unable to resume checkpoint.", 10);
+        }
+
+        received += size;
+    }
+
+    arena->robots.x[0] = c.location.x;
+    arena->robots.y[0] = c.location.y;
+    arena->robots.theta[0] = c.location.theta;
+    forget_sensors(&arena->robots);
+    arena->robots.left_motor_pwm[0] = c.left_motor_pwm;
+    arena->robots.right_motor_pwm[0] = c.right_motor_pwm;
+    *frame_no = c.frame_no;
+
+    struct process p;
+    p.pid = pid_buff[0] | (pid_buff[1] << 8) | (pid_buff[2] << 16) | (pid_buff[3] << 24);
+    p.input_fd = input_fd;
+    p.output_fd = dup(input_fd);
+    p.replies = NULL;
+    p.robot = 0;
+    p.log = NULL;
+
+    return p;
+}
@@ -0,0 +1,24 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include "simulator.h"
+#include "vs.h"
+
+#define CHECKPOINT_DIR "../checkpoints/"
+#define CHECKPOINT_ENV "VS_CHECKPOINT_DIR"
+
+// the simulator half of a checkpoint, the student half is the frozen fork
+struct checkpoint {
+    int frame;
+    int frame_no;
+    int pid;
+    struct coordinate location;
+    int left_motor_pwm, right_motor_pwm;
+};
+
+char* checkpoint_dir(char *program_id);
+void request_checkpoint(struct process p, int frame);
+void save_checkpoint(int frame, int pid, struct arena *arena, int frame_no);
+struct process resume_checkpoint(char *program_id, int frame, struct arena *arena, int *frame_no);
+
+#endif
@@ -1,11 +1,24 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 #include <regex.h>
+#include <time.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <utime.h>
+#include <sys/file.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
+#include <sys/wait.h>
 
 #include "compile.h"
 #include "error.h"
+#include "hash.h"
+#include "metrics.h"
+#include "units.h"
 
 // this function will retrieve all matches to the regex in the string
 struct match_list get_all_matches(regex_t r, char *to_match) {
@@ -42,60 +55,45 @@ struct match_list get_all_matches(regex_t r, char *to_match) {
     return ret;
 }
 
-// this function will get all of the function names
-struct match_list get_function_declarations(char *file_name, int *status_code) {
-    FILE *fp = fopen(file_name, "r");
-
+// this function will get all of the function names out of code held in memory
+struct match_list match_declarations(char *code, int *status_code) {
     struct match_list dummy;
 
-    if(fp == NULL) {
-        error("Unable to read file.", 2);
-        *status_code = -1;
-        return dummy;
-    }
-
     int n_characters = 0;
     int braces_stack = 0;
-    char *first_level_code = (char*)malloc(1 * sizeof(char));
+    char *first_level_code = (char*)malloc((strlen(code) * 2 + 1) * sizeof(char));
     first_level_code[0] = '\0';
 
 
     // first we want to extract all of the code not in functions.
     char c;
-    while((c = fgetc(fp)) != EOF) {
+    for(; *code != '\0'; code++) {
+        c = *code;
         if(c == '{') {
             braces_stack++;
         } else if(c == '}') {
             braces_stack--;
         } else if(braces_stack == 0) {
-            n_characters++;
-            first_level_code = (char*)realloc(first_level_code, (n_characters + 1) * sizeof(char));
-
             if(c == '\n' || c == '\r') {
                 c = ' ';
             }
 
-            first_level_code[n_characters - 1] = c;
-            first_level_code[n_characters] = '\0';
+            first_level_code[n_characters++] = c;
 
             if(c == ')') {
                 // we need to add this to help with the regex (c has a weird regex matching rule)
-                n_characters++;
-                first_level_code = (char*)realloc(first_level_code, (n_characters + 1) * sizeof(char));
-                first_level_code[n_characters - 1] = '`';
-                first_level_code[n_characters] = '\0';
+                first_level_code[n_characters++] = '`';
             }
         }
-    }    
+    }
+    first_level_code[n_characters] = '\0';
 
-    // printf("%s\n", first_level_code);
     // now we need to filter the string to extract function names
     // functions can be extracted by searching for (...) 
 
     // [0-9A-Za-z_\\[\\]\\*]+[[:space:]]+[0-9A-Za-z_\\[\\]\\*]+[[:space:]]*\\(.*\\)
     // a regex can be used to search for functions.
     char *function_pattern = "[0-9A-Za-z_\\[\\*]+]?[[:space:]]+[0-9A-Za-z_]+[[:space:]]*\\([^`]*\\)";
-    int r_return;
 
     regex_t regex;
     if(regcomp(&regex, function_pattern, REG_EXTENDED)) {
@@ -105,11 +103,37 @@ struct match_list get_function_declarations(char *file_name, int *status_code) {
     }
 
     struct match_list matches = get_all_matches(regex, first_level_code);
-    // printf("%d\n", matches.n_matches);
 
+    regfree(&regex);
     free(first_level_code);
+
+    return matches;
+}
+
+// this function will get all of the function names of a source file
+struct match_list get_function_declarations(char *file_name, int *status_code) {
+    FILE *fp = fopen(file_name, "r");
+
+    struct match_list dummy;
+
+    if(fp == NULL) {
+        error("Unable to read file.", 2);
+        *status_code = -1;
+        return dummy;
+    }
+
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+
+    char *code = (char*)malloc((size + 1) * sizeof(char));
+    size = fread(code, 1, size, fp);
+    code[size] = '\0';
     fclose(fp);
 
+    struct match_list matches = match_declarations(code, status_code);
+    free(code);
+
     return matches;
 }
 
@@ -195,7 +219,7 @@ int create_src_file(char *code, struct file_names files) {
 
     fputs(n_line, fp);
     fputs(code, fp);
-    fputs("\n\nint main(int argc, char *argv[]) {\n\tsetup();\n\twhile(1) {\n\t\tloop();\n\t}\n}\n", fp);
+    fputs("\n\n" SKETCH_MAIN, fp);
     fclose(fp);
 
     return 0;
@@ -236,47 +260,723 @@ void free_match_list(struct match_list m) {
     free(m.matches);
 }
 
-// this is the final function to compile the executable
-int compile(char *file) {
-    int len_base = strlen("cd ../dependencies & make name=");
-    int len_f = strlen(file);
-    int len = len_f + len_base + strlen(" 2>&1");
-    char command[len + 1];
+// number of compilers allowed at once across every simulate process,
+// one per core as long as there is memory left for each of them
+int compile_slots() {
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    long available = -1;
+    char line[256];
+
+    FILE *fp = fopen("/proc/meminfo", "r");
+    if(fp != NULL) {
+        while(fgets(line, sizeof(line), fp) != NULL) {
+            if(sscanf(line, "MemAvailable: %ld kB", &available) == 1) {
+                break;
+            }
+        }
+
+        fclose(fp);
+    }
+
+    long slots = cores > 0 ? cores : 1;
+    if(available >= 0 && available / COMPILE_MEMORY_KB < slots) {
+        slots = available / COMPILE_MEMORY_KB;
+    }
+
+    return slots < 1 ? 1 : (int)slots;
+}
+
+void compile_wait() {
+    struct timespec wait;
+    wait.tv_sec = 0;
+    wait.tv_nsec = COMPILE_POLL_NSEC;
+    nanosleep(&wait, NULL);
+}
+
+// one of the compile slots if any is free, -1 otherwise. the slot is held as
+// long as the returned fd stays open, so a crashed compile never leaks one.
+int try_slot() {
+    char path[strlen(SLOTS_DIR) + 16];
+    int i, fd;
+
+    mkdir(SLOTS_DIR, 0777);
+
+    int slots = compile_slots();
+    for(i = 0; i < slots; i++) {
+        sprintf(path, "%s%d.lock", SLOTS_DIR, i);
+        fd = open(path, O_CREAT | O_RDWR, 0666);
+        if(fd < 0) {
+            error("Unable to open compile slot.", 2);
+            return -1;
+        }
+
+        if(flock(fd, LOCK_EX | LOCK_NB) == 0) {
+            return fd;
+        }
+
+        close(fd);
+    }
+
+    return -1;
+}
+
+// blocks until one of the compile slots is ours
+int acquire_slot() {
+    int fd;
+
+    while((fd = try_slot()) < 0) {
+        compile_wait();
+    }
+
+    return fd;
+}
+
+// takes the lock of a build. returns the locked fd, -1 when block is 0 and
+// somebody else is building it, or LOCK_FAILED. the lock file can be pruned
+// from under us, so only a lock on the file still at that path counts, and
+// only a missing directory is worth another try.
+int lock_build(char *build_dir, int block) {
+    char path[strlen(build_dir) + 8];
+    sprintf(path, "%s/lock", build_dir);
+
+    while(1) {
+        mkdir(BUILDS_DIR, 0777);
+        if(mkdir(build_dir, 0777) != 0 && errno != EEXIST) {
+            return LOCK_FAILED;
+        }
+
+        int fd = open(path, O_CREAT | O_RDWR, 0666);
+        if(fd < 0 && errno == ENOENT) {
+            continue;
+        } else if(fd < 0) {
+            return LOCK_FAILED;
+        }
+
+        if(flock(fd, block ? LOCK_EX : LOCK_EX | LOCK_NB) != 0) {
+            close(fd);
+            return -1;
+        }
+
+        struct stat locked, current;
+        if(fstat(fd, &locked) == 0 && stat(path, &current) == 0 && locked.st_ino == current.st_ino) {
+            return fd;
+        }
+
+        close(fd);
+    }
+}
+
+static void lock_error() {
+    char message[128];
+    snprintf(message, sizeof(message), "Unable to lock build: %s.", strerror(errno));
+    error(message, 2);
+}
+
+// appends whatever has been written to the log since the last call
+void follow_log(FILE *log, char **output, int *length) {
+    char chunk[1024];
+    size_t size;
+
+    while((size = fread(chunk, 1, sizeof(chunk), log)) > 0) {
+        *output = (char*)realloc(*output, (*length + size + 1) * sizeof(char));
+        memcpy(*output + *length, chunk, size);
+        *length += size;
+        (*output)[*length] = '\0';
+    }
+
+    // the builder may still be writing, keep following from here
+    clearerr(log);
+}
+
+// exit status of the last finished build, -1 if there is none
+int build_status(char *build_dir) {
+    char path[strlen(build_dir) + 8];
+    sprintf(path, "%s/status", build_dir);
+
+    int status = -1;
+    FILE *fp = fopen(path, "r");
+    if(fp != NULL) {
+        if(fscanf(fp, "%d", &status) != 1) {
+            status = -1;
+        }
+
+        fclose(fp);
+    }
+
+    return status;
+}
+
+// hard links what a build produced between the environment and the build
+// directory, into the build when store is set and back out of it otherwise.
+// the shared object for the zygote is optional, the executable is not.
+int link_build(char *build_dir, char *file, int store) {
+    char *suffixes[] = {"", ".so"};
+    int i;
+
+    for(i = 0; i < 2; i++) {
+        char program[strlen(build_dir) + strlen("/program") + 4];
+        char target[2 * strlen(file) + 18 + 4];
+        sprintf(program, "%s/program%s", build_dir, suffixes[i]);
+        sprintf(target, "../environments/%s/%s%s", file, file, suffixes[i]);
+
+        if(i > 0 && access(store ? target : program, F_OK) != 0) {
+            continue;
+        }
+
+        if(store) {
+            unlink(program);
+        }
+
+        if(link(store ? target : program, store ? program : target) != 0) {
+            return -1;
+        }
+    }
 
+    return 0;
+}
 
+// the whole translation unit of a sketch, what create_hdr_file() and
+// create_src_file() would have written, in one buffer. the line directive
+// keeps __LINE__ where it is when the header is included on the first line.
+char* build_source(char *file, char *code, struct match_list functions) {
     int i;
-    for(i = 0; i < len_base; i++) {
-        command[i] = "cd ../dependencies ; make name="[i];
-        command[i + 1] = '\0';
+    int size = strlen(code) + strlen(file) + 256;
+    for(i = 0; i < functions.n_matches; i++) {
+        size += strlen(functions.matches[i]) + 2;
     }
 
-    strcat(command, file);
-    strcat(command, " 2>&1");
+    char *source = (char*)malloc(size * sizeof(char));
+    int length = 0;
+    for(i = 0; i < functions.n_matches; i++) {
+        length += sprintf(source + length, "%s;\n", functions.matches[i]);
+    }
 
-    FILE* p = popen(command, "r");
-    if(!p) {
-        error("Unable to open gcc command.", 2);
+    sprintf(source + length, "#line 2 \"%s.cpp\"\n%s\n\n" SKETCH_MAIN, file, code);
+    return source;
+}
+
+// starts a compiler command from the dependencies directory on a source it reads
+// from a pipe, the source goes in whole before this returns. what it says goes
+// to *output_fd when that is not NULL and nowhere otherwise. returns its pid.
+int spawn_compiler(char *command, char *source, int *output_fd) {
+    int in_pipe[2];
+    int out_pipe[2] = {-1, -1};
+    if(pipe(in_pipe) < 0 || (output_fd != NULL && pipe(out_pipe) < 0)) {
+        error("Unable to pipe.", 3);
+        return -1;
+    }
+
+    int pid = fork();
+    if(pid < 0) {
+        error("Unable to fork.", 4);
+        return -1;
+    } else if(pid == 0) {
+        close(in_pipe[1]);
+        dup2(in_pipe[0], STDIN_FILENO);
+
+        int out = output_fd != NULL ? out_pipe[1] : open("/dev/null", O_WRONLY);
+        if(output_fd != NULL) {
+            close(out_pipe[0]);
+        }
+        dup2(out, STDOUT_FILENO);
+        dup2(out, STDERR_FILENO);
+
+        if(chdir("../dependencies") != 0) {
+            _exit(127);
+        }
+
+        execl("/bin/sh", "sh", "-c", command, (char *)NULL);
+        _exit(127);
+    }
+
+    close(in_pipe[0]);
+    if(output_fd != NULL) {
+        close(out_pipe[1]);
+        *output_fd = out_pipe[0];
+    }
+
+    // the compiler reads all of its input before it says anything, so the
+    // source can go in whole before we listen
+    int size = strlen(source);
+    int written = 0;
+    while(written < size) {
+        int n = write(in_pipe[1], source + written, size - written);
+        if(n <= 0) {
+            break;
+        }
+
+        written += n;
+    }
+    close(in_pipe[1]);
+
+    return pid;
+}
+
+// exit status of a compiler spawn_compiler() started, -1 if it did not exit
+int wait_compiler(int pid) {
+    int status;
+    if(waitpid(pid, &status, 0) < 0 || !WIFEXITED(status)) {
+        return -1;
+    }
+
+    return WEXITSTATUS(status);
+}
+
+// runs a compiler command to the end. returns its exit status, what it said
+// goes to output.
+int run_compiler(char *command, char *source, char **output, int *length) {
+    int output_fd;
+    int pid = spawn_compiler(command, source, &output_fd);
+    if(pid < 0) {
+        return -1;
+    }
+
+    char chunk[1024];
+    int n;
+    while((n = read(output_fd, chunk, sizeof(chunk))) > 0) {
+        *output = (char*)realloc(*output, (*length + n + 1) * sizeof(char));
+        memcpy(*output + *length, chunk, n);
+        *length += n;
+        (*output)[*length] = '\0';
+    }
+    close(output_fd);
+
+    return wait_compiler(pid);
+}
+
+// the parse and type check of a sketch without generating or linking anything,
+// most broken submissions are turned away here long before make would be done
+int check_syntax(char *file, char *code, char **output, int *length) {
+    int status_code = 0;
+    struct match_list functions = match_declarations(code, &status_code);
+    if(status_code != 0) {
         return -1;
     }
 
-    char *buff = (char*)malloc(1 * sizeof(char));
-    i = 0;
-    while((buff[i] = fgetc(p)) != EOF) {
-        i++;
-        buff = realloc(buff, (i + 1) * sizeof(char));
+    char *source = build_source(file, code, functions);
+    free_match_list(functions);
+
+    int status = run_compiler(SYNTAX_CHECK_COMMAND, source, output, length);
+    free(source);
+
+    return status;
+}
+
+// the lines of the compiler output about file's code, at most MAX_DIAGNOSTICS.
+// the sketch's first line is line 2 of every source we compile, the header
+// or the prototypes come before it. the strings point into output, which
+// gets cut up for it.
+struct diagnostic* parse_diagnostics(char *output, char *file, int *count) {
+    struct diagnostic *diagnostics = (struct diagnostic *)malloc(MAX_DIAGNOSTICS * sizeof(struct diagnostic));
+    char name[strlen(file) + 8];
+    sprintf(name, "%s.cpp:", file);
+
+    *count = 0;
+    char *line = output;
+    while(line != NULL && *line != '\0' && *count < MAX_DIAGNOSTICS) {
+        char *next = strchr(line, '\n');
+        if(next != NULL) {
+            *next++ = '\0';
+        }
+
+        // the file is named with or without its directory
+        char *at = strstr(line, name);
+        int row, column, offset = 0;
+        if(at != NULL && (at == line || at[-1] == '/')
+            && sscanf(at + strlen(name), "%d:%d: %n", &row, &column, &offset) == 2 && offset > 0) {
+            char *severity = at + strlen(name) + offset;
+            char *message = strstr(severity, ": ");
+
+            if(message != NULL) {
+                *message = '\0';
+                diagnostics[*count].line = row - 1;
+                diagnostics[*count].column = column;
+                diagnostics[*count].severity = severity;
+                diagnostics[*count].message = message + 2;
+                (*count)++;
+            }
+        }
+
+        line = next;
+    }
+
+    return diagnostics;
+}
+
+// error() for the compiler's output, with what it said about the code picked out
+void compile_error(char *output, char *file) {
+    int count;
+    char *copy = strdup(output);
+    struct diagnostic *diagnostics = parse_diagnostics(copy, file, &count);
+    error_diagnostics(output, 2, diagnostics, count);
+}
+
+// builds the program out of per function objects, or runs make for it when that
+// does not work out, teeing the compiler output into the build's log for anyone
+// waiting on the same build. code that does not parse never gets to either,
+// what the syntax check said is the whole log then.
+int run_build(char *file, char *source_code, char *build_dir, char **output, int *length) {
+    char command[strlen("cd ../dependencies ; make name=") + strlen(file) + strlen(" 2>&1") + 1];
+    sprintf(command, "cd ../dependencies ; make name=%s 2>&1", file);
+
+    char path[strlen(build_dir) + strlen("/status.tmp") + 1];
+
+    // the build is not finished for anyone until its status is back
+    sprintf(path, "%s/status", build_dir);
+    unlink(path);
+
+    sprintf(path, "%s/log", build_dir);
+    FILE *log = fopen(path, "w");
+
+    int code = check_syntax(file, source_code, output, length);
+    if(code != 0 && log != NULL) {
+        fwrite(*output, 1, *length, log);
+    }
+
+    // most resubmissions only changed a function or two
+    if(code == 0 && build_units(file, source_code) != 0) {
+        // make says it all again, warnings included
+        *length = 0;
+        (*output)[0] = '\0';
+
+        FILE* p = popen(command, "r");
+        if(!p) {
+            error("Unable to open gcc command.", 2);
+            return -1;
+        }
+
+        char chunk[1024];
+        size_t size;
+        while((size = fread(chunk, 1, sizeof(chunk), p)) > 0) {
+            *output = (char*)realloc(*output, (*length + size + 1) * sizeof(char));
+            memcpy(*output + *length, chunk, size);
+            *length += size;
+            (*output)[*length] = '\0';
+
+            if(log != NULL) {
+                fwrite(chunk, 1, size, log);
+                fflush(log);
+            }
+        }
+
+        code = pclose(p);
+    }
+
+    if(log != NULL) {
+        fclose(log);
+    }
+
+    if(code == 0 && link_build(build_dir, file, 1) != 0) {
+        error("Unable to store build.", 2);
+        return -1;
+    }
+
+    // what it was built from, for whoever finds it under the same key
+    char source[strlen(build_dir) + strlen("/source") + 1];
+    sprintf(source, "%s/source", build_dir);
+    FILE *stored = fopen(source, "w");
+    if(stored != NULL) {
+        fwrite(source_code, 1, strlen(source_code), stored);
+        fclose(stored);
+    }
+
+    // the status goes last and in one piece, it is what marks the build finished
+    char tmp[strlen(build_dir) + strlen("/status.tmp") + 1];
+    sprintf(tmp, "%s/status.tmp", build_dir);
+    sprintf(path, "%s/status", build_dir);
+
+    FILE *fp = fopen(tmp, "w");
+    if(fp != NULL) {
+        fprintf(fp, "%d\n", code);
+        fclose(fp);
+        rename(tmp, path);
+    }
+
+    return code;
+}
+
+// stands for the client library and headers every sketch is built against, so
+// a rebuilt library never reuses what was built against the old one. it goes by
+// what stat() says of each file, which changes whenever a file is rewritten.
+unsigned long long library_key() {
+    static unsigned long long key = 0;
+    if(key != 0) {
+        return key;
+    }
+
+    DIR *dir = opendir(DEPENDENCIES_DIR);
+    key = HASH_SEED;
+    if(dir == NULL) {
+        return key;
+    }
+
+    // summed so the order readdir() lists them in does not matter
+    struct dirent *entry;
+    while((entry = readdir(dir)) != NULL) {
+        char path[strlen(DEPENDENCIES_DIR) + strlen(entry->d_name) + 1];
+        sprintf(path, "%s%s", DEPENDENCIES_DIR, entry->d_name);
+
+        struct stat st;
+        if(stat(path, &st) != 0 || !S_ISREG(st.st_mode)) {
+            continue;
+        }
+
+        unsigned long long file = hash_string(entry->d_name, HASH_SEED);
+        file = hash_bytes(&st.st_size, sizeof(st.st_size), file);
+        file = hash_bytes(&st.st_mtim, sizeof(st.st_mtim), file);
+        file = hash_bytes(&st.st_ino, sizeof(st.st_ino), file);
+        key += file;
+    }
+
+    closedir(dir);
+    return key;
+}
+
+// 1 when the file at path holds exactly data. caches are keyed by a hash that
+// can be made to collide, this is what keeps them from handing out the wrong thing.
+int same_file(char *path, const char *data, size_t length) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if(fd < 0) {
+        return 0;
+    }
+
+    struct stat st;
+    if(fstat(fd, &st) != 0 || st.st_size != (off_t)length) {
+        close(fd);
+        return 0;
+    }
+
+    char *stored = (char*)malloc(length + 1);
+    size_t total = 0;
+    ssize_t size;
+    while(total < length && (size = read(fd, stored + total, length - total)) > 0) {
+        total += size;
+    }
+    close(fd);
+
+    int same = total == length && memcmp(stored, data, length) == 0;
+    free(stored);
+    return same;
+}
+
+// where the build of code lives, the directory name is hex of its key
+static void build_dir_for(char *code, char *build_dir) {
+    char hash[HASH_HEX_LENGTH + 1];
+    hash_hex(hash_string(code, library_key()), hash);
+    sprintf(build_dir, "%s%s", BUILDS_DIR, hash);
+}
+
+// 1 when the build in build_dir was built from code
+static int built_from(char *build_dir, char *code) {
+    char path[strlen(build_dir) + strlen("/source") + 1];
+    sprintf(path, "%s/source", build_dir);
+    return same_file(path, code, strlen(code));
+}
+
+// removes builds nobody has used for BUILD_TTL seconds
+void prune_builds() {
+    DIR *dir = opendir(BUILDS_DIR);
+    if(dir == NULL) {
+        return;
+    }
+
+    time_t now = time(NULL);
+    struct dirent *entry;
+    while((entry = readdir(dir)) != NULL) {
+        if(entry->d_name[0] == '.' || !strcmp(entry->d_name, "slots") || !strcmp(entry->d_name, "objects")) {
+            continue;
+        }
+
+        char build_dir[strlen(BUILDS_DIR) + strlen(entry->d_name) + 1];
+        sprintf(build_dir, "%s%s", BUILDS_DIR, entry->d_name);
+
+        struct stat st;
+        if(stat(build_dir, &st) != 0 || !S_ISDIR(st.st_mode) || now - st.st_mtime < BUILD_TTL) {
+            continue;
+        }
+
+        int fd = lock_build(build_dir, 0);
+        if(fd < 0) {
+            continue;
+        }
+
+        char path[strlen(build_dir) + strlen("/status.tmp") + 1];
+        char *files[] = {"program", "program.so", "log", "source", "status", "status.tmp", "lock"};
+        int i;
+        for(i = 0; i < 7; i++) {
+            sprintf(path, "%s/%s", build_dir, files[i]);
+            unlink(path);
+        }
+
+        rmdir(build_dir);
+        close(fd);
+    }
+
+    closedir(dir);
+    prune_objects();
+}
+
+// this is the final function to compile the executable.
+// builds are keyed on the code, so identical programs compile once: whoever
+// gets there first builds it, everybody else follows its log and shares the
+// result. actual compiler runs are capped by compile_slots().
+int compile(char *file, char *code) {
+    char build_dir[strlen(BUILDS_DIR) + HASH_HEX_LENGTH + 1];
+    build_dir_for(code, build_dir);
+
+    char *output = (char*)malloc(1 * sizeof(char));
+    int length = 0;
+    output[0] = '\0';
+
+    int waited = 0;
+    int lock_fd = lock_build(build_dir, 0);
+    if(lock_fd == LOCK_FAILED) {
+        lock_error();
+    } else if(lock_fd < 0) {
+        // the same program is compiling right now, wait for it instead of starting another
+        waited = 1;
+
+        char path[strlen(build_dir) + 5];
+        sprintf(path, "%s/log", build_dir);
+        FILE *log = NULL;
+
+        while((lock_fd = lock_build(build_dir, 0)) == -1) {
+            if(log == NULL) {
+                log = fopen(path, "r");
+            }
+
+            if(log != NULL) {
+                follow_log(log, &output, &length);
+            }
+
+            compile_wait();
+        }
+
+        if(log != NULL) {
+            follow_log(log, &output, &length);
+            fclose(log);
+        }
+
+        if(lock_fd < 0) {
+            lock_error();
+        }
     }
 
-    buff[i] = '\0';
-    int code = pclose(p);
+    // a finished build is reused. a failed one only by those who waited for it,
+    // anyone coming later tries again in case it was the machine that failed.
+    // one of other code whose key collides with ours is built over.
+    int status = build_status(build_dir);
+    if(status >= 0 && !built_from(build_dir, code)) {
+        status = -1;
+    }
 
-    if(code != 0) {
-        error(buff, 2);
+    if(status == 0 && link_build(build_dir, file, 0) != 0) {
+        status = -1;
+    }
+
+    if(status < 0 || (status > 0 && !waited)) {
+        length = 0;
+        output[0] = '\0';
+
+        int slot_fd = acquire_slot();
+        status = run_build(file, code, build_dir, &output, &length);
+        close(slot_fd);
+        fill_units();
+
+        METRIC_ADD(compiles, 1);
+        if(status != 0) {
+            METRIC_ADD(compile_failures, 1);
+        }
+    } else {
+        METRIC_ADD(cache_hits, 1);
+    }
+
+    // keeps the build from being pruned while it is in use
+    utime(build_dir, NULL);
+    close(lock_fd);
+
+    prune_builds();
+
+    if(status != 0) {
+        compile_error(output, file);
         return -1;
     }
 
+    free(output);
     return 0;
 }
 
+// builds a sketch without touching the environments directory. the source never
+// goes to disk and the program lands in an anonymous memory file, returned as
+// an fd to fexecve(). a program already in the build cache is opened from there.
+int initialize_in_memory(char *program_name, char *code) {
+    char build_dir[strlen(BUILDS_DIR) + HASH_HEX_LENGTH + 1];
+    build_dir_for(code, build_dir);
+
+    // we take no lock, so the program is opened before the build is checked. a
+    // rebuild takes the status away before it replaces the program, so one that
+    // still checks out afterwards is the program we opened.
+    char path[strlen(build_dir) + strlen("/program") + 1];
+    sprintf(path, "%s/program", build_dir);
+
+    int cached = open(path, O_RDONLY | O_CLOEXEC);
+    if(cached >= 0 && build_status(build_dir) == 0 && built_from(build_dir, code)) {
+        METRIC_ADD(cache_hits, 1);
+        utime(build_dir, NULL);
+        return cached;
+    } else if(cached >= 0) {
+        close(cached);
+    }
+
+    int status_code = 0;
+    struct match_list functions = match_declarations(code, &status_code);
+    if(status_code != 0) {
+        return -1;
+    }
+
+    char *source = build_source(program_name, code, functions);
+    free_match_list(functions);
+
+    // the compiler has to inherit it to write the program, the sketch does not
+    int program = memfd_create(program_name, 0);
+    if(program < 0) {
+        error("Unable to create program.", 2);
+        return -1;
+    }
+
+    char *output = (char*)malloc(1 * sizeof(char));
+    int length = 0;
+    output[0] = '\0';
+
+    char command[strlen(MEMORY_BUILD_COMMAND) + 32];
+    sprintf(command, MEMORY_BUILD_COMMAND, program);
+
+    // the parse alone first, a broken sketch never gets as far as code generation
+    int slot_fd = acquire_slot();
+    int status = run_compiler(SYNTAX_CHECK_COMMAND, source, &output, &length);
+    if(status == 0) {
+        length = 0;
+        output[0] = '\0';
+        status = run_compiler(command, source, &output, &length);
+    }
+    close(slot_fd);
+    free(source);
+
+    METRIC_ADD(compiles, 1);
+    if(status != 0) {
+        METRIC_ADD(compile_failures, 1);
+    }
+
+    if(status != 0) {
+        compile_error(output, program_name);
+        return -1;
+    }
+
+    fcntl(program, F_SETFD, FD_CLOEXEC);
+    free(output);
+    return program;
+}
+
 int initialize(char *program_name, char *code) {
     // first we need to create the environment
 
@@ -308,7 +1008,7 @@ int initialize(char *program_name, char *code) {
 
     free_match_list(functions);
     
-    if(compile(program_name) != 0) {
+    if(compile(program_name, code) != 0) {
         return -1;
     }
 
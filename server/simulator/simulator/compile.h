@@ -7,6 +7,33 @@
 #include <regex.h>
 #include <sys/stat.h>
 
+// finished builds live here by code hash, shared by every simulate process
+#define BUILDS_DIR "../builds/"
+#define SLOTS_DIR "../builds/slots/"
+// memory one compiler run is expected to need
+#define COMPILE_MEMORY_KB (512 * 1024)
+#define COMPILE_POLL_NSEC 20000000
+// seconds an unused build is kept
+#define BUILD_TTL 3600
+// what lock_build() returns when the lock file cannot be had at all, errno says why
+#define LOCK_FAILED -2
+// everything a sketch is built with, the client library and its headers
+#define DEPENDENCIES_DIR "../dependencies/"
+// the client library a sketch program is linked with, must match OBJECTS in
+// dependencies/Makefile
+#define CLIENT_OBJECTS "ArduinoHelpers.o TankClient.o VisionSystemClient.o Checkpoint.o Transport.o"
+// how a sketch is built in memory, run from the dependencies directory with the
+// source on stdin and the fd of the program to write
+#define MEMORY_BUILD_COMMAND "g++ -I ./ -x c++ - -x none " CLIENT_OBJECTS " -o /proc/self/fd/%d"
+// what every sketch is run by
+#define SKETCH_MAIN "int main(int argc, char *argv[]) {\n\tsetup();\n\twhile(1) {\n\t\tloop();\n\t}\n}\n"
+
+// the front end of the same compile, run before either build so code that
+// does not parse is turned away without generating or linking anything
+#define SYNTAX_CHECK_COMMAND "g++ -I ./ -fsyntax-only -x c++ -"
+// most diagnostics a failed compile reports on their own
+#define MAX_DIAGNOSTICS 64
+
 struct match_list {
     char **matches;
     int n_matches;
@@ -17,7 +44,16 @@ struct file_names {
     char *src;
 };
 
+struct match_list match_declarations(char *code, int *status_code);
+void free_match_list(struct match_list m);
+int try_slot();
+int spawn_compiler(char *command, char *source, int *output_fd);
+int wait_compiler(int pid);
+int run_compiler(char *command, char *source, char **output, int *length);
 int initialize(char *program_name, char *code);
+int initialize_in_memory(char *program_name, char *code);
 int cleanup(char *program_name);
+unsigned long long library_key();
+int same_file(char *path, const char *data, size_t length);
 
 #endif
\ No newline at end of file
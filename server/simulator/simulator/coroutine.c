@@ -0,0 +1,259 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <unistd.h>
+#include <dlfcn.h>
+#include <ucontext.h>
+#include <sys/prctl.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <linux/audit.h>
+#include <linux/filter.h>
+#include <linux/seccomp.h>
+
+#include "coroutine.h"
+#include "ring.h"
+#include "error.h"
+#include "end.h"
+#include "summary.h"
+#include "metrics.h"
+#include "output.h"
+
+#if defined(__x86_64__)
+#define SANDBOX_ARCH AUDIT_ARCH_X86_64
+#elif defined(__aarch64__)
+#define SANDBOX_ARCH AUDIT_ARCH_AARCH64
+#endif
+
+#define ALLOW(nr) \
+    BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, (nr), 0, 1), \
+    BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ALLOW)
+
+// must match dependencies/Transport.h
+typedef void (*transport_hook)(const char *message, int length, char *reply, int reply_length);
+
+// the sketch and the physics loop take turns on these two stacks. the sketch only
+// hands control back when it has used up its library calls for the frame.
+static ucontext_t physics_context, sketch_context;
+static int (*sketch_main)(int, char**);
+static char *sketch_path;
+static int finished = 0;
+// set while the sketch's own code runs, not the library calls it makes
+static int in_sketch = 0;
+
+// state the library calls work on, they arrive through the client library
+// with no way to pass it along
+static struct arena *current_arena;
+static int current_frame;
+static int processed;
+static int budget;
+static struct ring in, replies;
+static struct process self;
+
+// a library call from the sketch, running on the sketch's stack. it goes through
+// the same decoder as a message from a pipe, just without the pipe.
+static void on_message(const char *message, int length, char *reply, int reply_length) {
+    while(processed >= budget || current_frame >= options.num_frames) {
+        swapcontext(&sketch_context, &physics_context);
+    }
+    in_sketch = 0;
+
+    ring_push(&in, message, length);
+    int size = message_length(&in);
+    if(size <= 0) {
+        error("Client library sent a malformed message.", 12);
+    }
+
+    process_command(&in, size, self, current_arena, &current_frame);
+    processed++;
+
+    // an ack has nothing in it worth reading
+    if(reply_length > 0) {
+        ring_copy(&replies, 0, reply, reply_length);
+    }
+    ring_init(&replies);
+    in_sketch = 1;
+}
+
+// a sketch that calls exit() ends the run like one whose main() returned. the
+// frame it was in still counts, and the frames we buffered and the summary go
+// out before the worker is gone.
+static void sketch_exit() {
+    if(!in_sketch) {
+        return;
+    }
+
+    int end_robot = -1;
+    current_frame++;
+    const char *reason = check_end(current_arena, processed, 1, &end_robot);
+    print_summary(current_arena);
+    print_end(reason, current_frame, end_robot);
+    out_flush(&out);
+    _exit(0);
+}
+
+static void run_sketch() {
+    char *argv[] = { sketch_path, NULL };
+    sketch_main(1, argv);
+    finished = 1;
+}
+
+// from here on the worker can compute, allocate and write to what it already has
+// open. no file size limit, our own output may well be a file.
+static void sandbox() {
+    struct rlimit limit;
+
+    limit.rlim_cur = limit.rlim_max = WORKER_CPU_SEC;
+    setrlimit(RLIMIT_CPU, &limit);
+    limit.rlim_cur = limit.rlim_max = WORKER_MEMORY;
+    setrlimit(RLIMIT_AS, &limit);
+    limit.rlim_cur = limit.rlim_max = 0;
+    setrlimit(RLIMIT_CORE, &limit);
+
+#ifdef SANDBOX_ARCH
+    struct sock_filter filter[] = {
+        BPF_STMT(BPF_LD | BPF_W | BPF_ABS, offsetof(struct seccomp_data, arch)),
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, SANDBOX_ARCH, 1, 0),
+        BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_KILL_PROCESS),
+        BPF_STMT(BPF_LD | BPF_W | BPF_ABS, offsetof(struct seccomp_data, nr)),
+        ALLOW(SYS_read),
+        ALLOW(SYS_write),
+        ALLOW(SYS_writev),
+        ALLOW(SYS_close),
+        ALLOW(SYS_fstat),
+#ifdef SYS_newfstatat
+        ALLOW(SYS_newfstatat),
+#endif
+        ALLOW(SYS_lseek),
+        ALLOW(SYS_brk),
+        ALLOW(SYS_mmap),
+        ALLOW(SYS_munmap),
+        ALLOW(SYS_mremap),
+        ALLOW(SYS_mprotect),
+        ALLOW(SYS_madvise),
+        ALLOW(SYS_rt_sigprocmask),
+        ALLOW(SYS_rt_sigreturn),
+        ALLOW(SYS_clock_gettime),
+        ALLOW(SYS_gettimeofday),
+        ALLOW(SYS_nanosleep),
+        ALLOW(SYS_clock_nanosleep),
+        ALLOW(SYS_futex),
+        ALLOW(SYS_getpid),
+        ALLOW(SYS_sched_yield),
+        ALLOW(SYS_exit),
+        ALLOW(SYS_exit_group),
+        BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_KILL_PROCESS),
+    };
+
+    struct sock_fprog program;
+    program.len = sizeof(filter) / sizeof(filter[0]);
+    program.filter = filter;
+
+    if(prctl(PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0) != 0 || prctl(PR_SET_SECCOMP, SECCOMP_MODE_FILTER, &program) != 0) {
+        error("Unable to sandbox sketch.", 12);
+    }
+#else
+    error("Unable to sandbox sketch.", 12);
+#endif
+}
+
+static void worker(char *sketch, struct arena *arena, int frame_no) {
+    // the sketch binds to the client library we load first
+    void *client = dlopen(CLIENT_LIBRARY, RTLD_NOW | RTLD_GLOBAL);
+    if(client == NULL) {
+        error("Unable to load client library.", 12);
+    }
+
+    void *handle = dlopen(sketch, RTLD_NOW);
+    if(handle == NULL) {
+        error("Unable to load sketch.", 12);
+    }
+
+    transport_hook *hook = (transport_hook *)dlsym(client, "direct_transport");
+    sketch_main = (int (*)(int, char**))dlsym(handle, "main");
+    if(hook == NULL || sketch_main == NULL) {
+        error("Unable to load sketch.", 12);
+    }
+    *hook = on_message;
+
+    // after the sketch is loaded, so it runs before the sketch's destructors
+    atexit(sketch_exit);
+
+    sketch_path = sketch;
+    current_arena = arena;
+    current_frame = frame_no;
+    budget = options.command_budget > 0 ? options.command_budget : COROUTINE_BUDGET;
+    ring_init(&in);
+    ring_init(&replies);
+
+    self.pid = getpid();
+    self.input_fd = -1;
+    self.output_fd = -1;
+    self.replies = &replies;
+    self.robot = 0;
+    self.log = NULL;
+
+    getcontext(&sketch_context);
+    sketch_context.uc_stack.ss_sp = malloc(COROUTINE_STACK_SIZE);
+    sketch_context.uc_stack.ss_size = COROUTINE_STACK_SIZE;
+    sketch_context.uc_link = &physics_context;
+    makecontext(&sketch_context, run_sketch, 0);
+
+    sandbox();
+
+    // the same order as frame(): move, then let the sketch have its calls
+    const char *reason = NULL;
+    int end_robot = -1;
+    while(current_frame < options.num_frames) {
+        update_osv(arena, current_frame);
+        processed = 0;
+
+        if(!finished) {
+            in_sketch = 1;
+            swapcontext(&physics_context, &sketch_context);
+            in_sketch = 0;
+        }
+
+        current_frame++;
+
+        // a sketch whose main() returned is the in-process version of one that exited
+        reason = check_end(arena, processed, finished, &end_robot);
+        if(reason != NULL) {
+            break;
+        }
+    }
+
+    print_summary(arena);
+    print_end(reason != NULL ? reason : "frames", current_frame, end_robot);
+    out_flush(&out);
+    _exit(0);
+}
+
+// runs the whole simulation in a sandboxed worker with the sketch loaded into it.
+// the worker prints the frames itself, we only wait for it.
+void run_in_process(char *sketch, struct arena *arena, int frame_no) {
+    // the worker gets a copy of the buffer, what is in it would go out twice
+    out_flush(&out);
+
+    int pid = fork();
+    if(pid < 0) {
+        error("Unable to fork.", 4);
+    } else if(pid == 0) {
+        worker(sketch, arena, frame_no);
+    }
+
+    int status;
+    if(waitpid(pid, &status, 0) < 0) {
+        error("Unable to wait for sketch.", 12);
+    }
+
+    if(WIFSIGNALED(status)) {
+        METRIC_ADD(crashes, 1);
+        error("Sketch was stopped by the sandbox.", 12);
+    } else if(WEXITSTATUS(status) != 0) {
+        // the worker already reported what went wrong
+        exit(WEXITSTATUS(status));
+    }
+}
@@ -0,0 +1,19 @@
+#ifndef COROUTINE_H
+#define COROUTINE_H
+
+#include "simulator.h"
+#include "vs.h"
+
+// the client library built as a shared object, see dependencies/Makefile
+#define CLIENT_LIBRARY "../dependencies/libclient.so"
+#define COROUTINE_STACK_SIZE (8 * 1024 * 1024)
+// library calls a sketch gets per frame when the request does not set a budget,
+// about what the pipe round trip allows in the isolated mode
+#define COROUTINE_BUDGET 1
+// limits of the worker the sketch runs in
+#define WORKER_CPU_SEC 60
+#define WORKER_MEMORY (1024L * 1024 * 1024)
+
+void run_in_process(char *sketch, struct arena *arena, int frame_no);
+
+#endif
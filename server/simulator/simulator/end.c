@@ -0,0 +1,105 @@
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include "end.h"
+#include "simulator.h"
+#include "metrics.h"
+#include "output.h"
+
+// poses at the end of the previous frame, to tell whether anything moved since
+static float last_x[MAX_ROBOTS], last_y[MAX_ROBOTS], last_theta[MAX_ROBOTS];
+static int have_last = 0;
+static int idle_frames = 0;
+static int talked = 0;
+
+// the first osv within the arrival radius of the destination, -1 if none is
+int arrived(struct arena *arena) {
+    int i;
+    float radius = options.arrival_radius;
+
+    if(radius <= 0) {
+        return -1;
+    }
+
+    for(i = 0; i < arena->robots.count; i++) {
+        float dx = arena->robots.x[i] - arena->destination.x;
+        float dy = arena->robots.y[i] - arena->destination.y;
+        if(dx * dx + dy * dy <= radius * radius) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+// called after every frame. messages is how many library calls the sketches made
+// during it and exited whether all of them are gone with nothing left queued.
+// returns why the run is over, or NULL to keep going. robot is set to the osv
+// the reason is about, -1 when it is about all of them.
+const char* check_end(struct arena *arena, int messages, int exited, int *robot) {
+    struct robots *robots = &arena->robots;
+    int i;
+    int moved = !have_last;
+    int waiting = 0;
+
+    for(i = 0; i < robots->count; i++) {
+        if(have_last && (fabs(robots->x[i] - last_x[i]) > IDLE_EPSILON
+            || fabs(robots->y[i] - last_y[i]) > IDLE_EPSILON
+            || fabs(robots->theta[i] - last_theta[i]) > IDLE_EPSILON)) {
+            moved = 1;
+        }
+
+        // a sketch sleeping in delay() is not idle, it is about to say something
+        if(robots->wake_frame[i] > 0) {
+            waiting = 1;
+        }
+
+        last_x[i] = robots->x[i];
+        last_y[i] = robots->y[i];
+        last_theta[i] = robots->theta[i];
+    }
+    have_last = 1;
+
+    *robot = arrived(arena);
+    if(*robot >= 0) {
+        return "arrived";
+    }
+
+    if(exited) {
+        return "exited";
+    }
+
+    // frames run faster than real time, a sketch that is still starting up
+    // would look idle long before it said anything
+    if(messages > 0) {
+        talked = 1;
+    }
+
+    if(moved || waiting || messages > 0 || !talked) {
+        idle_frames = 0;
+    } else {
+        idle_frames++;
+    }
+
+    if(options.idle_frames > 0 && idle_frames >= options.idle_frames) {
+        return "idle";
+    }
+
+    return NULL;
+}
+
+// the last record of every run, says why and after how many frames it stopped
+void print_end(const char *reason, int frames, int robot) {
+    out_raw(&out, "{\"end\":{\"reason\":");
+    out_string(&out, reason, strlen(reason));
+    out_raw(&out, ",\"frames\":");
+    out_int(&out, frames);
+    if(robot >= 0) {
+        out_raw(&out, ",\"robot\":");
+        out_int(&out, robot);
+    }
+    out_raw(&out, "}},");
+
+    count_ending(reason);
+}
@@ -0,0 +1,21 @@
+#ifndef END_H
+#define END_H
+
+#include "vs.h"
+
+// defaults of the policies that end a run early, a request can change them or
+// turn them off with 0. the radius is the one of the destination marker.
+#define ARRIVAL_RADIUS 0.09f
+// idle is counted in frames, which only keep to the sketch's own time when the
+// sketch sets the pace, deterministic or in process. otherwise a second of
+// frames goes by in a few milliseconds and a sketch busy for a moment would be
+// cut off, so such a run only ends on idle when the request asks for it.
+#define IDLE_SEC 5.0f
+// an osv that moves less than this in a frame is standing still
+#define IDLE_EPSILON 0.0001f
+
+int arrived(struct arena *arena);
+const char* check_end(struct arena *arena, int messages, int exited, int *robot);
+void print_end(const char *reason, int frames, int robot);
+
+#endif
@@ -1,20 +1,54 @@
 #include <stdio.h>
 #include <stdlib.h>
-#include <cjson/cJSON.h>
+#include <string.h>
+#include <unistd.h>
 
 #include "error.h"
+#include "metrics.h"
+#include "output.h"
 
 // this is the standard error function. exits with code "return_code".
 void error(char *error_msg, int return_code) {
-    
-    cJSON *root = cJSON_CreateObject();
-    cJSON *msg = cJSON_CreateString(error_msg);
-    cJSON_AddItemToObject(root, "error", msg);
-    cJSON_AddNumberToObject(root, "code", return_code);
-    fprintf(stderr, "%s", cJSON_Print(root));
-    cJSON_Delete(root);
-
-    fflush(stderr);
-    fflush(stdout);
+    error_diagnostics(error_msg, return_code, NULL, 0);
+}
+
+// error() for a failed compile, the diagnostics go along as a list the front
+// end can point at the code with
+void error_diagnostics(char *error_msg, int return_code, struct diagnostic *diagnostics, int count) {
+    int i;
+
+    if(return_code > 0 && return_code <= MAX_ERROR_CODE) {
+        METRIC_ADD(errors[return_code], 1);
+    }
+
+    // whatever made it into the records so far still goes out first
+    out_flush(&out);
+
+    char buffer[1024];
+    struct output err = { STDERR_FILENO, -1, 0, buffer, 0, sizeof(buffer) };
+    out_raw(&err, "{\"error\":");
+    out_string(&err, error_msg, strlen(error_msg));
+    out_raw(&err, ",\"code\":");
+    out_int(&err, return_code);
+
+    if(diagnostics != NULL) {
+        out_raw(&err, ",\"diagnostics\":[");
+        for(i = 0; i < count; i++) {
+            out_raw(&err, i > 0 ? ",{\"line\":" : "{\"line\":");
+            out_int(&err, diagnostics[i].line);
+            out_raw(&err, ",\"column\":");
+            out_int(&err, diagnostics[i].column);
+            out_raw(&err, ",\"severity\":");
+            out_string(&err, diagnostics[i].severity, strlen(diagnostics[i].severity));
+            out_raw(&err, ",\"message\":");
+            out_string(&err, diagnostics[i].message, strlen(diagnostics[i].message));
+            out_raw(&err, "}");
+        }
+        out_raw(&err, "]");
+    }
+
+    out_raw(&err, "}");
+    out_flush(&err);
+
     exit(return_code);
 }
\ No newline at end of file
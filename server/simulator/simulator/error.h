@@ -1,6 +1,17 @@
 #ifndef ERROR_H
 #define ERROR_H
 
-void error(char *error_msg, int return_code);
+// one line of compiler output that points at the student's code, line and
+// column are the student's own
+struct diagnostic {
+    int line;
+    int column;
+    char *severity;
+    char *message;
+};
 
-#endif
\ No newline at end of file
+// both exit with return_code, so callers need no break or return after them
+__attribute__((noreturn)) void error(char *error_msg, int return_code);
+__attribute__((noreturn)) void error_diagnostics(char *error_msg, int return_code, struct diagnostic *diagnostics, int count);
+
+#endif
@@ -0,0 +1,276 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "field.h"
+#include "error.h"
+
+#define FIELD_FAR 1e20
+
+// felzenszwalb's squared distance transform of one row or column of the grid.
+// f is read with stride, the result goes back into f with the same stride.
+static void transform_line(float *f, int n, int stride, double *line, double *d, int *v, double *z) {
+    int q, k = 0;
+
+    for(q = 0; q < n; q++) {
+        line[q] = f[q * stride];
+    }
+
+    v[0] = 0;
+    z[0] = -FIELD_FAR;
+    z[1] = FIELD_FAR;
+    for(q = 1; q < n; q++) {
+        double s = ((line[q] + (double)q * q) - (line[v[k]] + (double)v[k] * v[k])) / (2.0 * q - 2.0 * v[k]);
+        while(s <= z[k]) {
+            k--;
+            s = ((line[q] + (double)q * q) - (line[v[k]] + (double)v[k] * v[k])) / (2.0 * q - 2.0 * v[k]);
+        }
+
+        k++;
+        v[k] = q;
+        z[k] = s;
+        z[k + 1] = FIELD_FAR;
+    }
+
+    k = 0;
+    for(q = 0; q < n; q++) {
+        while(z[k + 1] < q) {
+            k++;
+        }
+
+        d[q] = (double)(q - v[k]) * (q - v[k]) + line[v[k]];
+    }
+
+    for(q = 0; q < n; q++) {
+        f[q * stride] = (float)d[q];
+    }
+}
+
+static int to_cell(float value, float origin, float cell, int count) {
+    int i = (int)floor((value - origin) / cell);
+    return i < 0 ? 0 : (i >= count ? count - 1 : i);
+}
+
+struct field* build_field(struct arena *arena) {
+    int i, r, c;
+
+    // nothing to trace against, the plain loop is already free
+    if(arena->num_obstacles == 0) {
+        return NULL;
+    }
+
+    // obstacles hang down and right from their location
+    float min_x = arena->obstacles[0].location.x;
+    float max_x = min_x + arena->obstacles[0].width;
+    float max_y = arena->obstacles[0].location.y;
+    float min_y = max_y - arena->obstacles[0].height;
+    for(i = 1; i < arena->num_obstacles; i++) {
+        struct obstacle *o = &arena->obstacles[i];
+        min_x = fminf(min_x, o->location.x);
+        max_x = fmaxf(max_x, o->location.x + o->width);
+        min_y = fminf(min_y, o->location.y - o->height);
+        max_y = fmaxf(max_y, o->location.y);
+    }
+
+    struct field *field = (struct field *)malloc(sizeof(struct field));
+    field->cell = FIELD_CELL;
+    while(1) {
+        // a couple of free cells around the border so every edge has a cell on both sides
+        field->x = min_x - 2 * field->cell;
+        field->y = min_y - 2 * field->cell;
+        field->cols = (int)ceil((max_x - min_x) / field->cell) + 4;
+        field->rows = (int)ceil((max_y - min_y) / field->cell) + 4;
+        if((long)field->cols * field->rows <= FIELD_MAX_CELLS) {
+            break;
+        }
+
+        field->cell *= 2;
+    }
+
+    long cells = (long)field->cols * field->rows;
+    field->distance = (float *)malloc(cells * sizeof(float));
+    field->start = (int *)calloc(cells + 1, sizeof(int));
+    int *last = (int *)malloc(cells * sizeof(int));
+    if(field->distance == NULL || field->start == NULL || last == NULL) {
+        error("Unable to allocate distance field.", 6);
+    }
+
+    for(i = 0; i < cells; i++) {
+        field->distance[i] = FIELD_FAR;
+    }
+
+    // only the edges can stop a sensor, so only the cells they pass through are
+    // occupied. the first pass counts obstacles per cell, the second lists them.
+    int pass;
+    for(pass = 0; pass < 2; pass++) {
+        for(i = 0; i < cells; i++) {
+            last[i] = -1;
+        }
+
+        for(i = 0; i < arena->num_obstacles; i++) {
+            struct obstacle *o = &arena->obstacles[i];
+            int c0 = to_cell(o->location.x, field->x, field->cell, field->cols);
+            int c1 = to_cell(o->location.x + o->width, field->x, field->cell, field->cols);
+            int r0 = to_cell(o->location.y - o->height, field->y, field->cell, field->rows);
+            int r1 = to_cell(o->location.y, field->y, field->cell, field->rows);
+
+            for(r = r0; r <= r1; r++) {
+                for(c = c0; c <= c1; c++) {
+                    int cell = r * field->cols + c;
+                    if((r != r0 && r != r1 && c != c0 && c != c1) || last[cell] == i) {
+                        continue;
+                    }
+
+                    last[cell] = i;
+                    if(pass == 0) {
+                        field->distance[cell] = 0;
+                        field->start[cell + 1]++;
+                    } else {
+                        field->ids[field->start[cell]++] = i;
+                    }
+                }
+            }
+        }
+
+        if(pass == 0) {
+            // prefix sums, the fill pass then walks each cell's start up to its end
+            for(i = 0; i < cells; i++) {
+                field->start[i + 1] += field->start[i];
+            }
+
+            field->ids = (int *)malloc((field->start[cells] + 1) * sizeof(int));
+            if(field->ids == NULL) {
+                error("Unable to allocate distance field.", 6);
+            }
+        }
+    }
+
+    // start[cell] now holds where cell + 1 starts, shift it back
+    for(i = cells; i > 0; i--) {
+        field->start[i] = field->start[i - 1];
+    }
+    field->start[0] = 0;
+    free(last);
+
+    int longest = field->cols > field->rows ? field->cols : field->rows;
+    double *line = (double *)malloc(longest * sizeof(double));
+    double *d = (double *)malloc(longest * sizeof(double));
+    double *z = (double *)malloc((longest + 1) * sizeof(double));
+    int *v = (int *)malloc(longest * sizeof(int));
+
+    for(c = 0; c < field->cols; c++) {
+        transform_line(field->distance + c, field->rows, field->cols, line, d, v, z);
+    }
+
+    for(r = 0; r < field->rows; r++) {
+        transform_line(field->distance + r * field->cols, field->cols, 1, line, d, v, z);
+    }
+
+    // squared cells to meters
+    for(i = 0; i < cells; i++) {
+        field->distance[i] = sqrt(field->distance[i]) * field->cell;
+    }
+
+    free(line);
+    free(d);
+    free(z);
+    free(v);
+
+    return field;
+}
+
+void free_field(struct field *field) {
+    if(field == NULL) {
+        return;
+    }
+
+    free(field->distance);
+    free(field->start);
+    free(field->ids);
+    free(field);
+}
+
+// narrows [t0, t1] along the ray to the part inside the grid, 0 if it misses it
+static int clip_to_field(struct field *field, struct coordinate origin, float dx, float dy, float *t0, float *t1) {
+    float lo[2] = {field->x, field->y};
+    float hi[2] = {field->x + field->cols * field->cell, field->y + field->rows * field->cell};
+    float o[2] = {origin.x, origin.y};
+    float dir[2] = {dx, dy};
+    int axis;
+
+    for(axis = 0; axis < 2; axis++) {
+        if(fabsf(dir[axis]) < 1e-9f) {
+            if(o[axis] < lo[axis] || o[axis] > hi[axis]) {
+                return 0;
+            }
+            continue;
+        }
+
+        float near = (lo[axis] - o[axis]) / dir[axis];
+        float far = (hi[axis] - o[axis]) / dir[axis];
+        if(near > far) {
+            float tmp = near;
+            near = far;
+            far = tmp;
+        }
+
+        *t0 = fmaxf(*t0, near);
+        *t1 = fminf(*t1, far);
+    }
+
+    return *t0 <= *t1;
+}
+
+// sphere traces the sensor ray through the field. far from everything the field
+// says how far we can safely jump, near a surface we walk a cell at a time and
+// test the obstacles around us exactly so the result matches the brute force.
+float trace_field(struct arena *arena, struct line sensor_trace, float range) {
+    struct field *field = arena->field;
+    float dx = (sensor_trace.p2.x - sensor_trace.p1.x) / range;
+    float dy = (sensor_trace.p2.y - sensor_trace.p1.y) / range;
+
+    // the grid holds every obstacle, a ray never comes back into it once out
+    float t = 0, t_end = range;
+    if(!clip_to_field(field, sensor_trace.p1, dx, dy, &t, &t_end)) {
+        return range;
+    }
+
+    // the field is measured between cell centers, the surface can be half a
+    // diagonal from either center
+    float slack = field->cell * sqrt(2.0f);
+
+    while(t <= t_end) {
+        int c = to_cell(sensor_trace.p1.x + t * dx, field->x, field->cell, field->cols);
+        int r = to_cell(sensor_trace.p1.y + t * dy, field->y, field->cell, field->rows);
+
+        float safe = field->distance[r * field->cols + c] - slack;
+        if(safe > field->cell) {
+            t += safe;
+            continue;
+        }
+
+        // anything the next step can reach is in the 3x3 cells around us
+        int i, j;
+        float hit = range;
+        for(i = r - 1; i <= r + 1; i++) {
+            for(j = c - 1; j <= c + 1; j++) {
+                if(i < 0 || j < 0 || i >= field->rows || j >= field->cols) {
+                    continue;
+                }
+
+                int cell = i * field->cols + j, k;
+                for(k = field->start[cell]; k < field->start[cell + 1]; k++) {
+                    hit = sides_distance(arena->sides + 4 * field->ids[k], sensor_trace, hit);
+                }
+            }
+        }
+
+        if(hit <= t + field->cell) {
+            return hit;
+        }
+
+        t += field->cell;
+    }
+
+    return range;
+}
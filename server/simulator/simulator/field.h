@@ -0,0 +1,26 @@
+#ifndef FIELD_H
+#define FIELD_H
+
+#include "vs.h"
+
+// side of a grid cell in meters, doubled until the grid fits in FIELD_MAX_CELLS
+#define FIELD_CELL 0.01f
+#define FIELD_MAX_CELLS (2048 * 2048)
+
+// grid of the cells the obstacle edges pass through with the euclidean distance
+// transform of it. each cell lists its obstacles as ids[start[cell]..start[cell + 1]].
+// the obstacles never move during a run so this gets built once per arena.
+struct field {
+    float x, y;
+    float cell;
+    int cols, rows;
+    float *distance;
+    int *start;
+    int *ids;
+};
+
+struct field* build_field(struct arena *arena);
+void free_field(struct field *field);
+float trace_field(struct arena *arena, struct line sensor_trace, float range);
+
+#endif
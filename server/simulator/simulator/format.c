@@ -0,0 +1,327 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "format.h"
+
+// shortest round trip formatting of floats after ulf adams' ryu (pldi 2018).
+// the value is scaled into a window of three decimals, the value itself and
+// the halfway points to its neighbours, using 64 bit approximations of powers
+// of five, and digits are dropped for as long as the window still tells the
+// value apart from both neighbours. no loop over candidate precisions, no
+// bignums and no allocation, and the digits are exactly the ones strtof needs.
+
+#define FLOAT_MANTISSA_BITS 23
+#define FLOAT_BIAS 127
+#define FLOAT_POW5_INV_BITCOUNT 59
+#define FLOAT_POW5_BITCOUNT 61
+
+// floor(2^(pow5bits(i) - 1 + 59) / 5^i) + 1
+static const uint64_t FLOAT_POW5_INV_SPLIT[31] = {
+    576460752303423489ULL, 461168601842738791ULL, 368934881474191033ULL,
+    295147905179352826ULL, 472236648286964522ULL, 377789318629571618ULL,
+    302231454903657294ULL, 483570327845851670ULL, 386856262276681336ULL,
+    309485009821345069ULL, 495176015714152110ULL, 396140812571321688ULL,
+    316912650057057351ULL, 507060240091291761ULL, 405648192073033409ULL,
+    324518553658426727ULL, 519229685853482763ULL, 415383748682786211ULL,
+    332306998946228969ULL, 531691198313966350ULL, 425352958651173080ULL,
+    340282366920938464ULL, 544451787073501542ULL, 435561429658801234ULL,
+    348449143727040987ULL, 557518629963265579ULL, 446014903970612463ULL,
+    356811923176489971ULL, 570899077082383953ULL, 456719261665907162ULL,
+    365375409332725730ULL,
+};
+
+// the top 61 bits of 5^i
+static const uint64_t FLOAT_POW5_SPLIT[48] = {
+    1152921504606846976ULL, 1441151880758558720ULL, 1801439850948198400ULL,
+    2251799813685248000ULL, 1407374883553280000ULL, 1759218604441600000ULL,
+    2199023255552000000ULL, 1374389534720000000ULL, 1717986918400000000ULL,
+    2147483648000000000ULL, 1342177280000000000ULL, 1677721600000000000ULL,
+    2097152000000000000ULL, 1310720000000000000ULL, 1638400000000000000ULL,
+    2048000000000000000ULL, 1280000000000000000ULL, 1600000000000000000ULL,
+    2000000000000000000ULL, 1250000000000000000ULL, 1562500000000000000ULL,
+    1953125000000000000ULL, 1220703125000000000ULL, 1525878906250000000ULL,
+    1907348632812500000ULL, 1192092895507812500ULL, 1490116119384765625ULL,
+    1862645149230957031ULL, 1164153218269348144ULL, 1455191522836685180ULL,
+    1818989403545856475ULL, 2273736754432320594ULL, 1421085471520200371ULL,
+    1776356839400250464ULL, 2220446049250313080ULL, 1387778780781445675ULL,
+    1734723475976807094ULL, 2168404344971008868ULL, 1355252715606880542ULL,
+    1694065894508600678ULL, 2117582368135750847ULL, 1323488980084844279ULL,
+    1654361225106055349ULL, 2067951531382569187ULL, 1292469707114105741ULL,
+    1615587133892632177ULL, 2019483917365790221ULL, 1262177448353618888ULL,
+};
+
+// ceil(log2(5^e)), 1 for e = 0
+static int pow5bits(int e) {
+    return (int)(((uint32_t)e * 1217359) >> 19) + 1;
+}
+
+// floor(log10(2^e)) and floor(log10(5^e))
+static int log10_pow2(int e) {
+    return (int)(((uint32_t)e * 78913) >> 18);
+}
+
+static int log10_pow5(int e) {
+    return (int)(((uint32_t)e * 732923) >> 20);
+}
+
+static int pow5_factor(uint32_t value) {
+    int count = 0;
+
+    while(value % 5 == 0) {
+        value /= 5;
+        count++;
+    }
+
+    return count;
+}
+
+static int multiple_of_pow5(uint32_t value, int p) {
+    return pow5_factor(value) >= p;
+}
+
+static int multiple_of_pow2(uint32_t value, int p) {
+    return (value & ((1u << p) - 1)) == 0;
+}
+
+static uint32_t mul_shift(uint32_t m, uint64_t factor, int shift) {
+    uint64_t low = (uint64_t)m * (uint32_t)factor;
+    uint64_t high = (uint64_t)m * (uint32_t)(factor >> 32);
+    return (uint32_t)(((low >> 32) + high) >> (shift - 32));
+}
+
+// the shortest digits that read back as the float with these bits, as
+// digits * 10^exponent. the sign is left to the caller.
+static void shortest(uint32_t mantissa, uint32_t biased, uint32_t *digits, int *exponent) {
+    int e2;
+    uint32_t m2;
+
+    if(biased == 0) {
+        e2 = 1 - FLOAT_BIAS - FLOAT_MANTISSA_BITS - 2;
+        m2 = mantissa;
+    } else {
+        e2 = (int)biased - FLOAT_BIAS - FLOAT_MANTISSA_BITS - 2;
+        m2 = (1u << FLOAT_MANTISSA_BITS) | mantissa;
+    }
+
+    // round half to even, so the halfway points belong to an even value
+    int accept_bounds = (m2 & 1) == 0;
+
+    // the value and its halfway points, times 4 so they are all integers. the
+    // lower one is closer when the value is the smallest of its binade.
+    uint32_t mv = 4 * m2;
+    uint32_t mp = 4 * m2 + 2;
+    int mm_shift = mantissa != 0 || biased <= 1;
+    uint32_t mm = 4 * m2 - 1 - mm_shift;
+
+    uint32_t vr, vp, vm;
+    int e10;
+    int vm_trailing_zeros = 0, vr_trailing_zeros = 0;
+    uint32_t last_removed = 0;
+
+    if(e2 >= 0) {
+        int q = log10_pow2(e2);
+        int k = FLOAT_POW5_INV_BITCOUNT + pow5bits(q) - 1;
+        int i = -e2 + q + k;
+
+        e10 = q;
+        vr = mul_shift(mv, FLOAT_POW5_INV_SPLIT[q], i);
+        vp = mul_shift(mp, FLOAT_POW5_INV_SPLIT[q], i);
+        vm = mul_shift(mm, FLOAT_POW5_INV_SPLIT[q], i);
+
+        if(q != 0 && (vp - 1) / 10 <= vm / 10) {
+            // the loop below removes at most one digit, we need the one before it
+            int l = FLOAT_POW5_INV_BITCOUNT + pow5bits(q - 1) - 1;
+            last_removed = mul_shift(mv, FLOAT_POW5_INV_SPLIT[q - 1], -e2 + q - 1 + l) % 10;
+        }
+
+        if(q <= 9) {
+            // only one of mp, mv and mm can be a multiple of 5
+            if(mv % 5 == 0) {
+                vr_trailing_zeros = multiple_of_pow5(mv, q);
+            } else if(accept_bounds) {
+                vm_trailing_zeros = multiple_of_pow5(mm, q);
+            } else {
+                vp -= multiple_of_pow5(mp, q);
+            }
+        }
+    } else {
+        int q = log10_pow5(-e2);
+        int i = -e2 - q;
+        int k = pow5bits(i) - FLOAT_POW5_BITCOUNT;
+        int j = q - k;
+
+        e10 = q + e2;
+        vr = mul_shift(mv, FLOAT_POW5_SPLIT[i], j);
+        vp = mul_shift(mp, FLOAT_POW5_SPLIT[i], j);
+        vm = mul_shift(mm, FLOAT_POW5_SPLIT[i], j);
+
+        if(q != 0 && (vp - 1) / 10 <= vm / 10) {
+            j = q - 1 - (pow5bits(i + 1) - FLOAT_POW5_BITCOUNT);
+            last_removed = mul_shift(mv, FLOAT_POW5_SPLIT[i + 1], j) % 10;
+        }
+
+        if(q <= 1) {
+            // mv has at least q trailing zero bits, so it is a multiple of 2^q
+            vr_trailing_zeros = 1;
+            if(accept_bounds) {
+                vm_trailing_zeros = mm_shift == 1;
+            } else {
+                vp--;
+            }
+        } else if(q < 31) {
+            vr_trailing_zeros = multiple_of_pow2(mv, q - 1);
+        }
+    }
+
+    // drop digits while the window still holds only our value
+    int removed = 0;
+    uint32_t output;
+
+    if(vm_trailing_zeros || vr_trailing_zeros) {
+        // the rare exact cases, the halfway points may be part of the window
+        while(vp / 10 > vm / 10) {
+            vm_trailing_zeros &= vm % 10 == 0;
+            vr_trailing_zeros &= last_removed == 0;
+            last_removed = vr % 10;
+            vr /= 10;
+            vp /= 10;
+            vm /= 10;
+            removed++;
+        }
+
+        if(vm_trailing_zeros) {
+            while(vm % 10 == 0) {
+                vr_trailing_zeros &= last_removed == 0;
+                last_removed = vr % 10;
+                vr /= 10;
+                vp /= 10;
+                vm /= 10;
+                removed++;
+            }
+        }
+
+        // exactly halfway, round to even
+        if(vr_trailing_zeros && last_removed == 5 && vr % 2 == 0) {
+            last_removed = 4;
+        }
+
+        output = vr + ((vr == vm && (!accept_bounds || !vm_trailing_zeros)) || last_removed >= 5);
+    } else {
+        while(vp / 10 > vm / 10) {
+            last_removed = vr % 10;
+            vr /= 10;
+            vp /= 10;
+            vm /= 10;
+            removed++;
+        }
+
+        output = vr + (vr == vm || last_removed >= 5);
+    }
+
+    *digits = output;
+    *exponent = e10 + removed;
+}
+
+// writes value as the shortest json number that reads back as exactly the same
+// float, plain up to 15 digits before and 4 zeros after the point, with an
+// exponent beyond. json has no nan or infinity, those come out as null like
+// they do from cjson. returns the length, out needs FLOAT_LENGTH bytes.
+int format_float(float value, char *out) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    uint32_t mantissa = bits & ((1u << FLOAT_MANTISSA_BITS) - 1);
+    uint32_t biased = (bits >> FLOAT_MANTISSA_BITS) & 0xff;
+    char *p = out;
+
+    if(biased == 0xff) {
+        strcpy(out, "null");
+        return 4;
+    }
+
+    if(bits >> 31) {
+        *p++ = '-';
+    }
+
+    if(biased == 0 && mantissa == 0) {
+        *p++ = '0';
+        *p = '\0';
+        return p - out;
+    }
+
+    uint32_t digits;
+    int exponent;
+    shortest(mantissa, biased, &digits, &exponent);
+
+    char d[10];
+    int n = 0;
+    while(digits > 0) {
+        d[n++] = '0' + digits % 10;
+        digits /= 10;
+    }
+
+    // digits before the decimal point, d holds them last to first
+    int point = n + exponent;
+    int i;
+
+    if(point > 0 && point <= 15) {
+        for(i = 0; i < n; i++) {
+            if(i == point) {
+                *p++ = '.';
+            }
+            *p++ = d[n - 1 - i];
+        }
+
+        for(; i < point; i++) {
+            *p++ = '0';
+        }
+    } else if(point > -5 && point <= 0) {
+        *p++ = '0';
+        *p++ = '.';
+        for(i = point; i < 0; i++) {
+            *p++ = '0';
+        }
+
+        for(i = 0; i < n; i++) {
+            *p++ = d[n - 1 - i];
+        }
+    } else {
+        *p++ = d[n - 1];
+        if(n > 1) {
+            *p++ = '.';
+            for(i = 1; i < n; i++) {
+                *p++ = d[n - 1 - i];
+            }
+        }
+
+        *p++ = 'e';
+        p += format_int(point - 1, p);
+    }
+
+    *p = '\0';
+    return p - out;
+}
+
+// returns the length, out needs INT_LENGTH bytes
+int format_int(long value, char *out) {
+    char d[INT_LENGTH];
+    unsigned long magnitude = value < 0 ? -(unsigned long)value : (unsigned long)value;
+    char *p = out;
+    int n = 0;
+
+    if(value < 0) {
+        *p++ = '-';
+    }
+
+    do {
+        d[n++] = '0' + magnitude % 10;
+        magnitude /= 10;
+    } while(magnitude > 0);
+
+    while(n > 0) {
+        *p++ = d[--n];
+    }
+
+    *p = '\0';
+    return p - out;
+}
@@ -0,0 +1,14 @@
+#ifndef FORMAT_H
+#define FORMAT_H
+
+// longest thing format_float() writes and the terminator. that is a negative
+// value with four zeros after the point before its nine digits,
+// "-0.0000100014395", or one of 15 digits before it, not the exponent form.
+#define FLOAT_LENGTH 17
+// longest thing format_int() writes, a long with its sign and the terminator
+#define INT_LENGTH 21
+
+int format_float(float value, char *out);
+int format_int(long value, char *out);
+
+#endif
@@ -0,0 +1,28 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "hash.h"
+
+#define HASH_PRIME 1099511628211ULL
+
+unsigned long long hash_bytes(const void *data, size_t length, unsigned long long seed) {
+    const unsigned char *bytes = (const unsigned char *)data;
+    unsigned long long hash = seed;
+    size_t i;
+
+    for(i = 0; i < length; i++) {
+        hash ^= bytes[i];
+        hash *= HASH_PRIME;
+    }
+
+    return hash;
+}
+
+unsigned long long hash_string(const char *str, unsigned long long seed) {
+    return hash_bytes(str, strlen(str), seed);
+}
+
+// out needs room for HASH_HEX_LENGTH characters and the terminator
+void hash_hex(unsigned long long hash, char *out) {
+    sprintf(out, "%016llx", hash);
+}
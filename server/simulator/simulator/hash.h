@@ -0,0 +1,14 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <stddef.h>
+
+#define HASH_SEED 14695981039346656037ULL
+#define HASH_HEX_LENGTH 16
+
+// 64 bit fnv-1a, pass the previous result as seed to hash several pieces as one
+unsigned long long hash_bytes(const void *data, size_t length, unsigned long long seed);
+unsigned long long hash_string(const char *str, unsigned long long seed);
+void hash_hex(unsigned long long hash, char *out);
+
+#endif
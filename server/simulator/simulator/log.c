@@ -0,0 +1,125 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "log.h"
+#include "error.h"
+#include "metrics.h"
+#include "output.h"
+
+// a fresh log channel, write_fd is the end the sketch gets as LOG_FD
+struct log* open_log(int *write_fd) {
+    int fds[2];
+
+    if(pipe(fds) < 0) {
+        error("Unable to pipe.", 3);
+    }
+
+    fcntl(fds[0], F_SETFL, O_NONBLOCK);
+
+    struct log *log = (struct log *)malloc(sizeof(struct log));
+    log->fd = fds[0];
+    log->data = (char *)malloc(LOG_INITIAL_CAPACITY);
+    log->length = 0;
+    log->capacity = LOG_INITIAL_CAPACITY;
+    log->skip = 0;
+
+    *write_fd = fds[1];
+    return log;
+}
+
+static unsigned int get_int(const char *data) {
+    const unsigned char *bytes = (const unsigned char *)data;
+    return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | ((unsigned int)bytes[3] << 24);
+}
+
+// the same record print_command() makes, the text is escaped where it lies
+static void print_log(const char *text, unsigned int length, int ln, int robot) {
+    out_raw(&out, "{\"command\":\"print\",\"data\":");
+    out_string(&out, text, length);
+    out_raw(&out, ",\"line_number\":");
+    out_int(&out, ln);
+    if(robot >= 0) {
+        out_raw(&out, ",\"robot\":");
+        out_int(&out, robot);
+    }
+    out_raw(&out, "},");
+}
+
+// prints every complete record in the buffer and keeps the rest for later
+static int print_records(struct log *log, int robot) {
+    unsigned int offset = 0;
+    int printed = 0;
+
+    while(1) {
+        if(log->skip > 0) {
+            unsigned int size = log->length - offset < log->skip ? log->length - offset : log->skip;
+            offset += size;
+            log->skip -= size;
+            if(log->skip > 0) {
+                break;
+            }
+        }
+
+        if(log->length - offset < 8) {
+            break;
+        }
+
+        int ln = (int)get_int(log->data + offset);
+        unsigned int size = get_int(log->data + offset + 4);
+        unsigned int keep = size > LOG_MAX_RECORD ? LOG_MAX_RECORD : size;
+        if(log->length - offset - 8 < keep) {
+            break;
+        }
+
+        print_log(log->data + offset + 8, keep, ln, robot);
+        printed++;
+        offset += 8 + keep;
+        log->skip = size - keep;
+    }
+
+    memmove(log->data, log->data + offset, log->length - offset);
+    log->length -= offset;
+    return printed;
+}
+
+// passes on everything the sketch printed so far, robot as in print_command().
+// returns how many prints that was.
+int drain_log(struct log *log, int robot) {
+    int printed = 0;
+
+    if(log == NULL) {
+        return 0;
+    }
+
+    while(1) {
+        // a record is only printed whole, so the buffer grows to fit the longest
+        if(log->length == log->capacity && log->capacity < LOG_MAX_RECORD + 8) {
+            log->capacity *= 2;
+            log->data = (char *)realloc(log->data, log->capacity);
+        }
+
+        int size = read(log->fd, log->data + log->length, log->capacity - log->length);
+        if(size <= 0) {
+            break;
+        }
+
+        log->length += size;
+        printed += print_records(log, robot);
+    }
+
+    METRIC_ADD(messages[2], printed);
+    return printed;
+}
+
+void close_log(struct log *log) {
+    if(log == NULL) {
+        return;
+    }
+
+    close(log->fd);
+    free(log->data);
+    free(log);
+}
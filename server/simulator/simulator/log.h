@@ -0,0 +1,27 @@
+#ifndef LOG_H
+#define LOG_H
+
+// must match dependencies/Transport.h
+#define LOG_ENV "VS_LOG_FD"
+#define LOG_FD 3
+// longest print we pass on, the rest of a longer one is dropped
+#define LOG_MAX_RECORD (1 << 20)
+#define LOG_INITIAL_CAPACITY 4096
+
+// the sketch's prints come down a pipe of their own as records of a 4 byte line
+// number, a 4 byte length and the text, without waiting for an ack. this is the
+// read end and whatever part of a record has not arrived yet.
+struct log {
+    int fd;
+    char *data;
+    unsigned int length;
+    unsigned int capacity;
+    // bytes of an overlong print still to be thrown away
+    unsigned int skip;
+};
+
+struct log* open_log(int *write_fd);
+int drain_log(struct log *log, int robot);
+void close_log(struct log *log);
+
+#endif
@@ -0,0 +1,185 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "metrics.h"
+
+static struct metrics local;
+struct metrics *metrics = &local;
+// where this run's own phase times go as they are observed, -1 for nowhere
+static int phases_fd = -1;
+
+static const double buckets[NUM_BUCKETS] = {0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10, 30};
+static const char *phase_names[NUM_PHASES] = {"compile", "start", "simulate", "total"};
+static const char *ending_names[NUM_ENDINGS] = {"frames", "arrived", "exited", "idle"};
+static const char *opcode_names[NUM_OPCODES] = {"begin", "update_location", "print", "set_left_motor_pwm",
+    "set_right_motor_pwm", "turn_off_motors", "read_distance_sensor", "delay", "checkpoint"};
+
+// maps the shared counters in, a file of the wrong size or version starts over
+void open_metrics() {
+    // a load harness timing us, nothing we start gets the fd
+    char *phases = getenv(PHASES_ENV);
+    if(phases != NULL) {
+        phases_fd = atoi(phases);
+        fcntl(phases_fd, F_SETFD, FD_CLOEXEC);
+    }
+
+    int fd = open(METRICS_FILE, O_RDWR | O_CREAT, 0666);
+    if(fd < 0) {
+        return;
+    }
+
+    off_t size = lseek(fd, 0, SEEK_END);
+    if(size != sizeof(struct metrics) && ftruncate(fd, sizeof(struct metrics)) != 0) {
+        close(fd);
+        return;
+    }
+
+    void *shared = mmap(NULL, sizeof(struct metrics), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(shared == MAP_FAILED) {
+        return;
+    }
+
+    metrics = (struct metrics *)shared;
+    if(size != sizeof(struct metrics) || metrics->version != METRICS_VERSION) {
+        memset(metrics, 0, sizeof(struct metrics));
+        metrics->version = METRICS_VERSION;
+    }
+}
+
+unsigned long metrics_usec() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1000000UL + t.tv_nsec / 1000;
+}
+
+// records how long a phase took that started at start_usec
+void observe(enum phase phase, unsigned long start_usec) {
+    observe_usec(phase, metrics_usec() - start_usec);
+}
+
+// records a phase that did not run in one piece by what it took in total
+void observe_usec(enum phase phase, unsigned long usec) {
+    struct histogram *h = &metrics->phases[phase];
+    int i = 0;
+
+    while(i < NUM_BUCKETS && usec > buckets[i] * 1000000) {
+        i++;
+    }
+
+    __atomic_add_fetch(&h->counts[i], 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&h->count, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&h->sum_usec, usec, __ATOMIC_RELAXED);
+
+    if(phases_fd >= 0) {
+        dprintf(phases_fd, "%s %lu\n", phase_names[phase], usec);
+    }
+}
+
+// counts a finished run under the reason print_end() gave for it
+void count_ending(const char *reason) {
+    int i;
+
+    for(i = 0; i < NUM_ENDINGS; i++) {
+        if(!strcmp(reason, ending_names[i])) {
+            METRIC_ADD(endings[i], 1);
+        }
+    }
+}
+
+// queue depth lives in the scheduler, 0 if there is none to ask
+int scheduler_status(int *slots, int *running, int *queued) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, METRICS_SCHEDULER_SOCKET, sizeof(addr.sun_path) - 1);
+
+    int conn = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(conn < 0) {
+        return 0;
+    }
+
+    char line[96];
+    size_t size = 0;
+    if(connect(conn, (struct sockaddr *)&addr, sizeof(addr)) == 0 && write(conn, "status\n", 7) == 7) {
+        ssize_t n;
+        while(size < sizeof(line) - 1 && (n = read(conn, line + size, sizeof(line) - 1 - size)) > 0) {
+            size += n;
+        }
+    }
+    close(conn);
+    line[size] = '\0';
+
+    return sscanf(line, "status %d %d %d", slots, running, queued) == 3;
+}
+
+// the counters in the prometheus text format
+void print_metrics(FILE *out) {
+    int i, j;
+
+    fprintf(out, "# HELP vs_simulations_total Simulations started.\n# TYPE vs_simulations_total counter\n");
+    fprintf(out, "vs_simulations_total %lu\n", metrics->simulations);
+    fprintf(out, "# HELP vs_simulations_active Simulations running right now.\n# TYPE vs_simulations_active gauge\n");
+    fprintf(out, "vs_simulations_active %ld\n", metrics->active);
+
+    fprintf(out, "# HELP vs_compiles_total Sketches compiled, by result.\n# TYPE vs_compiles_total counter\n");
+    fprintf(out, "vs_compiles_total{result=\"ok\"} %lu\n", metrics->compiles - metrics->compile_failures);
+    fprintf(out, "vs_compiles_total{result=\"error\"} %lu\n", metrics->compile_failures);
+    fprintf(out, "# HELP vs_build_cache_hits_total Sketches that reused a finished build.\n# TYPE vs_build_cache_hits_total counter\n");
+    fprintf(out, "vs_build_cache_hits_total %lu\n", metrics->cache_hits);
+
+    fprintf(out, "# HELP vs_frames_total Frames simulated.\n# TYPE vs_frames_total counter\n");
+    fprintf(out, "vs_frames_total %lu\n", metrics->frames);
+
+    fprintf(out, "# HELP vs_messages_total Library calls handled, by opcode.\n# TYPE vs_messages_total counter\n");
+    for(i = 0; i < NUM_OPCODES; i++) {
+        fprintf(out, "vs_messages_total{opcode=\"%s\"} %lu\n", opcode_names[i], metrics->messages[i]);
+    }
+
+    fprintf(out, "# HELP vs_errors_total Runs that failed, by error code.\n# TYPE vs_errors_total counter\n");
+    for(i = 1; i <= MAX_ERROR_CODE; i++) {
+        fprintf(out, "vs_errors_total{code=\"%d\"} %lu\n", i, metrics->errors[i]);
+    }
+
+    fprintf(out, "# HELP vs_endings_total Runs that finished, by why they stopped.\n# TYPE vs_endings_total counter\n");
+    for(i = 0; i < NUM_ENDINGS; i++) {
+        fprintf(out, "vs_endings_total{reason=\"%s\"} %lu\n", ending_names[i], metrics->endings[i]);
+    }
+
+    fprintf(out, "# HELP vs_child_crashes_total Sketches killed by a signal.\n# TYPE vs_child_crashes_total counter\n");
+    fprintf(out, "vs_child_crashes_total %lu\n", metrics->crashes);
+    fprintf(out, "# HELP vs_result_cache_hits_total Runs played back from a stored result.\n# TYPE vs_result_cache_hits_total counter\n");
+    fprintf(out, "vs_result_cache_hits_total %lu\n", metrics->result_hits);
+
+    fprintf(out, "# HELP vs_phase_seconds Time spent in each phase of a run.\n# TYPE vs_phase_seconds histogram\n");
+    for(i = 0; i < NUM_PHASES; i++) {
+        struct histogram *h = &metrics->phases[i];
+        unsigned long cumulative = 0;
+
+        for(j = 0; j < NUM_BUCKETS; j++) {
+            cumulative += h->counts[j];
+            fprintf(out, "vs_phase_seconds_bucket{phase=\"%s\",le=\"%g\"} %lu\n", phase_names[i], buckets[j], cumulative);
+        }
+
+        fprintf(out, "vs_phase_seconds_bucket{phase=\"%s\",le=\"+Inf\"} %lu\n", phase_names[i], h->count);
+        fprintf(out, "vs_phase_seconds_sum{phase=\"%s\"} %.6f\n", phase_names[i], h->sum_usec / 1000000.0);
+        fprintf(out, "vs_phase_seconds_count{phase=\"%s\"} %lu\n", phase_names[i], h->count);
+    }
+
+    int slots, running, queued;
+    if(scheduler_status(&slots, &running, &queued)) {
+        fprintf(out, "# HELP vs_scheduler_slots Runs the scheduler allows at once.\n# TYPE vs_scheduler_slots gauge\n");
+        fprintf(out, "vs_scheduler_slots %d\n", slots);
+        fprintf(out, "# HELP vs_scheduler_running Runs holding a scheduler slot.\n# TYPE vs_scheduler_running gauge\n");
+        fprintf(out, "vs_scheduler_running %d\n", running);
+        fprintf(out, "# HELP vs_scheduler_queued Runs waiting for a scheduler slot.\n# TYPE vs_scheduler_queued gauge\n");
+        fprintf(out, "vs_scheduler_queued %d\n", queued);
+    }
+}
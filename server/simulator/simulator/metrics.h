@@ -0,0 +1,70 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdio.h>
+
+// every simulate process adds to the same counters, kept in a shared file
+#define METRICS_FILE "../metrics"
+#define METRICS_VERSION 2
+// where the scheduler listens, seen from here, see scheduler/scheduler.h
+#define METRICS_SCHEDULER_SOCKET "../../scheduler.sock"
+// an fd number in here gets a "<phase> <usec>" line for every phase of the run,
+// see loadgen/loadgen.c
+#define PHASES_ENV "VS_PHASES_FD"
+#define NUM_OPCODES 9
+#define MAX_ERROR_CODE 15
+#define NUM_BUCKETS 12
+
+enum phase {
+    PHASE_COMPILE,
+    PHASE_START,
+    PHASE_SIMULATE,
+    PHASE_TOTAL,
+    NUM_PHASES
+};
+
+enum ending {
+    ENDING_FRAMES,
+    ENDING_ARRIVED,
+    ENDING_EXITED,
+    ENDING_IDLE,
+    NUM_ENDINGS
+};
+
+// counts[i] is how many took at most the i-th bucket's seconds, the last one
+// is everything slower
+struct histogram {
+    unsigned long counts[NUM_BUCKETS + 1];
+    unsigned long count;
+    unsigned long sum_usec;
+};
+
+struct metrics {
+    unsigned int version;
+    unsigned long simulations;
+    long active;
+    unsigned long compiles;
+    unsigned long compile_failures;
+    unsigned long cache_hits;
+    unsigned long frames;
+    unsigned long messages[NUM_OPCODES];
+    unsigned long errors[MAX_ERROR_CODE + 1];
+    unsigned long endings[NUM_ENDINGS];
+    unsigned long crashes;
+    unsigned long result_hits;
+    struct histogram phases[NUM_PHASES];
+};
+
+// never NULL, without the shared file the counters are only our own
+extern struct metrics *metrics;
+
+#define METRIC_ADD(field, n) __atomic_add_fetch(&metrics->field, (n), __ATOMIC_RELAXED)
+
+void open_metrics();
+unsigned long metrics_usec();
+void observe(enum phase phase, unsigned long start_usec);
+void observe_usec(enum phase phase, unsigned long usec);
+void count_ending(const char *reason);
+void print_metrics(FILE *out);
+
+#endif
@@ -0,0 +1,116 @@
+#include <string.h>
+#include <unistd.h>
+
+#include "output.h"
+#include "format.h"
+
+static char stdout_buffer[OUTPUT_BUFFER];
+
+struct output out = { STDOUT_FILENO, -1, 0, stdout_buffer, 0, OUTPUT_BUFFER };
+
+static int write_all(int fd, const char *data, int length) {
+    while(length > 0) {
+        int size = write(fd, data, length);
+        if(size <= 0) {
+            return -1;
+        }
+
+        data += size;
+        length -= size;
+    }
+
+    return 0;
+}
+
+static void out_write(struct output *o, const char *data, int length) {
+    // nobody is left to tell when the front end hung up on us
+    write_all(o->fd, data, length);
+
+    if(o->tee >= 0 && !o->tee_failed && write_all(o->tee, data, length) != 0) {
+        o->tee_failed = 1;
+    }
+}
+
+void out_flush(struct output *o) {
+    if(o->length > 0) {
+        out_write(o, o->data, o->length);
+        o->length = 0;
+    }
+}
+
+void out_bytes(struct output *o, const char *data, int length) {
+    if(o->length + length > o->capacity) {
+        out_flush(o);
+
+        // too big to be worth copying
+        if(length > o->capacity) {
+            out_write(o, data, length);
+            return;
+        }
+    }
+
+    memcpy(o->data + o->length, data, length);
+    o->length += length;
+}
+
+void out_raw(struct output *o, const char *str) {
+    out_bytes(o, str, strlen(str));
+}
+
+// quoted and escaped the way cjson does it, runs without anything to escape
+// are copied in one go
+void out_string(struct output *o, const char *str, int length) {
+    static const char hex[] = "0123456789abcdef";
+    int i, run = 0;
+
+    out_bytes(o, "\"", 1);
+    for(i = 0; i < length; i++) {
+        unsigned char c = str[i];
+        if(c >= 0x20 && c != '"' && c != '\\') {
+            continue;
+        }
+
+        out_bytes(o, str + run, i - run);
+        run = i + 1;
+        switch(c) {
+            case '"': out_bytes(o, "\\\"", 2); break;
+            case '\\': out_bytes(o, "\\\\", 2); break;
+            case '\b': out_bytes(o, "\\b", 2); break;
+            case '\f': out_bytes(o, "\\f", 2); break;
+            case '\n': out_bytes(o, "\\n", 2); break;
+            case '\r': out_bytes(o, "\\r", 2); break;
+            case '\t': out_bytes(o, "\\t", 2); break;
+            default: {
+                char escape[6] = { '\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xf] };
+                out_bytes(o, escape, 6);
+            }
+        }
+    }
+    out_bytes(o, str + run, length - run);
+    out_bytes(o, "\"", 1);
+}
+
+void out_int(struct output *o, long value) {
+    char text[INT_LENGTH];
+    out_bytes(o, text, format_int(value, text));
+}
+
+void out_float(struct output *o, float value) {
+    char text[FLOAT_LENGTH];
+    out_bytes(o, text, format_float(value, text));
+}
+
+// from here on fd gets a copy of everything o writes
+void out_tee(struct output *o, int fd) {
+    out_flush(o);
+    o->tee = fd;
+    o->tee_failed = 0;
+}
+
+// stops the copy, 0 if some of it could not be written
+int out_untee(struct output *o) {
+    out_flush(o);
+    int ok = o->tee >= 0 && !o->tee_failed;
+    o->tee = -1;
+    return ok;
+}
@@ -0,0 +1,31 @@
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+// records are built straight into this much buffer and go out with one write()
+// each time it fills up, so a run makes a handful of writes instead of a
+// printf per record
+#define OUTPUT_BUFFER (1 << 16)
+
+struct output {
+    int fd;
+    // a second file that gets a copy of everything, -1 for none
+    int tee;
+    int tee_failed;
+    char *data;
+    int length;
+    int capacity;
+};
+
+// the simulation's stdout, everything the front end gets goes through it
+extern struct output out;
+
+void out_flush(struct output *o);
+void out_bytes(struct output *o, const char *data, int length);
+void out_raw(struct output *o, const char *str);
+void out_string(struct output *o, const char *str, int length);
+void out_int(struct output *o, long value);
+void out_float(struct output *o, float value);
+void out_tee(struct output *o, int fd);
+int out_untee(struct output *o);
+
+#endif
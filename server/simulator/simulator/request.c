@@ -0,0 +1,659 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+
+#include "request.h"
+#include "simulator.h"
+#include "error.h"
+#include "end.h"
+#include "arena.h"
+
+// the request is read in one pass straight off the input buffer. every field is
+// looked up by name wherever it appears, whatever we do not know is skipped,
+// and strings (the code above all) are unescaped where they lie instead of
+// being copied into a tree first.
+
+struct parser {
+    char *at;
+    int depth;
+};
+
+static void broken() {
+    error("Unable to parse JSON.", 1);
+}
+
+// a field that is there but holds the wrong kind of value
+static void invalid(char *key) {
+    char message[96];
+    snprintf(message, sizeof(message), "Invalid %s.", key);
+    error(message, 1);
+}
+
+static char peek(struct parser *p) {
+    while(*p->at == ' ' || *p->at == '\t' || *p->at == '\n' || *p->at == '\r') {
+        p->at++;
+    }
+
+    return *p->at;
+}
+
+static void expect(struct parser *p, char c) {
+    if(peek(p) != c) {
+        broken();
+    }
+
+    p->at++;
+}
+
+static int hex_digit(char c) {
+    if(c >= '0' && c <= '9') {
+        return c - '0';
+    } else if(c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    } else if(c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+
+    broken();
+    return 0;
+}
+
+static unsigned int hex4(char *at) {
+    int i;
+    unsigned int value = 0;
+
+    for(i = 0; i < 4; i++) {
+        value = value << 4 | hex_digit(at[i]);
+    }
+
+    return value;
+}
+
+// utf-8 is never longer than the escape it came from, so it fits where that was
+static char* put_utf8(char *out, unsigned int c) {
+    if(c < 0x80) {
+        *out++ = c;
+    } else if(c < 0x800) {
+        *out++ = 0xc0 | (c >> 6);
+        *out++ = 0x80 | (c & 0x3f);
+    } else if(c < 0x10000) {
+        *out++ = 0xe0 | (c >> 12);
+        *out++ = 0x80 | ((c >> 6) & 0x3f);
+        *out++ = 0x80 | (c & 0x3f);
+    } else {
+        *out++ = 0xf0 | (c >> 18);
+        *out++ = 0x80 | ((c >> 12) & 0x3f);
+        *out++ = 0x80 | ((c >> 6) & 0x3f);
+        *out++ = 0x80 | (c & 0x3f);
+    }
+
+    return out;
+}
+
+// unescapes the string in place and terminates it where its closing quote was
+static char* parse_string(struct parser *p) {
+    expect(p, '"');
+
+    char *start = p->at;
+    char *in = p->at;
+    char *out = p->at;
+
+    while(*in != '"') {
+        if(*in == '\0') {
+            broken();
+        }
+
+        if(*in != '\\') {
+            *out++ = *in++;
+            continue;
+        }
+
+        in++;
+        switch(*in++) {
+            case '"': *out++ = '"'; break;
+            case '\\': *out++ = '\\'; break;
+            case '/': *out++ = '/'; break;
+            case 'b': *out++ = '\b'; break;
+            case 'f': *out++ = '\f'; break;
+            case 'n': *out++ = '\n'; break;
+            case 'r': *out++ = '\r'; break;
+            case 't': *out++ = '\t'; break;
+            case 'u': {
+                unsigned int c = hex4(in);
+                in += 4;
+
+                // characters past the first plane come as a surrogate pair
+                if(c >= 0xd800 && c < 0xdc00 && in[0] == '\\' && in[1] == 'u') {
+                    unsigned int low = hex4(in + 2);
+                    if(low >= 0xdc00 && low < 0xe000) {
+                        c = 0x10000 + ((c - 0xd800) << 10) + (low - 0xdc00);
+                        in += 6;
+                    }
+                }
+
+                out = put_utf8(out, c);
+                break;
+            }
+            default:
+                broken();
+        }
+    }
+
+    p->at = in + 1;
+    *out = '\0';
+    return start;
+}
+
+static int is_number(char c) {
+    return c == '-' || (c >= '0' && c <= '9');
+}
+
+static double parse_number(struct parser *p, char *key) {
+    if(!is_number(peek(p))) {
+        invalid(key);
+    }
+
+    char *end;
+    double value = strtod(p->at, &end);
+    p->at = end;
+    return value;
+}
+
+static int parse_literal(struct parser *p, char *literal) {
+    int length = strlen(literal);
+
+    if(strncmp(p->at, literal, length) != 0) {
+        broken();
+    }
+
+    p->at += length;
+    return 1;
+}
+
+static void enter(struct parser *p, char c) {
+    expect(p, c);
+
+    if(++p->depth > MAX_DEPTH) {
+        broken();
+    }
+}
+
+// steps to the next member of an object, 0 once it is closed. count keeps
+// track of how many came before so the commas between them can be checked.
+static int next_member(struct parser *p, int *count, char **key) {
+    if(peek(p) == '}') {
+        p->at++;
+        p->depth--;
+        return 0;
+    }
+
+    if((*count)++ > 0) {
+        expect(p, ',');
+    }
+
+    *key = parse_string(p);
+    expect(p, ':');
+    return 1;
+}
+
+static int next_element(struct parser *p, int *count) {
+    if(peek(p) == ']') {
+        p->at++;
+        p->depth--;
+        return 0;
+    }
+
+    if((*count)++ > 0) {
+        expect(p, ',');
+    }
+
+    return 1;
+}
+
+static void skip_value(struct parser *p) {
+    int count = 0;
+    char *key;
+
+    switch(peek(p)) {
+        case '"':
+            parse_string(p);
+            break;
+        case '{':
+            enter(p, '{');
+            while(next_member(p, &count, &key)) {
+                skip_value(p);
+            }
+            break;
+        case '[':
+            enter(p, '[');
+            while(next_element(p, &count)) {
+                skip_value(p);
+            }
+            break;
+        case 't':
+            parse_literal(p, "true");
+            break;
+        case 'f':
+            parse_literal(p, "false");
+            break;
+        case 'n':
+            parse_literal(p, "null");
+            break;
+        default:
+            parse_number(p, "number");
+    }
+}
+
+// only true turns a flag on, anything else leaves it off
+static int parse_flag(struct parser *p) {
+    if(peek(p) == 't') {
+        return parse_literal(p, "true");
+    }
+
+    skip_value(p);
+    return 0;
+}
+
+static char* get_string(struct parser *p, char *message, int code) {
+    if(peek(p) != '"') {
+        error(message, code);
+    }
+
+    return parse_string(p);
+}
+
+// the mask of the sensors listed in a distance_sensors array
+static unsigned short parse_sensors(struct parser *p) {
+    unsigned short sensors = 0;
+    int count = 0;
+
+    if(peek(p) != '[') {
+        invalid("distance_sensors");
+    }
+
+    enter(p, '[');
+    while(next_element(p, &count)) {
+        int index = (int)parse_number(p, "distance_sensors");
+        if(index >= 0 && index < NUM_SENSORS) {
+            sensors |= 1 << index;
+        }
+    }
+
+    return sensors;
+}
+
+// an osv's start and size, the size is optional
+static void parse_osv(struct parser *p, struct osv *osv, int *located) {
+    int count = 0, seen = 0;
+    char *key;
+
+    if(peek(p) != '{') {
+        invalid("osv");
+    }
+
+    enter(p, '{');
+    while(next_member(p, &count, &key)) {
+        if(!strcmp(key, "x")) {
+            osv->location.x = (float)parse_number(p, "osv");
+            seen |= 1;
+        } else if(!strcmp(key, "y")) {
+            osv->location.y = (float)parse_number(p, "osv");
+            seen |= 2;
+        } else if(!strcmp(key, "theta")) {
+            osv->location.theta = (float)parse_number(p, "osv");
+            seen |= 4;
+        } else if(!strcmp(key, "height")) {
+            osv->height = (float)parse_number(p, "osv");
+        } else if(!strcmp(key, "width")) {
+            osv->width = (float)parse_number(p, "osv");
+        } else {
+            skip_value(p);
+        }
+    }
+
+    *located = seen == 7;
+}
+
+static void parse_obstacles(struct parser *p, struct request *request) {
+    int count = 0, capacity = 4;
+
+    if(peek(p) != '[') {
+        invalid("obstacles");
+    }
+
+    free(request->obstacles);
+    request->obstacles = (struct obstacle *)malloc(capacity * sizeof(struct obstacle));
+    request->num_obstacles = 0;
+
+    enter(p, '[');
+    while(next_element(p, &count)) {
+        int member = 0, seen = 0;
+        char *key;
+
+        if(request->num_obstacles == capacity) {
+            capacity *= 2;
+            request->obstacles = (struct obstacle *)realloc(request->obstacles, capacity * sizeof(struct obstacle));
+        }
+
+        struct obstacle *obstacle = &request->obstacles[request->num_obstacles++];
+        obstacle->location.theta = 0;
+
+        if(peek(p) != '{') {
+            invalid("obstacles");
+        }
+
+        enter(p, '{');
+        while(next_member(p, &member, &key)) {
+            if(!strcmp(key, "x")) {
+                obstacle->location.x = (float)parse_number(p, "obstacles");
+                seen |= 1;
+            } else if(!strcmp(key, "y")) {
+                obstacle->location.y = (float)parse_number(p, "obstacles");
+                seen |= 2;
+            } else if(!strcmp(key, "width")) {
+                obstacle->width = (float)parse_number(p, "obstacles");
+                seen |= 4;
+            } else if(!strcmp(key, "height")) {
+                obstacle->height = (float)parse_number(p, "obstacles");
+                seen |= 8;
+            } else {
+                skip_value(p);
+            }
+        }
+
+        if(seen != 15) {
+            error("Unable to get obstacles.", 6);
+        }
+    }
+}
+
+static void parse_destination(struct parser *p, struct request *request) {
+    int count = 0, seen = 0;
+    char *key;
+
+    if(peek(p) != '{') {
+        invalid("destination");
+    }
+
+    enter(p, '{');
+    while(next_member(p, &count, &key)) {
+        if(!strcmp(key, "x")) {
+            request->destination.x = (float)parse_number(p, "destination");
+            seen |= 1;
+        } else if(!strcmp(key, "y")) {
+            request->destination.y = (float)parse_number(p, "destination");
+            seen |= 2;
+        } else {
+            skip_value(p);
+        }
+    }
+
+    request->destination.theta = 0;
+    request->has_destination = seen == 3;
+}
+
+static void parse_randomization(struct parser *p, struct request *request) {
+    int count = 0;
+    char *key;
+
+    if(peek(p) != '{') {
+        error("Unable to get randomization.", 6);
+    }
+
+    enter(p, '{');
+    while(next_member(p, &count, &key)) {
+        if(!strcmp(key, "seed")) {
+            double seed = parse_number(p, "seed");
+            if(!(seed >= 0 && seed <= UINT_MAX)) {
+                error("Unable to get randomization.", 6);
+            }
+            request->seed = (unsigned int)seed;
+            request->has_seed = 1;
+        } else if(!strcmp(key, "osv")) {
+            parse_osv(p, &request->osvs[0], &request->located[0]);
+        } else if(!strcmp(key, "obstacles")) {
+            parse_obstacles(p, request);
+        } else if(!strcmp(key, "destination")) {
+            parse_destination(p, request);
+        } else {
+            skip_value(p);
+        }
+    }
+
+    request->has_randomization = 1;
+}
+
+// the osvs after the first, each with its own code, start and sensors
+static void parse_robots(struct parser *p, struct request *request) {
+    int count = 0;
+
+    if(peek(p) != '[') {
+        invalid("robots");
+    }
+
+    request->num_robots = 1;
+    enter(p, '[');
+    while(next_element(p, &count)) {
+        int member = 0;
+        char *key;
+
+        if(request->num_robots == MAX_ROBOTS) {
+            error("Too many robots.", 13);
+        }
+
+        int i = request->num_robots++;
+        if(peek(p) != '{') {
+            error("Unable to get robot.", 13);
+        }
+
+        enter(p, '{');
+        while(next_member(p, &member, &key)) {
+            if(!strcmp(key, "code")) {
+                request->code[i] = get_string(p, "Unable to get code.", 7);
+            } else if(!strcmp(key, "osv")) {
+                parse_osv(p, &request->osvs[i], &request->located[i]);
+            } else if(!strcmp(key, "distance_sensors")) {
+                request->osvs[i].sensors = parse_sensors(p);
+            } else {
+                skip_value(p);
+            }
+        }
+    }
+
+    options.num_robots = request->num_robots;
+}
+
+static int compare_frames(const void *a, const void *b) {
+    return *(const int *)a - *(const int *)b;
+}
+
+static void parse_checkpoints(struct parser *p) {
+    int count = 0, capacity = 4;
+
+    if(peek(p) != '[') {
+        invalid("checkpoints");
+    }
+
+    free(options.checkpoints);
+    options.checkpoints = (int *)malloc(capacity * sizeof(int));
+    options.num_checkpoints = 0;
+
+    enter(p, '[');
+    while(next_element(p, &count)) {
+        if(options.num_checkpoints == capacity) {
+            capacity *= 2;
+            options.checkpoints = (int *)realloc(options.checkpoints, capacity * sizeof(int));
+        }
+
+        options.checkpoints[options.num_checkpoints++] = (int)parse_number(p, "checkpoints");
+    }
+
+    qsort(options.checkpoints, options.num_checkpoints, sizeof(int), compare_frames);
+}
+
+static void parse_resume(struct parser *p) {
+    int count = 0;
+    char *key;
+
+    if(peek(p) != '{') {
+        error("Unable to get resume id.", 10);
+    }
+
+    enter(p, '{');
+    while(next_member(p, &count, &key)) {
+        if(!strcmp(key, "id")) {
+            options.resume_id = get_string(p, "Unable to get resume id.", 10);
+        } else if(!strcmp(key, "frame")) {
+            options.resume_frame = (int)parse_number(p, "resume frame");
+        } else {
+            skip_value(p);
+        }
+    }
+
+    if(options.resume_id == NULL) {
+        error("Unable to get resume id.", 10);
+    }
+}
+
+static void default_request(struct request *request) {
+    int i;
+
+    memset(request, 0, sizeof(struct request));
+    request->num_robots = 1;
+    request->num_obstacles = -1;
+    for(i = 0; i < MAX_ROBOTS; i++) {
+        request->osvs[i].width = OSV_WIDTH;
+        request->osvs[i].height = OSV_WIDTH;
+    }
+
+    // optional fields, missing ones keep their defaults
+    options.checkpoints = NULL;
+    options.num_checkpoints = 0;
+    options.resume_id = NULL;
+    options.resume_frame = 0;
+    options.command_budget = COMMAND_BUDGET;
+    options.seeded = 0;
+    options.seed = 0;
+    options.distance_field = 0;
+    options.in_process = 0;
+    options.num_robots = 1;
+    options.arrival_radius = ARRIVAL_RADIUS;
+    options.in_memory = 0;
+    options.deterministic = 0;
+    options.cache = 1;
+    options.output_hz = FE_FPS;
+}
+
+// fills request and options from the json in input, which it unescapes the
+// strings of in place. anything missing that a run cannot do without is an error.
+void parse_request(char *input, struct request *request) {
+    struct parser parser = {input, 0};
+    struct parser *p = &parser;
+    int count = 0;
+    char *key;
+
+    // the output rate is what the front end plays back, physics steps that many
+    // times over per output frame
+    float physics_hz = 0;
+    float duration = NUM_FRAMES / (float)FE_FPS;
+    float idle_sec = 0;
+    int has_idle = 0;
+
+    default_request(request);
+
+    enter(p, '{');
+    while(next_member(p, &count, &key)) {
+        if(!strcmp(key, "id")) {
+            request->id = get_string(p, "Unable to get id.", 8);
+        } else if(!strcmp(key, "code")) {
+            request->code[0] = get_string(p, "Unable to get code.", 7);
+        } else if(!strcmp(key, "randomization")) {
+            parse_randomization(p, request);
+        } else if(!strcmp(key, "distance_sensors")) {
+            request->osvs[0].sensors = parse_sensors(p);
+        } else if(!strcmp(key, "robots")) {
+            parse_robots(p, request);
+        } else if(!strcmp(key, "checkpoints")) {
+            parse_checkpoints(p);
+        } else if(!strcmp(key, "resume")) {
+            parse_resume(p);
+        } else if(!strcmp(key, "command_budget")) {
+            options.command_budget = (int)parse_number(p, key);
+        } else if(!strcmp(key, "distance_field")) {
+            options.distance_field = parse_flag(p);
+        } else if(!strcmp(key, "in_process")) {
+            options.in_process = parse_flag(p);
+        } else if(!strcmp(key, "in_memory")) {
+            options.in_memory = parse_flag(p);
+        } else if(!strcmp(key, "deterministic")) {
+            options.deterministic = parse_flag(p);
+        } else if(!strcmp(key, "cache")) {
+            options.cache = parse_flag(p);
+        } else if(!strcmp(key, "physics_hz")) {
+            physics_hz = (float)parse_number(p, key);
+        } else if(!strcmp(key, "output_hz")) {
+            options.output_hz = (float)parse_number(p, key);
+        } else if(!strcmp(key, "duration")) {
+            duration = (float)parse_number(p, key);
+        } else if(!strcmp(key, "arrival_radius")) {
+            options.arrival_radius = (float)parse_number(p, key);
+        } else if(!strcmp(key, "idle_sec")) {
+            idle_sec = (float)parse_number(p, key);
+            has_idle = 1;
+        } else {
+            skip_value(p);
+        }
+    }
+
+    if(peek(p) != '\0') {
+        broken();
+    }
+
+    if(request->id == NULL) {
+        error("Unable to get id.", 8);
+    }
+
+    if(options.output_hz <= 0 || physics_hz < 0 || duration <= 0) {
+        error("Invalid timestep.", 11);
+    }
+
+    // checked before the casts, which overflow past int. written so nan fails too.
+    if(!(physics_hz / options.output_hz <= MAX_SUBSTEPS) || !(duration * options.output_hz <= MAX_FRAMES)) {
+        error("Invalid timestep.", 11);
+    }
+
+    options.substeps = physics_hz > options.output_hz ? (int)(physics_hz / options.output_hz + 0.5f) : 1;
+    options.num_frames = (int)(duration * options.output_hz + 0.5f);
+    if(!has_idle && (options.deterministic || options.in_process)) {
+        idle_sec = IDLE_SEC;
+    }
+    // an osv idle for longer than any run can never end it
+    options.idle_frames = idle_sec > 0 && idle_sec * options.output_hz <= MAX_FRAMES ? (int)(idle_sec * options.output_hz + 0.5f) : 0;
+}
+
+// all of stdin in one buffer, doubled as it fills so reading stays linear
+char* read_input() {
+    size_t capacity = 4096, length = 0;
+    char *input = (char *)malloc(capacity);
+
+    while(1) {
+        if(length + 1 >= capacity) {
+            capacity *= 2;
+            input = (char *)realloc(input, capacity);
+        }
+
+        ssize_t size = read(STDIN_FILENO, input + length, capacity - 1 - length);
+        if(size < 0) {
+            error("Unable to read request.", 1);
+        } else if(size == 0) {
+            break;
+        }
+
+        length += size;
+    }
+
+    input[length] = '\0';
+    return input;
+}
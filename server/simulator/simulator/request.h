@@ -0,0 +1,33 @@
+#ifndef REQUEST_H
+#define REQUEST_H
+
+#include "vs.h"
+
+// deepest we follow values nobody asked for before calling the json broken
+#define MAX_DEPTH 64
+
+// everything a request asks for apart from the options, which go straight into
+// options. the strings point into the input, they were unescaped in place there.
+struct request {
+    char *id;
+    // code of every osv, code[0] is the top level one
+    char *code[MAX_ROBOTS];
+    // start and sensors of every osv, located[i] once x, y and theta are known
+    struct osv osvs[MAX_ROBOTS];
+    int located[MAX_ROBOTS];
+    int num_robots;
+
+    int has_randomization;
+    int has_seed;
+    unsigned int seed;
+    // num_obstacles is -1 when the randomization lists none
+    struct obstacle *obstacles;
+    int num_obstacles;
+    int has_destination;
+    struct coordinate destination;
+};
+
+char* read_input(void);
+void parse_request(char *input, struct request *request);
+
+#endif
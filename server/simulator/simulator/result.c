@@ -0,0 +1,212 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "result.h"
+#include "simulator.h"
+#include "coroutine.h"
+#include "hash.h"
+#include "metrics.h"
+#include "output.h"
+
+// a deterministic run is a function of its request and of the programs that
+// played it out, so its whole output is kept and handed back to the next run
+// that asks for the same thing without compiling or simulating anything. the
+// file starts with everything the key was hashed from and is only replayed
+// when that matches, the hash alone is easy to collide on purpose.
+
+static char *result_path = NULL;
+static char *result_tmp = NULL;
+static int result_fd = -1;
+static int result_owner = 0;
+// what the last result_key() hashed
+static char *material = NULL;
+static size_t material_length = 0;
+
+static void path_for(unsigned long long key, char *path) {
+    char hex[HASH_HEX_LENGTH + 1];
+    hash_hex(key, hex);
+    sprintf(path, "%s%s", RESULTS_DIR, hex);
+}
+
+static void add_material(const void *data, size_t size) {
+    material = (char *)realloc(material, material_length + size);
+    memcpy(material + material_length, data, size);
+    material_length += size;
+}
+
+// a rebuilt simulate or client library may play the same request out differently
+static void add_file(const char *path) {
+    struct stat st;
+    long long identity[3] = {0, 0, 0};
+
+    if(stat(path, &st) == 0) {
+        identity[0] = st.st_size;
+        identity[1] = st.st_mtim.tv_sec;
+        identity[2] = st.st_mtim.tv_nsec;
+    }
+
+    add_material(identity, sizeof(identity));
+}
+
+// floats and ints are added one by one, the structs they sit in have padding
+#define ADD_VALUE(value) do { __typeof__(value) v_ = (value); add_material(&v_, sizeof(v_)); } while(0)
+
+unsigned long long result_key(struct request *request) {
+    int i;
+
+    material_length = 0;
+
+    ADD_VALUE(RESULT_VERSION);
+    add_file("/proc/self/exe");
+    add_file(CLIENT_LIBRARY);
+
+    ADD_VALUE(request->num_robots);
+    for(i = 0; i < request->num_robots; i++) {
+        struct osv *osv = &request->osvs[i];
+
+        // the code's terminator keeps "ab" + "c" apart from "a" + "bc"
+        char *code = request->code[i] != NULL ? request->code[i] : "";
+        add_material(code, strlen(code) + 1);
+        ADD_VALUE(request->located[i]);
+        ADD_VALUE(osv->location.x);
+        ADD_VALUE(osv->location.y);
+        ADD_VALUE(osv->location.theta);
+        ADD_VALUE(osv->width);
+        ADD_VALUE(osv->height);
+        ADD_VALUE(osv->sensors);
+    }
+
+    ADD_VALUE(request->has_randomization);
+    ADD_VALUE(request->has_seed);
+    ADD_VALUE(request->seed);
+    ADD_VALUE(request->num_obstacles);
+    for(i = 0; i < request->num_obstacles; i++) {
+        struct obstacle *obstacle = &request->obstacles[i];
+        ADD_VALUE(obstacle->location.x);
+        ADD_VALUE(obstacle->location.y);
+        ADD_VALUE(obstacle->width);
+        ADD_VALUE(obstacle->height);
+    }
+
+    ADD_VALUE(request->has_destination);
+    if(request->has_destination) {
+        ADD_VALUE(request->destination.x);
+        ADD_VALUE(request->destination.y);
+    }
+
+    ADD_VALUE(options.num_frames);
+    ADD_VALUE(options.output_hz);
+    ADD_VALUE(options.substeps);
+    ADD_VALUE(options.command_budget);
+    ADD_VALUE(options.arrival_radius);
+    ADD_VALUE(options.idle_frames);
+    ADD_VALUE(options.distance_field);
+    ADD_VALUE(options.in_process);
+    ADD_VALUE(options.deterministic);
+
+    return hash_bytes(material, material_length, HASH_SEED);
+}
+
+// the material a result file starts with is the one of the last result_key()
+static int same_material(FILE *fp) {
+    size_t length;
+    if(fread(&length, sizeof(length), 1, fp) != 1 || length != material_length) {
+        return 0;
+    }
+
+    char *stored = (char *)malloc(length + 1);
+    int same = fread(stored, 1, length, fp) == length && memcmp(stored, material, length) == 0;
+    free(stored);
+    return same;
+}
+
+// writes the stored output of key to stdout, 0 when there is none or it was
+// stored for something else
+int replay_result(unsigned long long key) {
+    char path[strlen(RESULTS_DIR) + HASH_HEX_LENGTH + 1];
+    path_for(key, path);
+
+    FILE *fp = fopen(path, "r");
+    if(fp == NULL) {
+        return 0;
+    }
+
+    if(!same_material(fp)) {
+        fclose(fp);
+        return 0;
+    }
+
+    char buffer[OUTPUT_BUFFER];
+    size_t size;
+    while((size = fread(buffer, 1, sizeof(buffer), fp)) > 0) {
+        out_bytes(&out, buffer, size);
+    }
+
+    fclose(fp);
+    out_flush(&out);
+    METRIC_ADD(result_hits, 1);
+    return 1;
+}
+
+// a run that errored or crashed out leaves no half result behind
+static void drop_result() {
+    if(result_tmp != NULL && result_owner == getpid()) {
+        unlink(result_tmp);
+    }
+}
+
+// from here on everything the run prints is also written to the result of key
+void record_result(unsigned long long key) {
+    if(mkdir(RESULTS_DIR, 0777) != 0 && access(RESULTS_DIR, F_OK) != 0) {
+        return;
+    }
+
+    result_path = (char *)malloc(strlen(RESULTS_DIR) + HASH_HEX_LENGTH + 1);
+    path_for(key, result_path);
+    result_tmp = (char *)malloc(strlen(result_path) + 16);
+    sprintf(result_tmp, "%s.%d", result_path, getpid());
+
+    result_fd = open(result_tmp, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if(result_fd < 0) {
+        return;
+    }
+
+    if(write(result_fd, &material_length, sizeof(material_length)) != sizeof(material_length)
+        || write(result_fd, material, material_length) != (ssize_t)material_length) {
+        close(result_fd);
+        result_fd = -1;
+        unlink(result_tmp);
+        return;
+    }
+
+    result_owner = getpid();
+    atexit(drop_result);
+    out_tee(&out, result_fd);
+}
+
+// keep is 0 when the run turned out not to be repeatable after all
+void commit_result(int keep) {
+    if(result_tmp == NULL) {
+        return;
+    }
+
+    if(result_fd >= 0) {
+        // a result we could not write whole is not kept at all
+        keep &= out_untee(&out);
+        keep &= close(result_fd) == 0;
+        result_fd = -1;
+        if(keep && rename(result_tmp, result_path) == 0) {
+            free(result_tmp);
+            result_tmp = NULL;
+            return;
+        }
+    }
+
+    unlink(result_tmp);
+    free(result_tmp);
+    result_tmp = NULL;
+}
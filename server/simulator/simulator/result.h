@@ -0,0 +1,16 @@
+#ifndef RESULT_H
+#define RESULT_H
+
+#include "request.h"
+
+// finished runs live here by the hash of everything that went into them
+#define RESULTS_DIR "../results/"
+// bump whenever the output of the same request changes, old results are then ignored
+#define RESULT_VERSION 3
+
+unsigned long long result_key(struct request *request);
+int replay_result(unsigned long long key);
+void record_result(unsigned long long key);
+void commit_result(int keep);
+
+#endif
@@ -0,0 +1,92 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/uio.h>
+
+#include "ring.h"
+
+void ring_init(struct ring *r) {
+    r->head = 0;
+    r->tail = 0;
+}
+
+// reads whatever the fd has (up to the free space) without blocking the caller.
+// returns like read(): bytes added, 0 on end of file, -1 if nothing was available.
+int ring_fill(struct ring *r, int fd) {
+    unsigned int free_space = RING_SIZE - ring_size(r);
+    unsigned int start = r->tail & (RING_SIZE - 1);
+
+    if(free_space == 0) {
+        // the child has to wait for us to catch up
+        return -1;
+    }
+
+    // the free space may wrap around the end of the array
+    struct iovec parts[2];
+    int n_parts = 1;
+    parts[0].iov_base = r->data + start;
+    if(start + free_space <= RING_SIZE) {
+        parts[0].iov_len = free_space;
+    } else {
+        parts[0].iov_len = RING_SIZE - start;
+        parts[1].iov_base = r->data;
+        parts[1].iov_len = free_space - parts[0].iov_len;
+        n_parts = 2;
+    }
+
+    int size = readv(fd, parts, n_parts);
+    if(size > 0) {
+        r->tail += size;
+    }
+
+    return size;
+}
+
+unsigned int ring_size(struct ring *r) {
+    return r->tail - r->head;
+}
+
+unsigned char ring_byte(struct ring *r, unsigned int offset) {
+    return r->data[(r->head + offset) & (RING_SIZE - 1)];
+}
+
+// the client library sends its fields little endian, byte by byte
+int ring_int(struct ring *r, unsigned int offset) {
+    return (int)((unsigned int)ring_byte(r, offset)
+        | ((unsigned int)ring_byte(r, offset + 1) << 8)
+        | ((unsigned int)ring_byte(r, offset + 2) << 16)
+        | ((unsigned int)ring_byte(r, offset + 3) << 24));
+}
+
+short ring_short(struct ring *r, unsigned int offset) {
+    return (short)((unsigned short)ring_byte(r, offset)
+        | ((unsigned short)ring_byte(r, offset + 1) << 8));
+}
+
+void ring_copy(struct ring *r, unsigned int offset, char *dest, unsigned int len) {
+    unsigned int i;
+    for(i = 0; i < len; i++) {
+        dest[i] = ring_byte(r, offset + i);
+    }
+}
+
+void ring_consume(struct ring *r, unsigned int len) {
+    r->head += len;
+}
+
+// appends bytes produced in process, -1 if they do not fit
+int ring_push(struct ring *r, const void *data, unsigned int len) {
+    const unsigned char *bytes = (const unsigned char *)data;
+    unsigned int i;
+
+    if(RING_SIZE - ring_size(r) < len) {
+        return -1;
+    }
+
+    for(i = 0; i < len; i++) {
+        r->data[(r->tail + i) & (RING_SIZE - 1)] = bytes[i];
+    }
+
+    r->tail += len;
+    return 0;
+}
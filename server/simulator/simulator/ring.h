@@ -0,0 +1,25 @@
+#ifndef RING_H
+#define RING_H
+
+// must be a power of two
+#define RING_SIZE 4096
+
+// fixed capacity byte queue between the child's pipe and the message decoder.
+// head and tail only ever grow, masking them gives the position in data.
+struct ring {
+    unsigned char data[RING_SIZE];
+    unsigned int head;
+    unsigned int tail;
+};
+
+void ring_init(struct ring *r);
+int ring_fill(struct ring *r, int fd);
+unsigned int ring_size(struct ring *r);
+unsigned char ring_byte(struct ring *r, unsigned int offset);
+int ring_int(struct ring *r, unsigned int offset);
+short ring_short(struct ring *r, unsigned int offset);
+void ring_copy(struct ring *r, unsigned int offset, char *dest, unsigned int len);
+void ring_consume(struct ring *r, unsigned int len);
+int ring_push(struct ring *r, const void *data, unsigned int len);
+
+#endif
@@ -0,0 +1,259 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "scene.h"
+#include "field.h"
+#include "hash.h"
+
+// the scene file the arena's obstacles, sides, walls and field point into,
+// NULL when this run built them on the heap
+static void *scene_map = NULL;
+static size_t scene_size = 0;
+
+static size_t scene_bytes(struct scene_header *header) {
+    size_t size = sizeof(struct scene_header);
+    size += header->num_obstacles * sizeof(struct obstacle);
+    size += 4 * header->num_obstacles * sizeof(struct line);
+    size += header->num_walls * sizeof(struct line);
+
+    if(header->has_field) {
+        size_t cells = (size_t)header->cols * header->rows;
+        size += cells * sizeof(float) + (cells + 1) * sizeof(int) + header->num_ids * sizeof(int);
+    }
+
+    return size;
+}
+
+// the four walls of the course, right, bottom, left, top
+static void arena_walls(struct line *walls) {
+    float x[4][2] = {{ARENA_WIDTH, ARENA_WIDTH}, {0, ARENA_WIDTH}, {0, 0}, {0, ARENA_WIDTH}};
+    float y[4][2] = {{0, ARENA_HEIGHT}, {0, 0}, {0, ARENA_HEIGHT}, {ARENA_HEIGHT, ARENA_HEIGHT}};
+    int i;
+
+    for(i = 0; i < NUM_WALLS; i++) {
+        walls[i].p1.x = x[i][0];
+        walls[i].p1.y = y[i][0];
+        walls[i].p1.theta = 0;
+        walls[i].p2.x = x[i][1];
+        walls[i].p2.y = y[i][1];
+        walls[i].p2.theta = 0;
+    }
+}
+
+// an obstacle as far as the scene cares, adding 0 turns -0 into 0 so both hash the same
+static void obstacle_shape(struct obstacle *obstacle, float *shape) {
+    shape[0] = obstacle->location.x + 0.0f;
+    shape[1] = obstacle->location.y + 0.0f;
+    shape[2] = obstacle->width + 0.0f;
+    shape[3] = obstacle->height + 0.0f;
+}
+
+// the obstacles are all that differs between two scenes, the seed or the json
+// they came from do not matter, only the numbers they ended up as
+static void scene_path(struct arena *arena, int with_field, char *path) {
+    unsigned long long hash = HASH_SEED;
+    int version = SCENE_VERSION;
+    int i;
+
+    hash = hash_bytes(&version, sizeof(version), hash);
+    hash = hash_bytes(&with_field, sizeof(with_field), hash);
+    for(i = 0; i < arena->num_obstacles; i++) {
+        float shape[4];
+        obstacle_shape(&arena->obstacles[i], shape);
+        hash = hash_bytes(shape, sizeof(shape), hash);
+    }
+
+    char hex[HASH_HEX_LENGTH + 1];
+    hash_hex(hash, hex);
+    sprintf(path, "%s%s", SCENES_DIR, hex);
+}
+
+static int same_obstacles(struct obstacle *a, struct obstacle *b, int count) {
+    int i;
+
+    for(i = 0; i < count; i++) {
+        float shape_a[4], shape_b[4];
+        obstacle_shape(&a[i], shape_a);
+        obstacle_shape(&b[i], shape_b);
+        if(memcmp(shape_a, shape_b, sizeof(shape_a)) != 0) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+// points the arena into the cached scene at path, 0 if there is none we can use
+static int map_scene(char *path, struct arena *arena, int has_field) {
+    int fd = open(path, O_RDONLY);
+    if(fd < 0) {
+        return 0;
+    }
+
+    struct stat st;
+    if(fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(struct scene_header)) {
+        close(fd);
+        return 0;
+    }
+
+    // read only and shared, every run of this arena reads the same pages
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(map == MAP_FAILED) {
+        return 0;
+    }
+
+    struct scene_header *header = (struct scene_header *)map;
+    if(header->magic != SCENE_MAGIC || header->version != SCENE_VERSION
+        || header->has_field != has_field || header->num_obstacles != arena->num_obstacles
+        || header->num_walls != NUM_WALLS || scene_bytes(header) != (size_t)st.st_size) {
+        munmap(map, st.st_size);
+        return 0;
+    }
+
+    char *next = (char *)(header + 1);
+    struct obstacle *obstacles = (struct obstacle *)next;
+    next += header->num_obstacles * sizeof(struct obstacle);
+
+    // a hash collision would hand us somebody else's course
+    if(!same_obstacles(obstacles, arena->obstacles, arena->num_obstacles)) {
+        munmap(map, st.st_size);
+        return 0;
+    }
+
+    free(arena->obstacles);
+    arena->obstacles = obstacles;
+    arena->sides = (struct line *)next;
+    next += 4 * header->num_obstacles * sizeof(struct line);
+    arena->walls = (struct line *)next;
+    arena->num_walls = header->num_walls;
+    next += header->num_walls * sizeof(struct line);
+
+    arena->field = NULL;
+    if(header->has_field) {
+        struct field *field = (struct field *)malloc(sizeof(struct field));
+        long cells = (long)header->cols * header->rows;
+        field->x = header->field_x;
+        field->y = header->field_y;
+        field->cell = header->field_cell;
+        field->cols = header->cols;
+        field->rows = header->rows;
+        field->distance = (float *)next;
+        next += cells * sizeof(float);
+        field->start = (int *)next;
+        next += (cells + 1) * sizeof(int);
+        field->ids = (int *)next;
+        arena->field = field;
+    }
+
+    scene_map = map;
+    scene_size = st.st_size;
+    return 1;
+}
+
+static void build_scene(struct arena *arena, int with_field) {
+    int i;
+
+    arena->sides = (struct line *)malloc((4 * arena->num_obstacles + 1) * sizeof(struct line));
+    arena->walls = (struct line *)malloc(NUM_WALLS * sizeof(struct line));
+    for(i = 0; i < arena->num_obstacles; i++) {
+        obstacle_sides(&arena->obstacles[i], arena->sides + 4 * i);
+    }
+
+    arena_walls(arena->walls);
+    arena->num_walls = NUM_WALLS;
+    arena->field = with_field ? build_field(arena) : NULL;
+}
+
+// writes the scene under a name of our own and renames it into place, so a
+// run reading the cache never sees half a file
+static void save_scene(struct arena *arena, char *path) {
+    if(mkdir(SCENES_DIR, 0777) != 0 && access(SCENES_DIR, F_OK) != 0) {
+        return;
+    }
+
+    struct field *field = arena->field;
+    struct scene_header header;
+    memset(&header, 0, sizeof(header));
+    header.magic = SCENE_MAGIC;
+    header.version = SCENE_VERSION;
+    header.num_obstacles = arena->num_obstacles;
+    header.num_walls = arena->num_walls;
+    header.has_field = field != NULL;
+    if(field != NULL) {
+        header.field_x = field->x;
+        header.field_y = field->y;
+        header.field_cell = field->cell;
+        header.cols = field->cols;
+        header.rows = field->rows;
+        header.num_ids = field->start[(long)field->cols * field->rows];
+    }
+
+    char tmp[strlen(path) + 16];
+    sprintf(tmp, "%s.%d", path, getpid());
+
+    FILE *fp = fopen(tmp, "w");
+    if(fp == NULL) {
+        return;
+    }
+
+    fwrite(&header, sizeof(header), 1, fp);
+    fwrite(arena->obstacles, sizeof(struct obstacle), arena->num_obstacles, fp);
+    fwrite(arena->sides, sizeof(struct line), 4 * arena->num_obstacles, fp);
+    fwrite(arena->walls, sizeof(struct line), arena->num_walls, fp);
+    if(field != NULL) {
+        long cells = (long)field->cols * field->rows;
+        fwrite(field->distance, sizeof(float), cells, fp);
+        fwrite(field->start, sizeof(int), cells + 1, fp);
+        fwrite(field->ids, sizeof(int), header.num_ids, fp);
+    }
+
+    if(ferror(fp) | fclose(fp)) {
+        unlink(tmp);
+        return;
+    }
+
+    if(rename(tmp, path) != 0) {
+        unlink(tmp);
+    }
+}
+
+// everything about the arena that never changes during a run: obstacle sides,
+// walls and the distance field. the first run of an arena builds it and leaves
+// it in the cache, every later one maps the file and has nothing left to do.
+void load_scene(struct arena *arena, int with_field) {
+    char path[strlen(SCENES_DIR) + HASH_HEX_LENGTH + 1];
+    scene_path(arena, with_field, path);
+
+    if(map_scene(path, arena, with_field && arena->num_obstacles > 0)) {
+        return;
+    }
+
+    build_scene(arena, with_field);
+    save_scene(arena, path);
+}
+
+void free_scene(struct arena *arena) {
+    if(scene_map != NULL) {
+        // the arrays are in the mapping, only the field struct is ours
+        free(arena->field);
+        munmap(scene_map, scene_size);
+        scene_map = NULL;
+        arena->obstacles = NULL;
+        arena->num_obstacles = 0;
+    } else {
+        free_field(arena->field);
+        free(arena->sides);
+        free(arena->walls);
+    }
+
+    arena->field = NULL;
+    arena->sides = NULL;
+    arena->walls = NULL;
+    arena->num_walls = 0;
+}
@@ -0,0 +1,30 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include "vs.h"
+
+// compiled arenas live here by the hash of their obstacles, shared by every simulate process
+#define SCENES_DIR "../scenes/"
+#define SCENE_MAGIC 0x53435631
+// bump whenever the layout or anything baked into it changes, old files are then ignored
+#define SCENE_VERSION 1
+
+// a scene file is this header followed by the obstacles, their sides (four per
+// obstacle, right, bottom, left, top), the walls and, when has_field is set, the
+// distance field's distance, start and ids arrays. everything in it is 4 byte
+// aligned so the arrays are used straight out of the mapping.
+struct scene_header {
+    unsigned int magic;
+    int version;
+    int num_obstacles;
+    int num_walls;
+    int has_field;
+    float field_x, field_y, field_cell;
+    int cols, rows;
+    int num_ids;
+};
+
+void load_scene(struct arena *arena, int with_field);
+void free_scene(struct arena *arena);
+
+#endif
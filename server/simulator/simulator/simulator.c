@@ -4,131 +4,141 @@
 #include <time.h>
 #include <fcntl.h>
 #include <sys/prctl.h>
+#include <sys/wait.h>
 #include <signal.h>
 #include <unistd.h>
-#include <cjson/cJSON.h>
 
 #include "compile.h"
+#include "build.h"
 #include "vs.h"
 #include "simulator.h"
-#include "node.h"
+#include "ring.h"
 #include "error.h"
+#include "checkpoint.h"
+#include "scene.h"
+#include "zygote.h"
+#include "coroutine.h"
+#include "arena.h"
+#include "end.h"
+#include "summary.h"
+#include "metrics.h"
+#include "request.h"
+#include "log.h"
+#include "result.h"
+#include "output.h"
+
+struct options options;
+
+// this prints the arena of a seeded request, the front end never saw it otherwise
+void print_arena(struct arena *arena) {
+    int i;
 
-// this function is a debugging function which creates a string of the arduino code
-char* get_input() {
-    char *string = (char*)malloc(1 * sizeof(char));
-    int n_characters = 0;
-    string[n_characters] = '\0';
-
-    char c;
-
-    while((c = getchar()) != EOF) {
-        n_characters++;
-        string = (char*)realloc(string, (n_characters + 1) * sizeof(char));
-        string[n_characters] = '\0';
-        string[n_characters - 1] = c;
+    out_raw(&out, "{\"arena\":{\"seed\":");
+    out_int(&out, options.seed);
+    out_raw(&out, ",\"osv\":{\"x\":");
+    out_float(&out, arena->robots.x[0]);
+    out_raw(&out, ",\"y\":");
+    out_float(&out, arena->robots.y[0]);
+    out_raw(&out, ",\"theta\":");
+    out_float(&out, arena->robots.theta[0]);
+
+    out_raw(&out, "},\"obstacles\":[");
+    for(i = 0; i < arena->num_obstacles; i++) {
+        out_raw(&out, i > 0 ? ",{\"x\":" : "{\"x\":");
+        out_float(&out, arena->obstacles[i].location.x);
+        out_raw(&out, ",\"y\":");
+        out_float(&out, arena->obstacles[i].location.y);
+        out_raw(&out, ",\"width\":");
+        out_float(&out, arena->obstacles[i].width);
+        out_raw(&out, ",\"height\":");
+        out_float(&out, arena->obstacles[i].height);
+        out_raw(&out, "}");
     }
 
-    return string;
+    out_raw(&out, "],\"destination\":{\"x\":");
+    out_float(&out, arena->destination.x);
+    out_raw(&out, ",\"y\":");
+    out_float(&out, arena->destination.y);
+    out_raw(&out, "}}},");
 }
 
-char* get_id(cJSON *json) {
-    while(json != NULL) {
-        if(!strcmp(json->string, "id")) {
-            return json->valuestring;
-        }
+// a randomization that only carries a seed (and maybe the osv size) is generated
+// here, which saves the separate randomize round trip
+struct arena get_seeded_init(struct request *request, struct osv *first) {
+    struct arena arena;
 
-        json = json->next;
+    if(randomize_arena(request->seed, &arena, &first->location) != 0) {
+        error("Unable to randomize arena.", 6);
     }
 
-    error("Unable to get id.", 8);
+    options.seeded = 1;
+    options.seed = request->seed;
+
+    return arena;
 }
 
-char* get_code(cJSON *json) {
-    while(json != NULL) {
-        if(!strcmp(json->string, "code")) {
-            return json->valuestring;
-        }
+// the arena exactly as the request spelled it out, robot 0 starts where it said
+struct arena get_given_init(struct request *request) {
+    struct arena arena;
 
-        json = json->next;
+    if(!request->located[0]) {
+        error("Unable to get osv.", 6);
     }
 
-    error("Unable to get code.", 7);
-}
-
-cJSON* get_randomization(cJSON *json) {
-    while(json != NULL) {
-        if(!strcmp(json->string, "randomization")) {
-            return json->child;
-        }
-
-        json = json->next;
+    if(request->num_obstacles < 0) {
+        error("Unable to get obstacles.", 6);
     }
 
-    error("Unable to get randomization.", 6);
-}
+    if(!request->has_destination) {
+        error("Unable to get destination.", 6);
+    }
 
-cJSON* clean_for_simulate(cJSON *json) {
-    // get rid of type and code
-    json = json->next->next;
-    // keep randomization, distance sensors, id
-    return json;
+    arena.destination = request->destination;
+    arena.obstacles = request->obstacles;
+    arena.num_obstacles = request->num_obstacles;
+    return arena;
 }
 
-struct arena get_init(cJSON *json) {
-    cJSON *randomization = json->child;
-    cJSON *distance_sensors = json->next;
-
-    randomization = randomization->next;
-    cJSON *osv = randomization;
-    cJSON *obstacles = randomization->next->child;
-    cJSON *destination = randomization->next->next;
-
+struct arena get_init(struct request *request) {
     struct arena arena;
-    arena.destination.x = (float)destination->child->valuedouble;
-    arena.destination.y = (float)destination->child->next->valuedouble;
-    
-    arena.osv.location.x = (float)osv->child->valuedouble;
-    arena.osv.location.y = (float)osv->child->next->valuedouble;
-    arena.osv.location.theta = (float)osv->child->next->next->valuedouble;
-    arena.osv.height = (float)osv->child->next->next->next->valuedouble;
-    arena.osv.width = (float)osv->child->next->next->next->next->valuedouble;
-    arena.osv.left_motor_pwm = 0;
-    arena.osv.right_motor_pwm = 0;
-    
+    struct osv first = request->osvs[0];
     int i;
-    for(i = 0; i < cJSON_GetArraySize(distance_sensors); i++) {
-        arena.osv.distance_sensors[cJSON_GetArrayItem(distance_sensors, i)->valueint] = 1;
-    }
-    
-    arena.obstacles = (struct obstacle *)malloc(1 * sizeof(struct obstacle));
-    int num_obstacles = 0;
-    cJSON *curr = obstacles;
-    while(curr != NULL) {
-        num_obstacles++;
-        arena.obstacles = (struct obstacle *)realloc(arena.obstacles, num_obstacles * sizeof(struct obstacle));
-        arena.obstacles[num_obstacles - 1].location.x = curr->child->valuedouble;
-        arena.obstacles[num_obstacles - 1].location.y = curr->child->next->valuedouble;
-        arena.obstacles[num_obstacles - 1].width = curr->child->next->next->valuedouble;
-        arena.obstacles[num_obstacles - 1].height = curr->child->next->next->next->valuedouble;
-        curr = curr->next;
-    }
-
-    arena.num_obstacles = num_obstacles;
-    return arena;
-}
 
-int ngets(char *new_buffer, int fd) {
-    int size = read(fd, new_buffer, BUFFER_SIZE);
-    if(size == -1) {
-        return 0;
+    if(!request->has_randomization) {
+        error("Unable to get randomization.", 6);
+    }
+
+    if(request->has_seed && request->num_obstacles < 0) {
+        arena = get_seeded_init(request, &first);
     } else {
-        return size;
+        arena = get_given_init(request);
     }
+
+    arena.field = NULL;
+    arena.sides = NULL;
+    arena.walls = NULL;
+    arena.num_walls = 0;
+
+    init_robots(&arena.robots, options.num_robots);
+    add_robot(&arena.robots, first);
+    for(i = 1; i < options.num_robots; i++) {
+        // the extra osvs always say where they start
+        if(!request->located[i]) {
+            error("Unable to get robot.", 13);
+        }
+
+        add_robot(&arena.robots, request->osvs[i]);
+    }
+
+    return arena;
 }
 
-struct process copen(char *command) {
-    char *argv[] = { NULL };
+extern char **environ;
+
+// runs command, or the program in the fd program when that is not -1. log_fd
+// becomes the child's LOG_FD unless it is -1 too.
+struct process copen(char *command, int program, int log_fd) {
+    char *argv[] = { command, NULL };
     int in_pipe[2];
     int out_pipe[2];
 
@@ -151,12 +161,27 @@ struct process copen(char *command) {
         close(out_pipe[1]);
         close(in_pipe[0]);
 
-        dup2(out_pipe[0], fileno(stdin));
-        dup2(in_pipe[1], fileno(stdout));
+        // by number, a recorded run's stdout is a stream without an fd of its own
+        dup2(out_pipe[0], STDIN_FILENO);
+        dup2(in_pipe[1], STDOUT_FILENO);
+
+        // the channels are opened close on exec so only their own sketch keeps one
+        if(log_fd >= 0 && log_fd != LOG_FD) {
+            dup2(log_fd, LOG_FD);
+            close(log_fd);
+        } else if(log_fd == LOG_FD) {
+            fcntl(LOG_FD, F_SETFD, 0);
+        }
 
         // ask kernel to deliver SIGTERM in case the parent dies
         prctl(PR_SET_PDEATHSIG, SIGTERM);
 
+        // a program built in memory has no path to run it by
+        if(program >= 0) {
+            fexecve(program, argv, environ);
+            error("An error occured in fexecve", 5);
+        }
+
         // run the command
         if(execvp(command, argv) == -1) {
             error("An error occured in execvp", 5);
@@ -175,6 +200,9 @@ struct process copen(char *command) {
     p.pid = pid;
     p.input_fd = in_pipe[0];
     p.output_fd = out_pipe[1];
+    p.replies = NULL;
+    p.robot = 0;
+    p.log = NULL;
 
     return p;
 }
@@ -195,73 +223,361 @@ unsigned long time_nsec() {
     return t.tv_nsec;
 }
 
+// the program id of the i-th osv's sketch, the first one uses the request's
+char* robot_id(char *program_id, int robot) {
+    char *id = (char*)malloc(strlen(program_id) + 16);
+    if(robot == 0) {
+        sprintf(id, "%s", program_id);
+    } else {
+        sprintf(id, "%s-%d", program_id, robot);
+    }
+
+    return id;
+}
+
+// where the build of a sketch ends up, suffix picks the executable or the .so
+char* sketch_path(char *id, char *suffix) {
+    char *path = (char*)malloc(strlen("./../environments//") + 2 * strlen(id) + strlen(suffix) + 1);
+    sprintf(path, "./../environments/%s/%s%s", id, id, suffix);
+    return path;
+}
+
+// a warm fork of the zygote if there is one, otherwise start the program.
+// a program built in memory only exists as its fd, the zygote cannot load that.
+// log and log_fd are the sketch's channel for its prints, NULL and -1 without one.
+struct process sopen(char *id, int robot, int program, struct log *log, int log_fd) {
+    char *command = sketch_path(id, "");
+    char *sketch = sketch_path(id, ".so");
+
+    struct process p;
+    p.pid = -1;
+    if(program < 0) {
+        p = zopen(sketch, log_fd);
+    }
+
+    if(p.pid < 0) {
+        p = copen(command, program, log_fd);
+    }
+    p.robot = robot;
+    p.log = log;
+
+    // only the sketch writes to it, so it is all ours once the sketch is gone
+    if(log_fd >= 0) {
+        close(log_fd);
+    }
+
+    free(sketch);
+    free(command);
+    return p;
+}
+
+static int metrics_owner;
+
+// the active gauge goes down however we exit, but only for us and not for a
+// child that fails between fork and exec
+void leave() {
+    if(getpid() == metrics_owner) {
+        METRIC_ADD(active, -1);
+    }
+}
+
 int main(int argc, char *argv[]) {
-    char *input = get_input();
-    cJSON *json = cJSON_Parse(input);
+    // simulate --metrics dumps the counters of every run instead of running one
+    open_metrics();
+    if(argc > 1 && !strcmp(argv[1], "--metrics")) {
+        print_metrics(stdout);
+        return 0;
+    }
+
+    unsigned long started = metrics_usec();
+    unsigned long phase_start;
+    metrics_owner = getpid();
+    METRIC_ADD(simulations, 1);
+    METRIC_ADD(active, 1);
+    atexit(leave);
+
+    char *input = read_input();
+    struct request request;
+    int i;
+
+    parse_request(input, &request);
+    char *program_id = request.id;
+
+    // every osv after the first is driven by a sketch of its own
+    char *ids[MAX_ROBOTS];
+    for(i = 0; i < options.num_robots; i++) {
+        ids[i] = robot_id(program_id, i);
+    }
+
+    if(options.num_robots > 1 && (options.resume_id != NULL || options.num_checkpoints > 0)) {
+        error("Checkpoints need a single robot.", 9);
+    }
 
-    if(json == NULL) {
-        error("Unable to parse JSON.", 1);
+    if(options.num_robots > 1 && options.in_process) {
+        error("Several robots need isolated sketches.", 12);
     }
 
-    cJSON *parent_json = json;
-    cJSON *child_json = json->child;
+    // the sketch runs inside a worker of ours, there is no child to freeze
+    if(options.in_process && (options.resume_id != NULL || options.num_checkpoints > 0)) {
+        error("Checkpoints need an isolated sketch.", 12);
+    }
 
-    char *program_id = get_id(child_json);
+    // the in process worker loads the sketch's shared object from the environment
+    if(options.in_memory && options.in_process) {
+        error("In process sketches need a build on disk.", 12);
+    }
 
-    // now that we have the JSON we need to perform initialization
-    if(initialize(program_id, get_code(child_json)) != 0) {
-        // initialize error:
-        error("Unable to compile provided code.", 2);
+    // lockstep waits on the sketch, which a frozen copy never talks to
+    if(options.deterministic && (options.resume_id != NULL || options.num_checkpoints > 0)) {
+        error("Checkpoints need a run that is not deterministic.", 9);
     }
 
-    child_json = clean_for_simulate(child_json);
-    struct arena arena = get_init(child_json);
-    
-    // we have to run the processs
-    char *command = (char*)malloc((strlen("./../environments//") + 2 * strlen(get_id(child_json))));
-    sprintf(command, "./../environments/%s/%s", get_id(child_json), get_id(child_json));
+    // in process runs are as repeatable as deterministic ones, both come out the
+    // same for the same request every time, so a finished one is just played back
+    int cached = options.cache && (options.deterministic || options.in_process);
+    unsigned long long result = 0;
+    if(cached) {
+        result = result_key(&request);
+        if(replay_result(result)) {
+            for(i = 0; i < options.num_robots; i++) {
+                free(ids[i]);
+            }
 
-    struct node *head = NULL;
-    struct node *curr = head;
+            free(input);
+            observe(PHASE_TOTAL, started);
+            return 0;
+        }
+
+        record_result(result);
+    }
+
+    // now that we have the JSON the sketches start compiling, everything else
+    // is done while they do (a resumed run reuses the already running child instead)
+    struct build builds[MAX_ROBOTS];
+    unsigned long compile_start = metrics_usec();
+    for(i = 0; i < options.num_robots; i++) {
+        char *code = request.code[i];
+        builds[i].channel = -1;
+        builds[i].program = -1;
+
+        if(i == 0 && options.resume_id != NULL) {
+            continue;
+        }
+
+        if(code == NULL) {
+            error("Unable to get code.", 7);
+        }
+
+        start_build(&builds[i], ids[i], code, options.in_memory);
+    }
+
+    struct arena arena = get_init(&request);
+    load_scene(&arena, options.distance_field);
+
+    struct ring in[MAX_ROBOTS];
+    int exited[MAX_ROBOTS];
+    int quiet[MAX_ROBOTS];
+    for(i = 0; i < options.num_robots; i++) {
+        ring_init(&in[i]);
+        exited[i] = 0;
+        quiet[i] = 0;
+    }
 
     unsigned long curr_nsec;
     int frame_no = 0;
+    int next_checkpoint = 0;
+    int talked = 0;
+    int gone, messages;
+    const char *reason = NULL;
+    int end_robot = -1;
+
+    struct process p[MAX_ROBOTS];
+    struct log *logs[MAX_ROBOTS];
+    int log_fds[MAX_ROBOTS];
+    for(i = 0; i < options.num_robots; i++) {
+        logs[i] = NULL;
+        log_fds[i] = -1;
+    }
 
-    struct process p = copen(command);
-    free(command);
-    fcntl(p.input_fd, F_SETFL, O_NONBLOCK);
+    unsigned long start_usec = 0;
+    if(options.resume_id != NULL) {
+        phase_start = metrics_usec();
+        p[0] = resume_checkpoint(options.resume_id, options.resume_frame, &arena, &frame_no);
+        fcntl(p[0].input_fd, F_SETFL, O_NONBLOCK);
+        start_usec = metrics_usec() - phase_start;
+    } else if(!options.in_process) {
+        // we have to run the processs
+        if(options.num_checkpoints > 0) {
+            setenv(CHECKPOINT_ENV, checkpoint_dir(program_id), 1);
+        }
+
+        // a frozen copy outlives our end of the log channel, so checkpointed
+        // sketches keep sending their prints as messages.
+        // opened after the builds started so no compiler holds them open.
+        if(options.num_checkpoints == 0) {
+            char log_fd[16];
+            sprintf(log_fd, "%d", LOG_FD);
+            setenv(LOG_ENV, log_fd, 1);
+
+            for(i = 0; i < options.num_robots; i++) {
+                logs[i] = open_log(&log_fds[i]);
+                fcntl(log_fds[i], F_SETFD, FD_CLOEXEC);
+            }
+        }
+    }
+
+    // a sketch starts the moment its build is done. a failed build only counts
+    // once every osv before it built, the first osv's error is the one reported.
+    int programs[MAX_ROBOTS];
+    int launched[MAX_ROBOTS];
+    int failed = -1;
+    unsigned long compiled = compile_start;
+    for(i = 0; i < options.num_robots; i++) {
+        programs[i] = -1;
+        launched[i] = 0;
+    }
+
+    while((i = wait_build(builds, options.num_robots)) >= 0 || failed >= 0) {
+        if(i >= 0) {
+            compiled = metrics_usec();
+        }
+
+        if(i >= 0 && (builds[i].status != 0 || (options.in_memory && builds[i].program < 0))) {
+            if(failed < 0 || i < failed) {
+                failed = i;
+            }
+        } else if(i >= 0) {
+            programs[i] = builds[i].program;
+            if(!options.in_process && failed < 0) {
+                phase_start = metrics_usec();
+                p[i] = sopen(ids[i], i, programs[i], logs[i], log_fds[i]);
+                fcntl(p[i].input_fd, F_SETFL, O_NONBLOCK);
+                launched[i] = 1;
+                start_usec += metrics_usec() - phase_start;
+            }
+        }
+
+        if(failed >= 0 && builds_running(builds, failed) == 0) {
+            for(i = 0; i < options.num_robots; i++) {
+                if(launched[i]) {
+                    cclose(p[i]);
+                }
+            }
+            fail_build(&builds[failed]);
+        }
+    }
 
-    printf("[");
-    while(frame_no < NUM_FRAMES) {
-        curr_nsec = time_nsec();
-        while(time_nsec() - curr_nsec < FRAME_RATE_NSEC);
+    if(options.resume_id == NULL) {
+        observe_usec(PHASE_COMPILE, compiled - compile_start);
+    }
+
+    if(!options.in_process) {
+        observe_usec(PHASE_START, start_usec);
+    }
+
+    while(next_checkpoint < options.num_checkpoints && options.checkpoints[next_checkpoint] < frame_no) {
+        next_checkpoint++;
+    }
+
+    phase_start = metrics_usec();
+    out_raw(&out, "[");
+    if(options.seeded) {
+        print_arena(&arena);
+    }
+
+    if(options.in_process) {
+        char *sketch = sketch_path(program_id, ".so");
+        run_in_process(sketch, &arena, frame_no);
+        free(sketch);
+    }
+
+    while(!options.in_process && frame_no < options.num_frames) {
+        // a deterministic frame lasts as long as the sketches take, not a fixed time
+        if(!options.deterministic) {
+            curr_nsec = time_nsec();
+            while(time_nsec() - curr_nsec < FRAME_RATE_NSEC);
+        }
         // This itteration happens each frame
 
-        char *curr_buff = (char*)malloc(BUFFER_SIZE * sizeof(char));
-        int curr_size = ngets(curr_buff, p.input_fd);
-        if(curr_size == 0) {
-            free(curr_buff);
-        } else {
-            // we want to create a linked list of packets (queue)
-            // resize for space (?)
-            curr_buff = (char*)realloc(curr_buff, curr_size * sizeof(char));
-            if(head == NULL) {
-                head = new_node(curr_buff, curr_size);
-                curr = head;
-            } else {
-                curr->next = new_node(curr_buff, curr_size);
-                curr = curr->next;
+        // queue up whatever the children sent, partial messages wait for the rest.
+        // end of file is how we learn a child is gone, zygote forks are not ours to wait for.
+        for(i = 0; i < options.num_robots && !options.deterministic; i++) {
+            int size = ring_fill(&in[i], p[i].input_fd);
+            if(size > 0 && i == 0) {
+                talked = 1;
+            } else if(size == 0) {
+                exited[i] = 1;
+            }
+        }
+
+        // only once the child has talked do we know its signal handler is installed
+        if(talked && next_checkpoint < options.num_checkpoints && options.checkpoints[next_checkpoint] <= frame_no) {
+            request_checkpoint(p[0], options.checkpoints[next_checkpoint]);
+            next_checkpoint++;
+        }
+
+        messages = frame(in, p, &arena, &frame_no, exited, quiet);
+
+        // a child that is gone still gets everything it sent before it went
+        gone = 1;
+        for(i = 0; i < options.num_robots; i++) {
+            if(!exited[i] || message_length(&in[i]) != 0) {
+                gone = 0;
             }
         }
 
-        head = frame(head, p, &arena, &frame_no);
+        reason = check_end(&arena, messages, gone, &end_robot);
+        if(reason != NULL) {
+            break;
+        }
+    }
+
+    if(!options.in_process) {
+        // prints that came after the last frame we simulated
+        for(i = 0; i < options.num_robots; i++) {
+            drain_log(p[i].log, options.num_robots > 1 ? i : -1);
+        }
+
+        print_summary(&arena);
+        print_end(reason != NULL ? reason : "frames", frame_no, end_robot);
+    }
+    out_raw(&out, "]");
+    observe(PHASE_SIMULATE, phase_start);
+
+    // a sketch that went quiet got cut off wherever the clock happened to be
+    if(cached) {
+        int repeatable = 1;
+        for(i = 0; i < options.num_robots; i++) {
+            repeatable &= !quiet[i];
+        }
+
+        commit_result(repeatable);
+    }
+    free_scene(&arena);
+    free_robots(&arena.robots);
+
+    for(i = 0; i < options.num_robots; i++) {
+        if(options.resume_id == NULL && !options.in_memory) {
+            cleanup(ids[i]);
+        }
+        // only our own children can tell us how they went, zygote forks cannot
+        int status;
+        if(!options.in_process && exited[i] && waitpid(p[i].pid, &status, WNOHANG) == p[i].pid && WIFSIGNALED(status)) {
+            METRIC_ADD(crashes, 1);
+        }
+        if(!options.in_process) {
+            cclose(p[i]);
+            close_log(p[i].log);
+        }
+        if(programs[i] >= 0) {
+            close(programs[i]);
+        }
+
+        free(ids[i]);
     }
-    printf("]");
 
-    cleanup(program_id);
-    cclose(p);
-    cJSON_Delete(parent_json);
     free(input);
-    fflush(stdout);
+    out_flush(&out);
+    observe(PHASE_TOTAL, started);
     return 0;
-}
\ No newline at end of file
+}
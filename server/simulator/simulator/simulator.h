@@ -2,15 +2,51 @@
 #define SIMULATOR_H
 
 #define NUM_FRAMES 5000
-#define BUFFER_SIZE 100
+// the most a request may ask for, anything more ties up a worker for too long
+#define MAX_FRAMES 50000
+#define MAX_SUBSTEPS 1000
+#define COMMAND_BUDGET 0
 #define FRAME_RATE_NSEC 200000
 
+struct ring;
+struct log;
+
 struct process {
     int pid;
     int input_fd;
     int output_fd;
+    // set when the sketch runs inside the simulator, replies go here instead of output_fd
+    struct ring *replies;
+    // index of the osv this process drives
+    int robot;
+    // where its prints arrive, NULL when they come as print messages
+    struct log *log;
+};
+
+// per request settings that are not part of the arena
+struct options {
+    int *checkpoints;
+    int num_checkpoints;
+    char *resume_id;
+    int resume_frame;
+    int command_budget;
+    int seeded;
+    unsigned int seed;
+    int distance_field;
+    float output_hz;
+    int substeps;
+    int num_frames;
+    int in_process;
+    int num_robots;
+    float arrival_radius;
+    int idle_frames;
+    int in_memory;
+    // messages are handled in lockstep with the frames instead of as they come
+    int deterministic;
+    // 0 plays a repeatable run out even when its result is stored, for timing it
+    int cache;
 };
 
-int ngets(char *new_buffer, int fd);
+extern struct options options;
 
 #endif
\ No newline at end of file
@@ -0,0 +1,242 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "summary.h"
+#include "simulator.h"
+#include "end.h"
+#include "output.h"
+
+// everything here is kept as the frames go by, so the summary costs a few sums
+// per frame instead of a second pass over thousands of poses. a resumed run
+// only adds up the frames it played itself.
+
+static struct run_stats stats[MAX_ROBOTS];
+static int frames = 0;
+static int started = 0;
+
+static void start_stats() {
+    int i;
+
+    memset(stats, 0, sizeof(stats));
+    for(i = 0; i < MAX_ROBOTS; i++) {
+        stats[i].arrival_frame = -1;
+        stats[i].clearance = -1;
+    }
+
+    started = 1;
+}
+
+// called by step_robots() for every osv it moved, blocked when the sweep stopped
+// it short because it touched something
+void track_move(int robot, float dx, float dy, int blocked) {
+    if(!started) {
+        start_stats();
+    }
+
+    stats[robot].distance += sqrt(dx * dx + dy * dy);
+    stats[robot].blocked |= blocked;
+}
+
+static float point_distance(struct coordinate p, struct line l) {
+    float lx = l.p2.x - l.p1.x;
+    float ly = l.p2.y - l.p1.y;
+    float px = p.x - l.p1.x;
+    float py = p.y - l.p1.y;
+    float length = lx * lx + ly * ly;
+    float t = length > 0 ? (px * lx + py * ly) / length : 0;
+
+    if(t < 0) {
+        t = 0;
+    } else if(t > 1) {
+        t = 1;
+    }
+
+    float dx = px - lx * t;
+    float dy = py - ly * t;
+    return sqrt(dx * dx + dy * dy);
+}
+
+static float side_of(struct line l, struct coordinate p) {
+    return (l.p2.x - l.p1.x) * (p.y - l.p1.y) - (l.p2.y - l.p1.y) * (p.x - l.p1.x);
+}
+
+// 0 when they cross, otherwise the closest an end of one gets to the other
+static float segment_distance(struct line a, struct line b) {
+    float a1 = side_of(a, b.p1), a2 = side_of(a, b.p2);
+    float b1 = side_of(b, a.p1), b2 = side_of(b, a.p2);
+    if(((a1 <= 0 && a2 >= 0) || (a1 >= 0 && a2 <= 0)) && ((b1 <= 0 && b2 >= 0) || (b1 >= 0 && b2 <= 0))) {
+        return 0;
+    }
+
+    return fminf(fminf(point_distance(a.p1, b), point_distance(a.p2, b)),
+        fminf(point_distance(b.p1, a), point_distance(b.p2, a)));
+}
+
+// gap between osv i and the nearest obstacle. obstacles whose box is already
+// further from the center than the closest so far, body included, are skipped.
+static float clearance(struct arena *arena, int robot) {
+    int i, j, k;
+    struct robots *robots = &arena->robots;
+    float radius = robot_radius(robots, robot);
+    float best = -1;
+
+    struct line osv_sides[4];
+    robot_sides(robots, robot, osv_sides);
+
+    for(i = 0; i < arena->num_obstacles; i++) {
+        struct obstacle *obstacle = &arena->obstacles[i];
+        float dx = fmaxf(fmaxf(obstacle->location.x - robots->x[robot], robots->x[robot] - obstacle->location.x - obstacle->width), 0);
+        float dy = fmaxf(fmaxf(obstacle->location.y - obstacle->height - robots->y[robot], robots->y[robot] - obstacle->location.y), 0);
+        if(best >= 0 && sqrt(dx * dx + dy * dy) - radius >= best) {
+            continue;
+        }
+
+        struct line *sides = arena->sides + 4 * i;
+        for(j = 0; j < 4; j++) {
+            for(k = 0; k < 4; k++) {
+                float d = segment_distance(osv_sides[j], sides[k]);
+                if(best < 0 || d < best) {
+                    best = d;
+                }
+            }
+        }
+    }
+
+    return best;
+}
+
+// called by update_osv() once the frame's substeps are done
+void track_frame(struct arena *arena, int frame_no) {
+    int i;
+    struct robots *robots = &arena->robots;
+    float radius = options.arrival_radius > 0 ? options.arrival_radius : ARRIVAL_RADIUS;
+
+    if(!started) {
+        start_stats();
+    }
+
+    for(i = 0; i < robots->count; i++) {
+        struct run_stats *s = &stats[i];
+
+        // a collision is the frame it ran into something, not every frame it
+        // then spends pushing against it
+        if(s->blocked) {
+            s->blocked_frames++;
+            if(!s->was_blocked) {
+                s->collisions++;
+            }
+        }
+        s->was_blocked = s->blocked;
+        s->blocked = 0;
+
+        float d = clearance(arena, i);
+        if(d >= 0 && (s->clearance < 0 || d < s->clearance)) {
+            s->clearance = d;
+        }
+
+        s->left_duty += fminf(abs(robots->left_motor_pwm[i]), 255) / 255.0;
+        s->right_duty += fminf(abs(robots->right_motor_pwm[i]), 255) / 255.0;
+
+        float dx = robots->x[i] - arena->destination.x;
+        float dy = robots->y[i] - arena->destination.y;
+        if(s->arrival_frame < 0 && dx * dx + dy * dy <= radius * radius) {
+            s->arrival_frame = frame_no;
+        }
+    }
+
+    frames++;
+}
+
+void track_sensor_read(int robot) {
+    if(!started) {
+        start_stats();
+    }
+
+    stats[robot].sensor_reads++;
+}
+
+void track_location_read(int robot) {
+    if(!started) {
+        start_stats();
+    }
+
+    stats[robot].location_reads++;
+}
+
+static void print_rate(int count, float seconds) {
+    out_float(&out, seconds > 0 ? count / seconds : 0);
+}
+
+static void print_stats(int robot, float seconds) {
+    struct run_stats *s = &stats[robot];
+
+    out_raw(&out, "{\"distance\":");
+    out_float(&out, s->distance);
+
+    // the time from the start of the run, a resumed one included
+    out_raw(&out, ",\"arrival_sec\":");
+    if(s->arrival_frame >= 0) {
+        out_float(&out, (s->arrival_frame + 1) / options.output_hz);
+    } else {
+        out_raw(&out, "null");
+    }
+
+    out_raw(&out, ",\"collisions\":");
+    out_int(&out, s->collisions);
+    out_raw(&out, ",\"blocked_frames\":");
+    out_int(&out, s->blocked_frames);
+
+    out_raw(&out, ",\"clearance\":");
+    if(s->clearance >= 0) {
+        out_float(&out, s->clearance);
+    } else {
+        out_raw(&out, "null");
+    }
+
+    out_raw(&out, ",\"left_duty\":");
+    out_float(&out, frames > 0 ? s->left_duty / frames : 0);
+    out_raw(&out, ",\"right_duty\":");
+    out_float(&out, frames > 0 ? s->right_duty / frames : 0);
+    out_raw(&out, ",\"sensor_reads\":");
+    out_int(&out, s->sensor_reads);
+    out_raw(&out, ",\"sensor_hz\":");
+    print_rate(s->sensor_reads, seconds);
+    out_raw(&out, ",\"location_reads\":");
+    out_int(&out, s->location_reads);
+    out_raw(&out, ",\"location_hz\":");
+    print_rate(s->location_reads, seconds);
+    out_raw(&out, "}");
+}
+
+// goes right before the end record. the first osv's numbers are under osv like
+// its pose is in a frame, with more than one they are all in osvs as well.
+void print_summary(struct arena *arena) {
+    int i;
+    int count = arena->robots.count;
+    // never more than the run was asked for, whatever a fast forward counted
+    int played = frames < options.num_frames ? frames : options.num_frames;
+    float seconds = played / options.output_hz;
+
+    if(!started) {
+        start_stats();
+    }
+
+    out_raw(&out, "{\"summary\":{\"seconds\":");
+    out_float(&out, seconds);
+    out_raw(&out, ",\"osv\":");
+    print_stats(0, seconds);
+
+    if(count > 1) {
+        out_raw(&out, ",\"osvs\":[");
+        for(i = 0; i < count; i++) {
+            if(i > 0) {
+                out_raw(&out, ",");
+            }
+            print_stats(i, seconds);
+        }
+        out_raw(&out, "]");
+    }
+
+    out_raw(&out, "}},");
+}
@@ -0,0 +1,30 @@
+#ifndef SUMMARY_H
+#define SUMMARY_H
+
+#include "vs.h"
+
+// what a run amounted to for one osv, added up frame by frame as it is played
+// out so nobody has to get it back out of the poses
+struct run_stats {
+    double distance;
+    // first frame it ended within the arrival radius, -1 until then
+    int arrival_frame;
+    int collisions;
+    int blocked_frames;
+    // whether a sweep stopped it during the frame being played, and the one before
+    int blocked, was_blocked;
+    // closest it got to an obstacle, negative while there are none
+    float clearance;
+    // |pwm| / 255 of each motor added up over the frames
+    double left_duty, right_duty;
+    int sensor_reads;
+    int location_reads;
+};
+
+void track_move(int robot, float dx, float dy, int blocked);
+void track_frame(struct arena *arena, int frame_no);
+void track_sensor_read(int robot);
+void track_location_read(int robot);
+void print_summary(struct arena *arena);
+
+#endif
@@ -0,0 +1,623 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <utime.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "units.h"
+#include "compile.h"
+#include "hash.h"
+
+// a sketch is cut into one translation unit per function plus one for main().
+// every unit is the generated header followed by its function. the header holds
+// the prototypes and everything at the top level that is not a function, with
+// the global variables made inline so each unit sees the same ones and the
+// linker keeps one of each. objects are kept by the hash of their unit, so an
+// edit recompiles the functions it touched and the rest is only linked again.
+// the unit is kept next to its object and has to match before the object is
+// used, the hash alone is easy to collide on purpose.
+// anything the cutting gets wrong fails to compile or link, and the whole
+// build then does it the old way.
+
+enum piece_kind {
+    PIECE_DIRECTIVE,
+    PIECE_DECLARATION,
+    PIECE_FUNCTION
+};
+
+// one top level part of a sketch
+struct piece {
+    int kind;
+    int line;
+    const char *start;
+    int length;
+    // about a declaration, what the top level of it looks like
+    int words;
+    int braces;
+    int call;
+    char last;
+};
+
+static int is_word(char c) {
+    return isalnum((unsigned char)c) || c == '_';
+}
+
+static int word_is(const char *word, int length, const char *name) {
+    return (int)strlen(name) == length && !strncmp(word, name, length);
+}
+
+// after the comment or literal at p, lines gets the newlines in it. p itself
+// when there is none there.
+static const char* skip_text(const char *p, int *line) {
+    if(p[0] == '/' && p[1] == '/') {
+        while(*p != '\0' && *p != '\n') {
+            p++;
+        }
+    } else if(p[0] == '/' && p[1] == '*') {
+        p += 2;
+        while(*p != '\0' && !(p[0] == '*' && p[1] == '/')) {
+            if(*p == '\n') {
+                (*line)++;
+            }
+            p++;
+        }
+        p += *p != '\0' ? 2 : 0;
+    } else if(*p == '"' || *p == '\'') {
+        char quote = *p++;
+        while(*p != '\0' && *p != quote) {
+            if(*p == '\\' && p[1] != '\0') {
+                p++;
+            }
+            if(*p == '\n') {
+                (*line)++;
+            }
+            p++;
+        }
+        p += *p != '\0' ? 1 : 0;
+    }
+
+    return p;
+}
+
+static int is_qualifier(const char *word, int length) {
+    return word_is(word, length, "const") || word_is(word, length, "noexcept")
+        || word_is(word, length, "override") || word_is(word, length, "final")
+        || word_is(word, length, "volatile");
+}
+
+// cuts the declaration or function starting at piece->start. a function is a
+// brace right after a parameter list, a namespace or extern "C" block ends at
+// its brace too, everything else at the first semicolon of the top level.
+static void cut_statement(struct piece *piece, const char **at, int *line) {
+    const char *p = *at;
+    int depth = 0, parens = 0;
+    int equals = 0, after_paren = 0, block = 0;
+    int first = 1;
+
+    piece->kind = PIECE_DECLARATION;
+    piece->words = 0;
+    piece->braces = 0;
+    piece->call = 0;
+    piece->last = '\0';
+
+    while(*p != '\0') {
+        const char *after = skip_text(p, line);
+        if(after != p) {
+            if(depth == 0 && (*p == '"' || *p == '\'')) {
+                piece->last = '"';
+                after_paren = 0;
+            }
+            p = after;
+            continue;
+        }
+
+        char c = *p;
+        if(c == '\n') {
+            (*line)++;
+        }
+
+        if(is_word(c)) {
+            const char *word = p;
+            while(is_word(*p)) {
+                p++;
+            }
+
+            if(depth == 0 && parens == 0) {
+                if(first && word_is(word, p - word, "namespace")) {
+                    block = 1;
+                }
+                if(!is_qualifier(word, p - word)) {
+                    after_paren = 0;
+                }
+                piece->words++;
+                piece->last = 'a';
+            }
+            first = 0;
+            continue;
+        }
+
+        if(c == '(') {
+            if(depth == 0 && parens == 0 && !equals) {
+                piece->call = 1;
+            }
+            parens++;
+        } else if(c == ')') {
+            parens--;
+            if(depth == 0 && parens == 0) {
+                after_paren = 1;
+                piece->last = ')';
+                p++;
+                continue;
+            }
+        } else if(c == '{') {
+            if(depth == 0 && parens == 0) {
+                if(after_paren && !equals) {
+                    piece->kind = PIECE_FUNCTION;
+                } else if(piece->last == '"') {
+                    block = 1;
+                }
+                piece->braces = 1;
+            }
+            depth++;
+        } else if(c == '}') {
+            depth--;
+            if(depth == 0 && (piece->kind == PIECE_FUNCTION || block)) {
+                p++;
+                break;
+            }
+        } else if(c == ';' && depth == 0 && parens == 0) {
+            p++;
+            break;
+        } else if(c == '=' && depth == 0 && parens == 0) {
+            equals = 1;
+        }
+
+        if(depth == 0 && parens == 0 && !isspace((unsigned char)c)) {
+            after_paren = 0;
+            piece->last = c;
+        }
+        p++;
+    }
+
+    *at = p;
+}
+
+// the top level of a sketch, in order
+static struct piece* cut_pieces(const char *code, int *count) {
+    struct piece *pieces = (struct piece*)malloc(1 * sizeof(struct piece));
+    int n = 0;
+    int line = 1;
+    const char *p = code;
+
+    while(*p != '\0') {
+        if(*p == '\n') {
+            line++;
+            p++;
+            continue;
+        } else if(isspace((unsigned char)*p)) {
+            p++;
+            continue;
+        } else if(p[0] == '/' && (p[1] == '/' || p[1] == '*')) {
+            p = skip_text(p, &line);
+            continue;
+        }
+
+        struct piece piece;
+        piece.line = line;
+        piece.start = p;
+
+        if(*p == '#') {
+            piece.kind = PIECE_DIRECTIVE;
+            while(*p != '\0' && *p != '\n') {
+                if(*p == '\\' && p[1] == '\n') {
+                    line++;
+                    p++;
+                }
+                p++;
+            }
+        } else {
+            cut_statement(&piece, &p, &line);
+        }
+
+        piece.length = p - piece.start;
+        pieces = (struct piece*)realloc(pieces, (n + 1) * sizeof(struct piece));
+        pieces[n++] = piece;
+    }
+
+    *count = n;
+    return pieces;
+}
+
+static int first_word(struct piece *piece, const char **word) {
+    const char *p = piece->start;
+    while(is_word(*p) && p < piece->start + piece->length) {
+        p++;
+    }
+
+    *word = piece->start;
+    return p - piece->start;
+}
+
+// whether a declaration defines a global variable, which has to become inline
+// to be in every unit. skip is set to the length of a static it starts with,
+// inline takes its place so the variable stays one variable.
+static int defines_variable(struct piece *piece, int *skip) {
+    const char *word;
+    int length = first_word(piece, &word);
+    static const char *not_variables[] = {"typedef", "using", "extern", "template", "friend",
+        "static_assert", "inline", "namespace"};
+    int i;
+
+    *skip = 0;
+    for(i = 0; i < (int)(sizeof(not_variables) / sizeof(not_variables[0])); i++) {
+        if(word_is(word, length, not_variables[i])) {
+            return 0;
+        }
+    }
+
+    // a prototype, or an object built with parentheses that the build then has
+    // to sort out
+    if(piece->call) {
+        return 0;
+    }
+
+    if(word_is(word, length, "struct") || word_is(word, length, "class")
+        || word_is(word, length, "union") || word_is(word, length, "enum")) {
+        // a type and nothing declared with it, or only its name
+        if(piece->last == '}' || (!piece->braces && piece->words == 2)) {
+            return 0;
+        }
+    }
+
+    if(word_is(word, length, "static")) {
+        *skip = length;
+    }
+
+    return 1;
+}
+
+static void append(char **data, int *length, const char *text, int size) {
+    *data = (char*)realloc(*data, (*length + size + 1) * sizeof(char));
+    memcpy(*data + *length, text, size);
+    *length += size;
+    (*data)[*length] = '\0';
+}
+
+// the line directive goes before every piece so diagnostics and __LINE__ come
+// out where they were in the sketch, which starts on line 2 like in
+// build_source()
+static void append_line(char **data, int *length, int line) {
+    char directive[64];
+    append(data, length, directive, sprintf(directive, "#line %d \"%s\"\n", line + 1, UNIT_FILE));
+}
+
+static struct unit make_unit(char *header, int header_length, const char *text, int size, int line) {
+    struct unit unit;
+    int length = 0;
+
+    unit.source = (char*)malloc(1 * sizeof(char));
+    append(&unit.source, &length, header, header_length);
+    if(line > 0) {
+        append_line(&unit.source, &length, line);
+    }
+    append(&unit.source, &length, text, size);
+    append(&unit.source, &length, "\n", 1);
+
+    unsigned long long seed = hash_string(UNIT_COMMAND, library_key());
+    int version = UNITS_VERSION;
+    seed = hash_bytes(&version, sizeof(version), seed);
+    unit.key = hash_bytes(unit.source, length, seed);
+
+    return unit;
+}
+
+// the units of a sketch, main() last
+struct unit_list split_units(char *code) {
+    struct unit_list list;
+    int status_code = 0;
+    int count, i;
+
+    list.units = NULL;
+    list.n_units = 0;
+
+    struct match_list functions = match_declarations(code, &status_code);
+    if(status_code != 0) {
+        return list;
+    }
+
+    struct piece *pieces = cut_pieces(code, &count);
+
+    char *header = (char*)malloc(1 * sizeof(char));
+    int header_length = 0;
+    header[0] = '\0';
+
+    for(i = 0; i < functions.n_matches; i++) {
+        append(&header, &header_length, functions.matches[i], strlen(functions.matches[i]));
+        append(&header, &header_length, ";\n", 2);
+    }
+    free_match_list(functions);
+
+    int n_functions = 0;
+    for(i = 0; i < count; i++) {
+        int skip = 0;
+        if(pieces[i].kind == PIECE_FUNCTION) {
+            n_functions++;
+            continue;
+        }
+
+        append_line(&header, &header_length, pieces[i].line);
+        if(pieces[i].kind == PIECE_DECLARATION && defines_variable(&pieces[i], &skip)) {
+            append(&header, &header_length, "inline ", 7);
+        }
+        append(&header, &header_length, pieces[i].start + skip, pieces[i].length - skip);
+        append(&header, &header_length, "\n", 1);
+    }
+
+    list.units = (struct unit*)malloc((n_functions + 1) * sizeof(struct unit));
+    for(i = 0; i < count; i++) {
+        if(pieces[i].kind == PIECE_FUNCTION) {
+            list.units[list.n_units++] = make_unit(header, header_length, pieces[i].start, pieces[i].length, pieces[i].line);
+        }
+    }
+    list.units[list.n_units++] = make_unit(header, header_length, SKETCH_MAIN, strlen(SKETCH_MAIN), 0);
+
+    free(header);
+    free(pieces);
+    return list;
+}
+
+void free_unit_list(struct unit_list list) {
+    int i;
+
+    for(i = 0; i < list.n_units; i++) {
+        free(list.units[i].source);
+    }
+
+    free(list.units);
+}
+
+static void object_path(struct unit *unit, char *path) {
+    char hex[HASH_HEX_LENGTH + 1];
+    hash_hex(unit->key, hex);
+    sprintf(path, "%s%s.o", OBJECTS_DIR, hex);
+}
+
+static void unit_path(struct unit *unit, char *path) {
+    char hex[HASH_HEX_LENGTH + 1];
+    hash_hex(unit->key, hex);
+    sprintf(path, "%s%s.cpp", OBJECTS_DIR, hex);
+}
+
+// keeps the source of unit next to its object, 0 once it is there
+static int save_unit(struct unit *unit) {
+    char path[strlen(OBJECTS_DIR) + HASH_HEX_LENGTH + 8];
+    char tmp[sizeof(path) + 32];
+    unit_path(unit, path);
+    sprintf(tmp, "%s.%d", path, getpid());
+
+    FILE *fp = fopen(tmp, "w");
+    if(fp == NULL) {
+        return -1;
+    }
+
+    size_t length = strlen(unit->source);
+    int written = fwrite(unit->source, 1, length, fp) == length;
+    if(fclose(fp) != 0 || !written || rename(tmp, path) != 0) {
+        unlink(tmp);
+        return -1;
+    }
+
+    return 0;
+}
+
+// the object of unit is there and was compiled from the same source
+static int have_object(struct unit *unit, char *path) {
+    char source[strlen(OBJECTS_DIR) + HASH_HEX_LENGTH + 8];
+    unit_path(unit, source);
+
+    if(!same_file(source, unit->source, strlen(unit->source))) {
+        return 0;
+    }
+
+    // touched so prune_objects() leaves both alone while they are in use
+    return utime(path, NULL) == 0 && utime(source, NULL) == 0;
+}
+
+// compiles the units in todo, jobs of them at a time. returns 0 when all of
+// them are in OBJECTS_DIR.
+static int compile_units(struct unit_list list, int *todo, int n_todo, int jobs) {
+    int pids[MAX_UNIT_JOBS];
+    int status = 0;
+    int i, j;
+
+    int path_size = strlen(OBJECTS_DIR) + HASH_HEX_LENGTH + 32;
+    for(i = 0; i < n_todo && status == 0; i += jobs) {
+        char paths[jobs][path_size];
+        char tmps[jobs][path_size];
+        int started = 0;
+
+        for(j = 0; j < jobs && i + j < n_todo; j++) {
+            struct unit *unit = &list.units[todo[i + j]];
+            object_path(unit, paths[j]);
+            sprintf(tmps[j], "%s.%d", paths[j], getpid());
+
+            char command[strlen(UNIT_COMMAND) + path_size];
+            sprintf(command, UNIT_COMMAND, tmps[j]);
+            pids[j] = spawn_compiler(command, unit->source, NULL);
+            started++;
+        }
+
+        // an object only goes where others look for it once it is whole, and
+        // after the source it has to match
+        for(j = 0; j < started; j++) {
+            if(pids[j] < 0 || wait_compiler(pids[j]) != 0 || save_unit(&list.units[todo[i + j]]) != 0 || rename(tmps[j], paths[j]) != 0) {
+                unlink(tmps[j]);
+                status = -1;
+            }
+        }
+    }
+
+    return status;
+}
+
+// units the last build_units() left to fill_units()
+static struct unit_list pending = { NULL, 0 };
+static int *pending_todo = NULL;
+static int n_pending = 0;
+
+// builds the program and shared object of file out of one object per function,
+// compiling only those no earlier build of any sketch left behind. that pays
+// when the missing ones compile all at once, one per free compile slot. with
+// more of them one compiler run over the whole sketch is quicker, they are then
+// kept for fill_units() to compile once the sketch is built and the next edit
+// finds them. returns 0 once both are linked, anything else leaves it to the
+// whole build, which also tells the student what was wrong.
+int build_units(char *file, char *code) {
+    struct unit_list list = split_units(code);
+    int slots[MAX_UNIT_JOBS];
+    int n_slots = 0;
+    int i;
+
+    if(list.n_units == 0) {
+        return -1;
+    }
+
+    mkdir(BUILDS_DIR, 0777);
+    mkdir(OBJECTS_DIR, 0777);
+
+    int path_size = strlen(OBJECTS_DIR) + HASH_HEX_LENGTH + 3;
+    int *todo = (int*)malloc(list.n_units * sizeof(int));
+    int n_todo = 0;
+    char *objects = (char*)malloc(list.n_units * (path_size + 1) + 1);
+    objects[0] = '\0';
+
+    for(i = 0; i < list.n_units; i++) {
+        char path[path_size];
+        object_path(&list.units[i], path);
+
+        if(!have_object(&list.units[i], path)) {
+            todo[n_todo++] = i;
+        }
+
+        strcat(objects, " ");
+        strcat(objects, path);
+    }
+
+    // the build already holds one slot
+    while(n_slots < n_todo - 1 && n_slots < MAX_UNIT_JOBS - 1 && (slots[n_slots] = try_slot()) >= 0) {
+        n_slots++;
+    }
+
+    int status = -1;
+    if(n_todo <= n_slots + 1) {
+        status = compile_units(list, todo, n_todo, n_slots + 1);
+        free(todo);
+        free_unit_list(list);
+    } else {
+        pending = list;
+        pending_todo = todo;
+        n_pending = n_todo;
+    }
+
+    for(i = 0; i < n_slots; i++) {
+        close(slots[i]);
+    }
+
+    if(status == 0) {
+        const char *linker = access(FAST_LINKER, X_OK) == 0 ? "-fuse-ld=gold" : "";
+        char command[strlen(objects) + 4 * strlen(file) + strlen(CLIENT_OBJECTS) + 128];
+        char *output = (char*)malloc(1 * sizeof(char));
+        int length = 0;
+
+        sprintf(command, "g++ %s -o ../environments/%s/%s%s " CLIENT_OBJECTS, linker, file, file, objects);
+        status = run_compiler(command, "", &output, &length);
+
+        if(status == 0) {
+            sprintf(command, "g++ %s -shared -o ../environments/%s/%s.so%s", linker, file, file, objects);
+            status = run_compiler(command, "", &output, &length);
+        }
+
+        free(output);
+    }
+
+    free(objects);
+    return status;
+}
+
+// compiles what build_units() left over in a detached process at the lowest
+// priority, so the run it was built for goes ahead meanwhile. nothing is
+// compiled without a free compile slot, nobody is waiting for these.
+void fill_units() {
+    int i;
+
+    if(n_pending == 0) {
+        return;
+    }
+
+    int pid = fork();
+    if(pid == 0) {
+        // the grandchild is nobody's to wait for and holds none of our files,
+        // the front end reads our stdout to the end
+        if(fork() != 0) {
+            _exit(0);
+        }
+
+        int null_fd = open("/dev/null", O_RDWR);
+        for(i = 0; i < 3; i++) {
+            dup2(null_fd, i);
+        }
+        for(i = 3; i < FILL_MAX_FD; i++) {
+            close(i);
+        }
+
+        if(nice(19) == -1) {
+            _exit(0);
+        }
+
+        int slot_fd = try_slot();
+        if(slot_fd >= 0) {
+            compile_units(pending, pending_todo, n_pending, 1);
+        }
+        _exit(0);
+    } else if(pid > 0) {
+        waitpid(pid, NULL, 0);
+    }
+
+    free(pending_todo);
+    free_unit_list(pending);
+    pending_todo = NULL;
+    n_pending = 0;
+}
+
+// removes objects and their units no build has used for BUILD_TTL seconds, and whatever a
+// crashed compile left half written
+void prune_objects() {
+    DIR *dir = opendir(OBJECTS_DIR);
+    if(dir == NULL) {
+        return;
+    }
+
+    time_t now = time(NULL);
+    struct dirent *entry;
+    while((entry = readdir(dir)) != NULL) {
+        if(entry->d_name[0] == '.') {
+            continue;
+        }
+
+        char path[strlen(OBJECTS_DIR) + strlen(entry->d_name) + 1];
+        sprintf(path, "%s%s", OBJECTS_DIR, entry->d_name);
+
+        struct stat st;
+        if(stat(path, &st) == 0 && now - st.st_mtime >= BUILD_TTL) {
+            unlink(path);
+        }
+    }
+
+    closedir(dir);
+}
@@ -0,0 +1,38 @@
+#ifndef UNITS_H
+#define UNITS_H
+
+// objects of single sketch functions by the hash of what they were compiled
+// from, shared by every sketch and every simulate process
+#define OBJECTS_DIR "../builds/objects/"
+// bump whenever units are cut up or compiled differently
+#define UNITS_VERSION 1
+// the name units give their code, the same for every submission so the same
+// function compiles to the same object whoever sent it
+#define UNIT_FILE "sketch.cpp"
+// run from the dependencies directory with the unit on stdin
+#define UNIT_COMMAND "g++ -I ./ -fPIC -c -x c++ - -o %s"
+// links a lot faster than the default linker, used when it is there
+#define FAST_LINKER "/usr/bin/ld.gold"
+// most units compiled at once, each in a compile slot of its own
+#define MAX_UNIT_JOBS 8
+// fds below this are closed in the process fill_units() leaves behind
+#define FILL_MAX_FD 1024
+
+// one translation unit of a sketch, the shared header and one of its functions
+struct unit {
+    char *source;
+    unsigned long long key;
+};
+
+struct unit_list {
+    struct unit *units;
+    int n_units;
+};
+
+struct unit_list split_units(char *code);
+void free_unit_list(struct unit_list list);
+int build_units(char *file, char *code);
+void fill_units();
+void prune_objects();
+
+#endif
@@ -2,26 +2,29 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <poll.h>
 #include <sys/time.h>
-#include <cjson/cJSON.h>
 #include <math.h>
 
 #include "simulator.h"
-#include "node.h"
+#include "ring.h"
 #include "vs.h"
+#include "checkpoint.h"
+#include "field.h"
+#include "end.h"
+#include "metrics.h"
+#include "log.h"
+#include "output.h"
+#include "summary.h"
 
 #define SENSOR_RANGE 1.0f
 #define PI 3.1415926535f
-#define BUFF_SIZE 262
 #define EPSILON 0.000001f
 #define ROTATIONS_PER_SECOND 0.25f
 #define max(x1,x2) ((x1) > (x2) ? (x1) : (x2))
 #define min(x1,x2) ((x1) < (x2) ? (x1) : (x2))
 #define abs(x) ((x > 0) ? (x) : (-x))
 
-char buffer [BUFF_SIZE];
-unsigned short buffer_pos = 0;
-
 float cross_product(struct coordinate a, struct coordinate b) {
     return a.x * b.y - b.x * a.y;
 }
@@ -87,43 +90,227 @@ struct coordinate * get_intersection(struct line a, struct line b) {
 }
 
 float distance(struct coordinate a, struct coordinate b) {
-    return sqrt(pow(a.x - b.x, 2) + pow(a.y - b.y, 2));
+    float dx = a.x - b.x;
+    float dy = a.y - b.y;
+    return sqrt(dx * dx + dy * dy);
 }
 
-float read_distance_sensor(struct arena arena, short index) {
-    int i, j;
+// how far along the sensor trace it first meets one of these sides, or minimum_distance if that is closer
+float sides_distance(struct line *sides, struct line sensor_trace, float minimum_distance) {
+    int j;
+
+    for(j = 0; j < 4; j++) {
+    	struct coordinate *intersection_point = get_intersection(sides[j], sensor_trace);
+        if(intersection_point != NULL) {
+            minimum_distance = min(minimum_distance, distance(sensor_trace.p1, *intersection_point));
+            free(intersection_point);
+        }
+    }
+
+    return minimum_distance;
+}
+
+// the four sides of an obstacle, right, bottom, left, top
+void obstacle_sides(struct obstacle *obstacle, struct line *sides) {
+    struct line right;
+    struct coordinate r1, r2;
+    r1.x = obstacle->location.x + obstacle->width;
+    r1.y = obstacle->location.y;
+    r2.x = obstacle->location.x + obstacle->width;
+    r2.y = obstacle->location.y - obstacle->height;
+    right.p1 = r1; right.p2 = r2;
+
+    struct line bottom;
+    struct coordinate b1, b2;
+    b1.x = obstacle->location.x;
+    b1.y = obstacle->location.y - obstacle->height;
+    b2.x = obstacle->location.x + obstacle->width;
+    b2.y = obstacle->location.y - obstacle->height;
+    bottom.p1 = b1; bottom.p2 = b2;
+
+    struct line left;
+    struct coordinate l1, l2;
+    l1.x = obstacle->location.x;
+    l1.y = obstacle->location.y - obstacle->height;
+    l2.x = obstacle->location.x;
+    l2.y = obstacle->location.y;
+    left.p1 = l1; left.p2 = l2;
+
+    struct line top;
+    struct coordinate t1, t2;
+    t1.x = obstacle->location.x;
+    t1.y = obstacle->location.y;
+    t2.x = obstacle->location.x + obstacle->width;
+    t2.y = obstacle->location.y;
+    top.p1 = t1; top.p2 = t2;
+
+    sides[0] = right;
+    sides[1] = bottom;
+    sides[2] = left;
+    sides[3] = top;
+}
+
+// how far along the sensor trace it first meets this obstacle, or minimum_distance if that is closer
+float obstacle_distance(struct obstacle *obstacle, struct line sensor_trace, float minimum_distance) {
+    struct line sides[4];
+    obstacle_sides(obstacle, sides);
+
+    return sides_distance(sides, sensor_trace, minimum_distance);
+}
+
+void init_robots(struct robots *robots, int capacity) {
+    robots->count = 0;
+    robots->x = (float *)malloc(capacity * sizeof(float));
+    robots->y = (float *)malloc(capacity * sizeof(float));
+    robots->theta = (float *)malloc(capacity * sizeof(float));
+    robots->width = (float *)malloc(capacity * sizeof(float));
+    robots->height = (float *)malloc(capacity * sizeof(float));
+    robots->left_motor_pwm = (int *)malloc(capacity * sizeof(int));
+    robots->right_motor_pwm = (int *)malloc(capacity * sizeof(int));
+    robots->sensors = (unsigned short *)malloc(capacity * sizeof(unsigned short));
+    robots->wake_frame = (int *)malloc(capacity * sizeof(int));
+    robots->sensor_cache = (float *)malloc(capacity * NUM_SENSORS * sizeof(float));
+    robots->sensor_cached = (unsigned short *)malloc(capacity * sizeof(unsigned short));
+}
+
+// puts an osv into the arena with its motors off, returns its index
+int add_robot(struct robots *robots, struct osv osv) {
+    int i = robots->count++;
+
+    robots->x[i] = osv.location.x;
+    robots->y[i] = osv.location.y;
+    robots->theta[i] = osv.location.theta;
+    robots->width[i] = osv.width;
+    robots->height[i] = osv.height;
+    robots->left_motor_pwm[i] = 0;
+    robots->right_motor_pwm[i] = 0;
+    robots->sensors[i] = osv.sensors;
+    robots->wake_frame[i] = 0;
+    robots->sensor_cached[i] = 0;
+
+    return i;
+}
+
+void free_robots(struct robots *robots) {
+    free(robots->x);
+    free(robots->y);
+    free(robots->theta);
+    free(robots->width);
+    free(robots->height);
+    free(robots->left_motor_pwm);
+    free(robots->right_motor_pwm);
+    free(robots->sensors);
+    free(robots->wake_frame);
+    free(robots->sensor_cache);
+    free(robots->sensor_cached);
+    robots->count = 0;
+}
+
+// a reading depends on where every osv is, not just the one it was taken from
+void forget_sensors(struct robots *robots) {
+    memset(robots->sensor_cached, 0, robots->count * sizeof(unsigned short));
+}
+
+// half the diagonal, nothing of the osv is further than this from its center
+float robot_radius(struct robots *robots, int i) {
+    return sqrt(robots->width[i] * robots->width[i] + robots->height[i] * robots->height[i]) / 2;
+}
+
+// the sides of an osv as it collides, front, left, back, right
+void robot_sides(struct robots *robots, int i, struct line *sides) {
+    // struct coordinates a,b,c,d represent the four corners of the OSV
+    double cos_theta = cos(robots->theta[i]);
+    double sin_theta = sin(robots->theta[i]);
+
+    struct coordinate coordinate_front;
+    coordinate_front.x = robots->x[i] + robots->width[i] / 2 * cos_theta;
+    coordinate_front.y = robots->y[i] + robots->width[i] / 2 * sin_theta;
+
+    struct coordinate a;
+    a.x = coordinate_front.x - robots->height[i] / 2 * sin_theta;
+    a.y = coordinate_front.y + robots->height[i] / 2 * cos_theta;
+
+    struct coordinate b;
+    b.x = coordinate_front.x + robots->height[i] / 2 * sin_theta;
+    b.y = coordinate_front.y - robots->height[i] / 2 * cos_theta;
+
+    struct coordinate coordinate_back;
+    coordinate_back.x = robots->x[i] - robots->width[i] / 2 * cos_theta;
+    coordinate_back.y = robots->y[i] - robots->width[i] / 2 * sin_theta;
+
+    struct coordinate c;
+    c.x = coordinate_back.x - robots->height[i] / 2 * sin_theta;
+    c.y = coordinate_back.y + robots->height[i] / 2 * cos_theta;
+
+    struct coordinate d;
+    d.x = coordinate_back.x + robots->height[i] / 2 * sin_theta;
+    d.y = coordinate_back.y - robots->height[i] / 2 * cos_theta;
+
+    struct line front_osv;
+    front_osv.p1 = a;
+    front_osv.p2 = b;
+    
+    struct line left_osv;
+    left_osv.p1 = a;
+    left_osv.p2 = c;
 
-    if(!arena.osv.distance_sensors[index]) {
+    struct line back_osv;
+    back_osv.p1 = c;
+    back_osv.p2 = d;
+
+    struct line right_osv;
+    right_osv.p1 = b;
+    right_osv.p2 = d;
+
+    sides[0] = front_osv;
+    sides[1] = left_osv;
+    sides[2] = back_osv;
+    sides[3] = right_osv;
+}
+
+float read_distance_sensor(struct arena *arena, int robot, short index) {
+    int i;
+    struct robots *robots = &arena->robots;
+
+    if(index < 0 || index >= NUM_SENSORS || !(robots->sensors[robot] & (1 << index))) {
         return -1.0;
     }
 
+    // polling between frames reads what it read last time, nothing has moved
+    float *cached = &robots->sensor_cache[robot * NUM_SENSORS + index];
+    if(robots->sensor_cached[robot] & (1 << index)) {
+        return *cached;
+    }
+
     // we have to get the slope of the front side of the osv first
-    float cos_theta = cos(arena.osv.location.theta);
-    float sin_theta = sin(arena.osv.location.theta);
+    float cos_theta = cos(robots->theta[robot]);
+    float sin_theta = sin(robots->theta[robot]);
+    float width = robots->width[robot];
+    float height = robots->height[robot];
 
     struct coordinate midPointFront;
-    midPointFront.x = arena.osv.location.x + arena.osv.height / 2 * cos_theta;
-    midPointFront.y = arena.osv.location.y + arena.osv.height / 2 * sin_theta;
+    midPointFront.x = robots->x[robot] + height / 2 * cos_theta;
+    midPointFront.y = robots->y[robot] + height / 2 * sin_theta;
 
     struct coordinate a;
-    a.x = midPointFront.x - arena.osv.width / 2 * sin_theta;
-    a.y = midPointFront.y + arena.osv.width / 2 * cos_theta;
+    a.x = midPointFront.x - width / 2 * sin_theta;
+    a.y = midPointFront.y + width / 2 * cos_theta;
 
     struct coordinate b;
-    b.x = midPointFront.x + arena.osv.width / 2 * sin_theta;
-    b.y = midPointFront.y - arena.osv.width / 2 * cos_theta;
+    b.x = midPointFront.x + width / 2 * sin_theta;
+    b.y = midPointFront.y - width / 2 * cos_theta;
 
     struct coordinate midPointBack;
-    midPointBack.x = arena.osv.location.x - arena.osv.height / 2 * cos_theta;
-    midPointBack.y = arena.osv.location.y - arena.osv.height / 2 * sin_theta;
+    midPointBack.x = robots->x[robot] - height / 2 * cos_theta;
+    midPointBack.y = robots->y[robot] - height / 2 * sin_theta;
 
     struct coordinate c;
-    c.x = midPointBack.x - arena.osv.width / 2 * sin_theta;
-    c.y = midPointBack.y + arena.osv.width / 2 * cos_theta;
+    c.x = midPointBack.x - width / 2 * sin_theta;
+    c.y = midPointBack.y + width / 2 * cos_theta;
 
     struct coordinate d;
-    d.x = midPointBack.x + arena.osv.width / 2 * sin_theta;
-    d.y = midPointBack.y - arena.osv.width / 2 * cos_theta;
+    d.x = midPointBack.x + width / 2 * sin_theta;
+    d.y = midPointBack.y - width / 2 * cos_theta;
 
     struct coordinate midPointLeft;
     midPointLeft.x = (a.x + c.x) / 2;
@@ -136,7 +323,7 @@ float read_distance_sensor(struct arena arena, short index) {
     struct coordinate sensor_locations[12] = {a, midPointFront, b, b, midPointRight, d, d, midPointBack, c, c, midPointLeft, a};
 
     int sideIndex = index / 3;
-    float orientation = arena.osv.location.theta - sideIndex * PI / 2;
+    float orientation = robots->theta[robot] - sideIndex * PI / 2;
 
     struct coordinate endPoint;
     endPoint.x = sensor_locations[index].x + SENSOR_RANGE * cos(orientation);
@@ -148,143 +335,54 @@ float read_distance_sensor(struct arena arena, short index) {
     sensor_trace.p2.x = endPoint.x;
     sensor_trace.p2.y = endPoint.y;
 
-    float minimum_distance = 1.0;
-
-    for(i = 0; i < arena.num_obstacles; i++) {
-        // for each of the arena.obstacles[i]s
-        struct line right;
-        struct coordinate r1, r2;
-        r1.x = arena.obstacles[i].location.x + arena.obstacles[i].width;
-        r1.y = arena.obstacles[i].location.y;
-        r2.x = arena.obstacles[i].location.x + arena.obstacles[i].width;
-        r2.y = arena.obstacles[i].location.y - arena.obstacles[i].height;
-        right.p1 = r1; right.p2 = r2;
-
-        struct line bottom;
-        struct coordinate b1, b2;
-        b1.x = arena.obstacles[i].location.x;
-        b1.y = arena.obstacles[i].location.y - arena.obstacles[i].height;
-        b2.x = arena.obstacles[i].location.x + arena.obstacles[i].width;
-        b2.y = arena.obstacles[i].location.y - arena.obstacles[i].height;
-        bottom.p1 = b1; bottom.p2 = b2;
-
-        struct line left;
-        struct coordinate l1, l2;
-        l1.x = arena.obstacles[i].location.x;
-        l1.y = arena.obstacles[i].location.y - arena.obstacles[i].height;
-        l2.x = arena.obstacles[i].location.x;
-        l2.y = arena.obstacles[i].location.y;
-        left.p1 = l1; left.p2 = l2;
-
-        struct line top;
-        struct coordinate t1, t2;
-        t1.x = arena.obstacles[i].location.x;
-        t1.y = arena.obstacles[i].location.y;
-        t2.x = arena.obstacles[i].location.x + arena.obstacles[i].width;
-        t2.y = arena.obstacles[i].location.y;
-        top.p1 = t1; top.p2 = t2;
-        
-        struct line obstacle_sides[4] = {right, bottom, left, top};
+    float minimum_distance = SENSOR_RANGE;
 
-        for(j = 0; j < 4; j++) {
-        	struct coordinate *intersection_point = get_intersection(obstacle_sides[j], sensor_trace);
-            if(intersection_point != NULL) {
-                minimum_distance = min(minimum_distance, distance(sensor_locations[index], *intersection_point));
-                free(intersection_point);
-            }
+    // a large course gets a distance field, the ray only looks at what is near it
+    if(arena->field != NULL) {
+        minimum_distance = trace_field(arena, sensor_trace, SENSOR_RANGE);
+    } else {
+        for(i = 0; i < arena->num_obstacles; i++) {
+            minimum_distance = sides_distance(arena->sides + 4 * i, sensor_trace, minimum_distance);
         }
     }
 
-    return minimum_distance;
-}
-
-int check_for_collisions(struct arena *arena) {
-    int i, j, k;
-    // struct coordinates a,b,c,d represent the four corners of the OSV
-    double cos_theta = cos(arena->osv.location.theta);
-    double sin_theta = sin(arena->osv.location.theta);
-
-    struct coordinate coordinate_front;
-    coordinate_front.x = arena->osv.location.x + arena->osv.width / 2 * cos_theta;
-    coordinate_front.y = arena->osv.location.y + arena->osv.width / 2 * sin_theta;
-
-    struct coordinate a;
-    a.x = coordinate_front.x - arena->osv.height / 2 * sin_theta;
-    a.y = coordinate_front.y + arena->osv.height / 2 * cos_theta;
-
-    struct coordinate b;
-    b.x = coordinate_front.x + arena->osv.height / 2 * sin_theta;
-    b.y = coordinate_front.y - arena->osv.height / 2 * cos_theta;
-
-    struct coordinate coordinate_back;
-    coordinate_back.x = arena->osv.location.x - arena->osv.width / 2 * cos_theta;
-    coordinate_back.y = arena->osv.location.y - arena->osv.width / 2 * sin_theta;
-
-    struct coordinate c;
-    c.x = coordinate_back.x - arena->osv.height / 2 * sin_theta;
-    c.y = coordinate_back.y + arena->osv.height / 2 * cos_theta;
+    // the other osvs are obstacles too, just ones that move
+    for(i = 0; i < robots->count; i++) {
+        if(i == robot) {
+            continue;
+        }
 
-    struct coordinate d;
-    d.x = coordinate_back.x + arena->osv.height / 2 * sin_theta;
-    d.y = coordinate_back.y - arena->osv.height / 2 * cos_theta;
+        float reach = minimum_distance + robot_radius(robots, i);
+        float dx = robots->x[i] - sensor_trace.p1.x;
+        float dy = robots->y[i] - sensor_trace.p1.y;
+        if(dx * dx + dy * dy > reach * reach) {
+            continue;
+        }
 
-    struct line front_osv;
-    front_osv.p1 = a;
-    front_osv.p2 = b;
-    
-    struct line left_osv;
-    left_osv.p1 = a;
-    left_osv.p2 = c;
+        struct line sides[4];
+        robot_sides(robots, i, sides);
+        minimum_distance = sides_distance(sides, sensor_trace, minimum_distance);
+    }
 
-    struct line back_osv;
-    back_osv.p1 = c;
-    back_osv.p2 = d;
+    *cached = minimum_distance;
+    robots->sensor_cached[robot] |= 1 << index;
+    return minimum_distance;
+}
 
-    struct line right_osv;
-    right_osv.p1 = b;
-    right_osv.p2 = d;
+// whether osv i touches an obstacle, a wall or one of the osvs set in others
+int check_for_collisions(struct arena *arena, int robot, unsigned int others) {
+    int i, j, k;
 
-    struct line osv_sides[4] = {front_osv, left_osv, back_osv, right_osv};
+    struct line osv_sides[4];
+    robot_sides(&arena->robots, robot, osv_sides);
 
     for(i = 0; i < arena->num_obstacles; i++) {
         // for each of the obstacles
-        struct line right;
-        struct coordinate r1, r2;
-        r1.x = arena->obstacles[i].location.x + arena->obstacles[i].width;
-        r1.y = arena->obstacles[i].location.y;
-        r2.x = arena->obstacles[i].location.x + arena->obstacles[i].width;
-        r2.y = arena->obstacles[i].location.y - arena->obstacles[i].height;
-        right.p1 = r1; right.p2 = r2;
-
-        struct line bottom;
-        struct coordinate b1, b2;
-        b1.x = arena->obstacles[i].location.x;
-        b1.y = arena->obstacles[i].location.y - arena->obstacles[i].height;
-        b2.x = arena->obstacles[i].location.x + arena->obstacles[i].width;
-        b2.y = arena->obstacles[i].location.y - arena->obstacles[i].height;
-        bottom.p1 = b1; bottom.p2 = b2;
-
-        struct line left;
-        struct coordinate l1, l2;
-        l1.x = arena->obstacles[i].location.x;
-        l1.y = arena->obstacles[i].location.y - arena->obstacles[i].height;
-        l2.x = arena->obstacles[i].location.x;
-        l2.y = arena->obstacles[i].location.y;
-        left.p1 = l1; left.p2 = l2;
-
-        struct line top;
-        struct coordinate t1, t2;
-        t1.x = arena->obstacles[i].location.x;
-        t1.y = arena->obstacles[i].location.y;
-        t2.x = arena->obstacles[i].location.x + arena->obstacles[i].width;
-        t2.y = arena->obstacles[i].location.y;
-        top.p1 = t1; top.p2 = t2;
-        
-        struct line obstacle_sides[4] = {right, bottom, left, top};
+        struct line *sides = arena->sides + 4 * i;
 
         for(j = 0; j < 4; j++) {
             for(k = 0; k < 4; k++) {
-                struct coordinate *res = get_intersection(osv_sides[k], obstacle_sides[j]);
+                struct coordinate *res = get_intersection(osv_sides[k], sides[j]);
                 if(res != NULL) {
                     free(res);
                     return 1;
@@ -293,45 +391,10 @@ int check_for_collisions(struct arena *arena) {
         }
     }
 
-    // now we want to define the walls:
-    struct line right;
-    struct coordinate r1, r2;
-    r1.x = 4.0;
-    r1.y = 0.0;
-    r2.x = 4.0;
-    r2.y = 2.0;
-    right.p1 = r1; right.p2 = r2;
-    
-    struct line bottom;
-    struct coordinate b1, b2;
-    b1.x = 0.0;
-    b1.y = 0.0;
-    b2.x = 4.0;
-    b2.y = 0.0;
-    bottom.p1 = b1; bottom.p2 = b2;
-
-    struct line left;
-    struct coordinate l1, l2;
-    l1.x = 0.0;
-    l1.y = 0.0;
-    l2.x = 0.0;
-    l2.y = 2.0;
-    left.p1 = l1; left.p2 = l2;
-
-    struct line top;
-    struct coordinate t1, t2;
-    t1.x = 0.0;
-    t1.y = 2.0;
-    t2.x = 4.0;
-    t2.y = 2.0;
-    top.p1 = t1; top.p2 = t2;
-
-    struct line walls[4] = {right, bottom, left, top};
-
     // need to check right and left sides of OSV in case OSV is perpendicular to wall
     for(i = 0; i < 4; i++) {
-        for(j = 0; j < 4; j++) {
-            struct coordinate *res = get_intersection(osv_sides[i], walls[j]);
+        for(j = 0; j < arena->num_walls; j++) {
+            struct coordinate *res = get_intersection(osv_sides[i], arena->walls[j]);
             if(res != NULL) {
                 free(res);
                 return 1;
@@ -339,204 +402,491 @@ int check_for_collisions(struct arena *arena) {
         }
     }
 
+    for(k = 0; others != 0; k++, others >>= 1) {
+        if(!(others & 1)) {
+            continue;
+        }
+
+        struct line sides[4];
+        robot_sides(&arena->robots, k, sides);
+
+        for(i = 0; i < 4; i++) {
+            for(j = 0; j < 4; j++) {
+                struct coordinate *res = get_intersection(osv_sides[i], sides[j]);
+                if(res != NULL) {
+                    free(res);
+                    return 1;
+                }
+            }
+        }
+    }
+
     return 0;
 }
 
-void update_osv(struct arena *arena, int frame_no) {
-    struct coordinate prev_location;
-    prev_location.x = arena->osv.location.x;
-    prev_location.y = arena->osv.location.y;
-    prev_location.theta = arena->osv.location.theta;
+// where osv i is a fraction t of the way from one pose to the next
+void set_pose(struct robots *robots, int i, struct coordinate from, struct coordinate to, float t) {
+    robots->x[i] = from.x + (to.x - from.x) * t;
+    robots->y[i] = from.y + (to.y - from.y) * t;
+    robots->theta[i] = from.theta + (to.theta - from.theta) * t;
+}
 
-    double dist_traveled = METERS_PER_FRAME * (arena->osv.right_motor_pwm + arena->osv.left_motor_pwm) / 255.0f;
+// sweeps osv i from start to end so it stops where it first touches something
+// instead of jumping over it or snapping back to where it started. returns
+// whether it did touch something.
+int sweep_robot(struct arena *arena, int robot, struct coordinate start, struct coordinate end, float sweep, unsigned int others) {
+    int i;
+    struct robots *robots = &arena->robots;
+    int samples = max(1, (int)ceil(sweep / SWEEP_STEP));
+
+    float free_t = 0, hit_t = -1;
+    for(i = 1; i <= samples; i++) {
+        float t = i / (float)samples;
+        set_pose(robots, robot, start, end, t);
+        if(check_for_collisions(arena, robot, others)) {
+            hit_t = t;
+            break;
+        }
 
-    arena->osv.location.x = arena->osv.location.x + dist_traveled * cos(arena->osv.location.theta);
-    arena->osv.location.y = arena->osv.location.y + dist_traveled * sin(arena->osv.location.theta);
+        free_t = t;
+    }
 
-    arena->osv.location.theta += RAD_PER_FRAME * ((arena->osv.right_motor_pwm - arena->osv.left_motor_pwm) / 510.0f);
+    if(hit_t >= 0) {
+        // time of impact is somewhere between the last free sample and the hit
+        for(i = 0; i < TOI_ITERATIONS; i++) {
+            float t = (free_t + hit_t) / 2;
+            set_pose(robots, robot, start, end, t);
+            if(check_for_collisions(arena, robot, others)) {
+                hit_t = t;
+            } else {
+                free_t = t;
+            }
+        }
 
-    if(arena->osv.location.theta > PI) {
-        arena->osv.location.theta -= 2 * PI;
-    } else if(arena->osv.location.theta < -PI) {
-        arena->osv.location.theta += 2 * PI;
+        set_pose(robots, robot, start, end, free_t);
     }
 
-    if(check_for_collisions(arena)) {
-        arena->osv.location.x = prev_location.x;
-        arena->osv.location.y = prev_location.y;
-        arena->osv.location.theta = prev_location.theta;
+    if(robots->theta[robot] > PI) {
+        robots->theta[robot] -= 2 * PI;
+    } else if(robots->theta[robot] < -PI) {
+        robots->theta[robot] += 2 * PI;
     }
-    
-    cJSON *root = cJSON_CreateObject();
-    cJSON *osv = cJSON_CreateObject();
-    cJSON_AddNumberToObject(root, "frame_no", frame_no);
-    cJSON_AddNumberToObject(osv, "x", arena->osv.location.x);
-    cJSON_AddNumberToObject(osv, "y", arena->osv.location.y);
-    cJSON_AddNumberToObject(osv, "theta", arena->osv.location.theta);
-    cJSON_AddItemToObject(root, "osv", osv);
-
-    printf("%s,", cJSON_Print(root));
-    cJSON_Delete(root);
+
+    return hit_t >= 0;
 }
 
-void print_command(char *command, char *data, int ln) {
-    cJSON *root = cJSON_CreateObject();
-    cJSON_AddItemToObject(root, "command", cJSON_CreateString(command));
+// one physics step of every osv. the motion of all of them is integrated in one
+// pass, then a second pass finds which pairs could meet during the step so each
+// sweep only tests the osvs near it.
+void step_robots(struct arena *arena, float meters, float radians) {
+    int i, j;
+    struct robots *robots = &arena->robots;
+    int n = robots->count;
+
+    struct coordinate start[MAX_ROBOTS], end[MAX_ROBOTS];
+    float sweep[MAX_ROBOTS], reach[MAX_ROBOTS];
+    unsigned int others[MAX_ROBOTS];
+
+    for(i = 0; i < n; i++) {
+        double dist_traveled = meters * (robots->right_motor_pwm[i] + robots->left_motor_pwm[i]) / 255.0f;
+
+        start[i].x = robots->x[i];
+        start[i].y = robots->y[i];
+        start[i].theta = robots->theta[i];
+        end[i].x = start[i].x + dist_traveled * cos(start[i].theta);
+        end[i].y = start[i].y + dist_traveled * sin(start[i].theta);
+        end[i].theta = start[i].theta + radians * ((robots->right_motor_pwm[i] - robots->left_motor_pwm[i]) / 510.0f);
+
+        // turning moves the corners too, half the diagonal out from the center
+        float radius = robot_radius(robots, i);
+        sweep[i] = max(fabs(dist_traveled), fabs(end[i].theta - start[i].theta) * radius);
+        reach[i] = radius + sweep[i];
+        others[i] = 0;
+    }
 
-    if(data != NULL) {
-        cJSON_AddItemToObject(root, "data", cJSON_CreateString(data));
+    for(i = 0; i < n; i++) {
+        for(j = i + 1; j < n; j++) {
+            float dx = start[i].x - start[j].x;
+            float dy = start[i].y - start[j].y;
+            float r = reach[i] + reach[j];
+            if(dx * dx + dy * dy <= r * r) {
+                others[i] |= 1 << j;
+                others[j] |= 1 << i;
+            }
+        }
     }
 
-    cJSON_AddNumberToObject(root, "line_number", ln);
-    
-    printf("%s,", cJSON_Print(root));
-    cJSON_Delete(root);
+    // osvs earlier in the list have already moved when a later one sweeps
+    for(i = 0; i < n; i++) {
+        int blocked = sweep_robot(arena, i, start[i], end[i], sweep[i], others[i]);
+        track_move(i, robots->x[i] - start[i].x, robots->y[i] - start[i].y, blocked);
+    }
+}
+
+static void print_pose(struct robots *robots, int i) {
+    out_raw(&out, "{\"x\":");
+    out_float(&out, robots->x[i]);
+    out_raw(&out, ",\"y\":");
+    out_float(&out, robots->y[i]);
+    out_raw(&out, ",\"theta\":");
+    out_float(&out, robots->theta[i]);
+    out_raw(&out, "}");
 }
 
-struct node * process_command(struct node *in, struct process p, struct arena *arena, int *frame_no) {
-    char opcode;
+void update_osv(struct arena *arena, int frame_no) {
     int i;
-    unsigned char ack_code = '\x08';
-    struct node *curr, *next;
-    buffer_pos = 0;
+    struct robots *robots = &arena->robots;
+    float physics_hz = options.output_hz * options.substeps;
+
+    struct coordinate before[MAX_ROBOTS];
+    for(i = 0; i < robots->count; i++) {
+        before[i].x = robots->x[i];
+        before[i].y = robots->y[i];
+        before[i].theta = robots->theta[i];
+    }
 
-    if(in == NULL || in->size == 0) {
-        return in;
+    for(i = 0; i < options.substeps; i++) {
+        step_robots(arena, METERS_PER_STEP(physics_hz), RAD_PER_STEP(physics_hz));
     }
 
-    curr = in;
-    // read in all of the available data into the buffer
-    while(curr != NULL && (buffer_pos < BUFF_SIZE)) {
-        for(i = 0; i < curr->size; i++) {
-            buffer[i + buffer_pos] = (curr->data)[i];
+    // an osv parked or pushing against a wall keeps its readings
+    for(i = 0; i < robots->count; i++) {
+        if(robots->x[i] != before[i].x || robots->y[i] != before[i].y || robots->theta[i] != before[i].theta) {
+            forget_sensors(robots);
+            break;
         }
+    }
+    track_frame(arena, frame_no);
+    METRIC_ADD(frames, 1);
+
+    out_raw(&out, "{\"frame_no\":");
+    out_int(&out, frame_no);
+    out_raw(&out, ",\"osv\":");
+    print_pose(robots, 0);
+
+    // the first osv keeps its usual place, the rest only show up here
+    if(robots->count > 1) {
+        out_raw(&out, ",\"osvs\":[");
+        for(i = 0; i < robots->count; i++) {
+            if(i > 0) {
+                out_raw(&out, ",");
+            }
+            print_pose(robots, i);
+        }
+        out_raw(&out, "]");
+    }
+
+    out_raw(&out, "},");
+}
+
+// sends a reply to the sketch, wherever it runs
+void reply(struct process p, const void *data, int size) {
+    if(p.replies != NULL) {
+        ring_push(p.replies, data, size);
+    } else {
+        write(p.output_fd, data, size);
+    }
+}
+
+// robot is only printed when there is more than one osv to tell apart
+void print_command(char *command, char *data, int ln, int robot) {
+    out_raw(&out, "{\"command\":");
+    out_string(&out, command, strlen(command));
+
+    if(data != NULL) {
+        out_raw(&out, ",\"data\":");
+        out_string(&out, data, strlen(data));
+    }
+
+    out_raw(&out, ",\"line_number\":");
+    out_int(&out, ln);
+
+    if(robot >= 0) {
+        out_raw(&out, ",\"robot\":");
+        out_int(&out, robot);
+    }
+
+    out_raw(&out, "},");
+}
+
+// length of the message at the front of the queue.
+// 0 if it has not fully arrived yet, -1 if the front byte is not an opcode.
+int message_length(struct ring *in) {
+    int length;
 
-        buffer_pos += curr->size;
-        curr = curr->next;
+    if(ring_size(in) < 1) {
+        return 0;
+    }
+
+    switch(ring_byte(in, 0)) {
+        case 0x00:
+        case 0x01:
+        case 0x05:
+        length = 5;
+        break;
+        case 0x02:
+        if(ring_size(in) < 6) {
+            return 0;
+        }
+        length = 6 + ring_byte(in, 5);
+        break;
+        case 0x03:
+        case 0x04:
+        length = 7;
+        break;
+        case 0x06:
+        length = 6;
+        break;
+        case 0x07:
+        case 0x08:
+        length = 9;
+        break;
+        default:
+        return -1;
+    }
+
+    return ring_size(in) >= (unsigned int)length ? length : 0;
+}
+
+// handles the complete message at the front of the queue and removes it
+void process_command(struct ring *in, int length, struct process p, struct arena *arena, int *frame_no) {
+    char opcode = ring_byte(in, 0);
+    int line_number = ring_int(in, 1);
+    int i;
+    unsigned char ack_code = '\x08';
+    struct robots *robots = &arena->robots;
+    int robot = p.robot;
+    int tag = robots->count > 1 ? robot : -1;
+
+    if(opcode >= 0 && opcode < NUM_OPCODES) {
+        METRIC_ADD(messages[(int)opcode], 1);
     }
 
-    // we are at the beginning of a message, check for opcode
-    opcode = buffer[0];
     if(opcode == 0x00) {
         // Enes100.begin() message
         // receives: 1 byte opcode, 4 byte line number
         // returns: 3 floats
-        if(in->size < 5) {
-            return in;
-        } else {
-            print_command("begin", NULL, *(int *)(buffer + 1));
-            write(p.output_fd, &(arena->destination.x), sizeof(float));
-            write(p.output_fd, &(arena->destination.y), sizeof(float));
-            write(p.output_fd, &(arena->destination.theta), sizeof(float));
-        }
+        print_command("begin", NULL, line_number, tag);
+        reply(p, &(arena->destination.x), sizeof(float));
+        reply(p, &(arena->destination.y), sizeof(float));
+        reply(p, &(arena->destination.theta), sizeof(float));
     } else if(opcode == 0x01) {
         // updateLocation() message
         // receives: 1 byte opcode, 4 byte line number
         // returns: 3 floats
-        if(in->size < 5) {
-            return in;
-        } else {
-            print_command("update_location", NULL, *(int *)(buffer + 1));
-            write(p.output_fd, &(arena->osv.location.x), sizeof(float));
-            write(p.output_fd, &(arena->osv.location.y), sizeof(float));
-            write(p.output_fd, &(arena->osv.location.theta), sizeof(float));
-        }
+        print_command("update_location", NULL, line_number, tag);
+        track_location_read(robot);
+        reply(p, &(robots->x[robot]), sizeof(float));
+        reply(p, &(robots->y[robot]), sizeof(float));
+        reply(p, &(robots->theta[robot]), sizeof(float));
     } else if(opcode == 0x02) {
         // print() message
         // receives: 1 byte opcode, 4 byte line number, 1 byte length, length number of characters
         // returns: 1 byte ack
-        if(in->size < 6 || buffer[5] < buffer_pos - 6) {
-            return in;
-        } else {
-            print_command("print", buffer + 6, *(int *)(buffer + 1));
-            write(p.output_fd, &ack_code, sizeof(unsigned char));
-        }
+        char data[length - 6 + 1];
+        ring_copy(in, 6, data, length - 6);
+        data[length - 6] = '\0';
+
+        print_command("print", data, line_number, tag);
+        reply(p, &ack_code, sizeof(unsigned char));
     } else if(opcode == 0x03) {
         // Tank.setLeftMotorPWM()
         // receives: 1 byte opcode, 4 byte line number, 2 byte pwm value
         // returns: 1 byte ack
-        if(in->size < 7) {
-            return in;
-        } else {
-            print_command("setLeftMotorPWM", NULL, *(int *)(buffer + 1));
-            write(p.output_fd, &ack_code, sizeof(unsigned char));
-            arena->osv.left_motor_pwm = *(short *)(buffer + 5);
-        }
+        print_command("setLeftMotorPWM", NULL, line_number, tag);
+        reply(p, &ack_code, sizeof(unsigned char));
+        robots->left_motor_pwm[robot] = ring_short(in, 5);
     } else if(opcode == 0x04) {
         // Tank.setRightMotorPWM()
         // receives: 1 byte opcode, 4 byte line number, 2 byte pwm value
         // returns: 1 byte ack
-        if(in->size < 7) {
-            return in;
-        } else {
-            print_command("setRightMotorPWM", NULL, *(int *)(buffer + 1));
-            write(p.output_fd, &ack_code, sizeof(unsigned char));
-            arena->osv.right_motor_pwm = *(short *)(buffer + 5);
-        }
+        print_command("setRightMotorPWM", NULL, line_number, tag);
+        reply(p, &ack_code, sizeof(unsigned char));
+        robots->right_motor_pwm[robot] = ring_short(in, 5);
     } else if(opcode == 0x05) {
         // Tank.turnOffMotors()
         // receives: 1 byte opcode, 4 byte line number
         // returns: 1 byte ack
-        if(in->size < 5) {
-            return in;
-        } else {
-            print_command("turnOffMotors", NULL, *(int *)(buffer + 1));
-            arena->osv.left_motor_pwm = 0;
-            arena->osv.right_motor_pwm = 0;
-            write(p.output_fd, &ack_code, sizeof(unsigned char));
-        }
+        print_command("turnOffMotors", NULL, line_number, tag);
+        robots->left_motor_pwm[robot] = 0;
+        robots->right_motor_pwm[robot] = 0;
+        reply(p, &ack_code, sizeof(unsigned char));
     } else if(opcode == 0x06) {
         // Tank.readDistanceSensors()
         // receives: 1 byte opcode, 4 byte line number, 1 byte index
         // returns: 4 byte float
-        if(buffer_pos < 6) {
-            return in;
-        } else {
-            print_command("readDistanceSensor", NULL, *(int *)(buffer + 1));
-            float dist_val = read_distance_sensor(*arena, (short)buffer[5]);
-            write(p.output_fd, &dist_val, sizeof(float));
-        }
+        print_command("readDistanceSensor", NULL, line_number, tag);
+        track_sensor_read(robot);
+        float dist_val = read_distance_sensor(arena, robot, (short)ring_byte(in, 5));
+        reply(p, &dist_val, sizeof(float));
     } else if(opcode == 0x07) {
         // delay()
         // receives: 1 byte op code, 4 byte line number, 4 bytes delay val
         // returns: 1 byte ack
-        if(buffer_pos < 9) {
-            return in;
-        } else {
-            print_command("delay", NULL, *(int *)(buffer + 1));
-            int delay_msec = *(int *)(buffer + 5);
-            // garbage fast forward:
-            int num_frames = ((float)delay_msec) * FE_FPS / 1000.0f;
-            for(i = 0; i < num_frames; i++) {
-                update_osv(arena, *frame_no);
-                *frame_no += 1;
-
-                if(*frame_no >= NUM_FRAMES) {
-                    break;
-                }
+        print_command("delay", NULL, line_number, tag);
+        int delay_msec = ring_int(in, 5);
+        int num_frames = ((float)delay_msec) * options.output_hz / 1000.0f;
+
+        // the other osvs keep going meanwhile, so this one waits for its ack in frame()
+        if(robots->count > 1 && num_frames > 0) {
+            robots->wake_frame[robot] = *frame_no + num_frames;
+            ring_consume(in, length);
+            return;
+        }
+
+        // garbage fast forward, one frame short of the end at most since
+        // frame() moves and counts the frame we are in
+        for(i = 0; i < num_frames && *frame_no + 1 < options.num_frames; i++) {
+            update_osv(arena, *frame_no);
+            *frame_no += 1;
+
+            if(arrived(arena) >= 0) {
+                break;
             }
+        }
 
-            write(p.output_fd, &ack_code, sizeof(unsigned char));
+        reply(p, &ack_code, sizeof(unsigned char));
+    } else if(opcode == 0x08) {
+        // checkpoint taken
+        // receives: 1 byte opcode, 4 byte checkpoint frame, 4 byte pid of the frozen copy
+        // returns: 1 byte ack
+        save_checkpoint(ring_int(in, 1), ring_int(in, 5), arena, *frame_no);
+        reply(p, &ack_code, sizeof(unsigned char));
+    }
+
+    ring_consume(in, length);
+}
+
+// drains what one sketch sent, unless the request capped how many fit in a frame.
+// returns how many messages it handled.
+int drain(struct ring *in, struct process p, struct arena *arena, int *frame_no) {
+    int processed = 0;
+    int replied = 0;
+    int printed = 0;
+    int length;
+
+    while(*frame_no < options.num_frames && (options.command_budget <= 0 || processed < options.command_budget)) {
+        // a delay() holds back everything the sketch sent after it
+        if(arena->robots.wake_frame[p.robot] > 0) {
+            break;
         }
-    } else {
-        // error("Invalid opcode\n");
+
+        length = message_length(in);
+        if(length == 0 && replied) {
+            // every call waits for its reply, so whatever the sketch sent
+            // since the last one is still in the pipe, not the ring
+            replied = 0;
+            if(ring_fill(in, p.input_fd) > 0) {
+                // its prints were flushed before the messages that just came in
+                printed += drain_log(p.log, arena->robots.count > 1 ? p.robot : -1);
+                continue;
+            }
+            break;
+        } else if(length == 0) {
+            break;
+        } else if(length < 0) {
+            // not an opcode, skip the byte so we can find the next message
+            ring_consume(in, 1);
+            continue;
+        }
+
+        process_command(in, length, p, arena, frame_no);
+        processed++;
+        replied = 1;
     }
 
-    // free all of the data
-    while (curr != NULL) {
-        next = curr->next;
-        free(curr->data);
-        free(curr);
-        curr = next;
+    return processed + printed;
+}
+
+// the sketch's next message in lockstep, however long it takes to arrive. 0 once
+// it has exited or said nothing for LOCKSTEP_WAIT_MSEC, which it then stays.
+static int wait_for_message(struct ring *in, struct process p, int *exited, int *quiet) {
+    int length;
+
+    while((length = message_length(in)) == 0) {
+        if(*exited || *quiet) {
+            return 0;
+        }
+
+        struct pollfd fd;
+        fd.fd = p.input_fd;
+        fd.events = POLLIN;
+        if(poll(&fd, 1, LOCKSTEP_WAIT_MSEC) <= 0) {
+            *quiet = 1;
+            return 0;
+        }
+
+        if(ring_fill(in, p.input_fd) == 0) {
+            *exited = 1;
+        }
+    }
+
+    return length;
+}
+
+// drain() for the deterministic mode. the sketch gets exactly its calls for the
+// frame, prints included as they are in process, however long it takes to make
+// them, so the same request always plays out the same way. returns how many
+// calls it handled.
+int lockstep(struct ring *in, struct process p, struct arena *arena, int *frame_no, int *exited, int *quiet) {
+    int budget = options.command_budget > 0 ? options.command_budget : LOCKSTEP_BUDGET;
+    int tag = arena->robots.count > 1 ? p.robot : -1;
+    int processed = 0;
+
+    while(*frame_no < options.num_frames && processed < budget) {
+        if(arena->robots.wake_frame[p.robot] > 0) {
+            break;
+        }
+
+        int length = wait_for_message(in, p, exited, quiet);
+        if(length == 0) {
+            break;
+        } else if(length < 0) {
+            ring_consume(in, 1);
+            continue;
+        }
+
+        // the sketch is blocked on this message, everything it printed before is in.
+        // when the prints used up the frame the message waits for the next one.
+        processed += drain_log(p.log, tag);
+        if(processed >= budget) {
+            break;
+        }
+
+        process_command(in, length, p, arena, frame_no);
+        processed++;
     }
 
-    return NULL;    
+    return processed;
 }
 
-struct node * frame(struct node *in, struct process p, struct arena *arena, int *frame_no) {
+// in and p hold one queue and one process per osv, exited and quiet what the
+// lockstep mode learned about them. returns how many messages the sketches got
+// through this frame.
+int frame(struct ring *in, struct process *p, struct arena *arena, int *frame_no, int *exited, int *quiet) {
+    int i;
+    int messages = 0;
+    unsigned char ack_code = '\x08';
+
     update_osv(arena, *frame_no);
-    struct node * ret_node = process_command(in, p, arena, frame_no);
+
+    for(i = 0; i < arena->robots.count; i++) {
+        if(arena->robots.wake_frame[i] > 0 && *frame_no >= arena->robots.wake_frame[i]) {
+            arena->robots.wake_frame[i] = 0;
+            reply(p[i], &ack_code, sizeof(unsigned char));
+        }
+
+        if(options.deterministic) {
+            messages += lockstep(&in[i], p[i], arena, frame_no, &exited[i], &quiet[i]);
+            continue;
+        }
+
+        // a sketch flushes its prints before every message, so whatever it
+        // printed before the messages we are about to handle is in by now
+        messages += drain_log(p[i].log, arena->robots.count > 1 ? i : -1);
+        messages += drain(&in[i], p[i], arena, frame_no);
+    }
 
     *frame_no += 1;
-    return ret_node;
+    return messages;
 }
@@ -2,14 +2,28 @@
 #define VS_H
 
 #include "simulator.h"
-#include "node.h"
+#include "ring.h"
 
 #define PI 3.1415926535f
 #define FE_FPS 60
 #define SEC_TO_CROSS 12.0f
-#define METERS_PER_FRAME (1/(FE_FPS * SEC_TO_CROSS / 4.0f))
+#define METERS_PER_STEP(hz) (1/((hz) * SEC_TO_CROSS / 4.0f))
 #define SEC_TO_TURN 6.25f
-#define RAD_PER_FRAME (1/(FE_FPS * SEC_TO_TURN / (2.0f * PI)))
+#define RAD_PER_STEP(hz) (1/((hz) * SEC_TO_TURN / (2.0f * PI)))
+// the osv never moves further than this between two collision checks, well under
+// the 0.2m obstacle width so a coarse timestep cannot tunnel through one
+#define SWEEP_STEP 0.05f
+#define TOI_ITERATIONS 10
+#define NUM_SENSORS 12
+#define MAX_ROBOTS 8
+// calls a sketch gets per frame in the deterministic mode, the in process default
+#define LOCKSTEP_BUDGET 1
+// a sketch that takes longer than this to make its next call is left alone for
+// the rest of a deterministic run, and the run is not cached
+#define LOCKSTEP_WAIT_MSEC 2000
+#define ARENA_WIDTH 4.0f
+#define ARENA_HEIGHT 2.0f
+#define NUM_WALLS 4
 
 struct coordinate {
     float x;
@@ -28,23 +42,61 @@ struct obstacle {
     float height;
 };
 
+// one osv as a request describes it, before it is added to the arena
 struct osv {
     struct coordinate location;
-    int *distance_sensors;
     float width, height;
-    int left_motor_pwm, right_motor_pwm;
+    // bit i is set when distance sensor i is mounted
+    unsigned short sensors;
 };
 
+// every osv in the arena, one array per field so the physics passes walk each
+// of them straight through. robot i is driven by the i-th student process.
+struct robots {
+    int count;
+    float *x, *y, *theta;
+    float *width, *height;
+    int *left_motor_pwm, *right_motor_pwm;
+    unsigned short *sensors;
+    // frame a robot that called delay() gets its ack at, 0 when it is not waiting
+    int *wake_frame;
+    // what sensor j of robot i read, at sensor_cache[i * NUM_SENSORS + j], valid
+    // while bit j of sensor_cached[i] is set. cleared whenever an osv moves.
+    float *sensor_cache;
+    unsigned short *sensor_cached;
+};
+
+struct field;
+
 struct arena {
     struct obstacle *obstacles;
     int num_obstacles;
     struct coordinate destination;
-    struct osv osv;
+    struct robots robots;
+    // the sides of obstacle i are sides[4 * i] to sides[4 * i + 3], these and the
+    // walls come from the scene and may be mapped read only
+    struct line *sides;
+    struct line *walls;
+    int num_walls;
+    struct field *field;
 };
 
-float read_distance_sensor(struct arena arena, short index);
+void init_robots(struct robots *robots, int capacity);
+int add_robot(struct robots *robots, struct osv osv);
+void free_robots(struct robots *robots);
+void forget_sensors(struct robots *robots);
+float read_distance_sensor(struct arena *arena, int robot, short index);
 struct coordinate* get_intersection(struct line l1, struct line l2);
-struct node * frame(struct node *in, struct process p, struct arena *arena, int *frame_no);
+float sides_distance(struct line *sides, struct line sensor_trace, float minimum_distance);
+void obstacle_sides(struct obstacle *obstacle, struct line *sides);
+float obstacle_distance(struct obstacle *obstacle, struct line sensor_trace, float minimum_distance);
+float robot_radius(struct robots *robots, int i);
+void robot_sides(struct robots *robots, int i, struct line *sides);
+void update_osv(struct arena *arena, int frame_no);
+int message_length(struct ring *in);
+void process_command(struct ring *in, int length, struct process p, struct arena *arena, int *frame_no);
+int lockstep(struct ring *in, struct process p, struct arena *arena, int *frame_no, int *exited, int *quiet);
+int frame(struct ring *in, struct process *p, struct arena *arena, int *frame_no, int *exited, int *quiet);
 float distance(struct coordinate a, struct coordinate b);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,130 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "zygote.h"
+#include "checkpoint.h"
+#include "log.h"
+
+// environment the sketch would have inherited from us had we forked it ourselves
+static char *forwarded_env[] = { CHECKPOINT_ENV, LOG_ENV };
+
+// asks the zygote to run the sketch's shared object wired to a fresh pair of
+// pipes, and to log_fd as LOG_FD unless that is -1. pid is -1 when there is no zygote or it could not load the sketch,
+// the caller then runs the executable with copen() instead.
+struct process zopen(char *sketch, int log_fd) {
+    struct process p;
+    p.pid = -1;
+    p.input_fd = -1;
+    p.output_fd = -1;
+    p.replies = NULL;
+    p.robot = 0;
+    p.log = NULL;
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, ZYGOTE_SOCKET, sizeof(addr.sun_path) - 1);
+
+    int conn = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(conn < 0) {
+        return p;
+    }
+
+    if(connect(conn, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        close(conn);
+        return p;
+    }
+
+    // sketch path then NAME=value entries, all NUL terminated
+    char payload[ZYGOTE_REQUEST_SIZE];
+    size_t size = snprintf(payload, sizeof(payload), "%s", sketch) + 1;
+    size_t i;
+    for(i = 0; i < sizeof(forwarded_env) / sizeof(char*); i++) {
+        char *value = getenv(forwarded_env[i]);
+        if(value != NULL && size < sizeof(payload)) {
+            size += snprintf(payload + size, sizeof(payload) - size, "%s=%s", forwarded_env[i], value) + 1;
+        }
+    }
+
+    if(size >= sizeof(payload)) {
+        close(conn);
+        return p;
+    }
+
+    int in_pipe[2];
+    int out_pipe[2];
+    if(pipe(in_pipe) < 0) {
+        close(conn);
+        return p;
+    }
+
+    if(pipe(out_pipe) < 0) {
+        close(in_pipe[0]);
+        close(in_pipe[1]);
+        close(conn);
+        return p;
+    }
+
+    // the sketch's stdin, stdout, working directory and maybe log channel
+    int fds[4] = { out_pipe[0], in_pipe[1], open(".", O_RDONLY | O_DIRECTORY), log_fd };
+    int num_fds = log_fd >= 0 ? 4 : 3;
+
+    struct msghdr msg;
+    struct iovec iov;
+    char control[CMSG_SPACE(sizeof(fds))];
+    memset(&msg, 0, sizeof(msg));
+    memset(control, 0, sizeof(control));
+    iov.iov_base = payload;
+    iov.iov_len = size;
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(num_fds * sizeof(int));
+    memcpy(CMSG_DATA(cmsg), fds, num_fds * sizeof(int));
+    msg.msg_controllen = CMSG_SPACE(num_fds * sizeof(int));
+
+    int sent = fds[2] >= 0 ? sendmsg(conn, &msg, 0) : -1;
+
+    // the zygote has its own copies now
+    close(out_pipe[0]);
+    close(in_pipe[1]);
+    if(fds[2] >= 0) {
+        close(fds[2]);
+    }
+
+    // the fork answers with its pid once the sketch is loaded
+    unsigned char pid_buff[4];
+    int received = 0;
+    while(sent > 0 && received < 4) {
+        int n = read(conn, pid_buff + received, 4 - received);
+        if(n <= 0) {
+            break;
+        }
+
+        received += n;
+    }
+    close(conn);
+
+    int pid = pid_buff[0] | (pid_buff[1] << 8) | (pid_buff[2] << 16) | (pid_buff[3] << 24);
+    if(received < 4 || pid <= 0) {
+        close(in_pipe[0]);
+        close(out_pipe[1]);
+        return p;
+    }
+
+    p.pid = pid;
+    p.input_fd = in_pipe[0];
+    p.output_fd = out_pipe[1];
+
+    return p;
+}
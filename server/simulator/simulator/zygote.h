@@ -0,0 +1,12 @@
+#ifndef ZYGOTE_H
+#define ZYGOTE_H
+
+#include "simulator.h"
+
+// must match dependencies/Zygote.h
+#define ZYGOTE_SOCKET "../zygote.sock"
+#define ZYGOTE_REQUEST_SIZE 4096
+
+struct process zopen(char *sketch, int log_fd);
+
+#endif